@@ -0,0 +1,208 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_BACKTEST_CSV_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_BACKTEST_CSV_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+// Strategy Studio's "2019-Sep-13 13:30:01.012805" (UTC) as nanoseconds since the epoch
+inline bool ParseBacktestTime(const char* text, int64_t* timestamp_ns)
+{
+    static const char* months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    int year, day, hours, minutes, seconds;
+    char month[4];
+    int consumed = 0;
+    if (sscanf(text, "%d-%3s-%d %d:%d:%d%n", &year, month, &day, &hours, &minutes, &seconds, &consumed) != 6)
+        return false;
+    struct tm parts;
+    memset(&parts, 0, sizeof(parts));
+    parts.tm_mon = -1;
+    for (int i = 0; i < 12; ++i) {
+        if (strcmp(month, months[i]) == 0)
+            parts.tm_mon = i;
+    }
+    if (parts.tm_mon < 0)
+        return false;
+    parts.tm_year = year - 1900;
+    parts.tm_mday = day;
+    parts.tm_hour = hours;
+    parts.tm_min = minutes;
+    parts.tm_sec = seconds;
+
+    // Fraction of a second, any number of digits
+    int64_t fraction_ns = 0;
+    const char* p = text + consumed;
+    if (*p == '.') {
+        int64_t scale = 100000000;
+        for (++p; *p >= '0' && *p <= '9'; ++p, scale /= 10)
+            fraction_ns += (*p - '0') * scale;
+    }
+    *timestamp_ns = int64_t(timegm(&parts)) * 1000000000LL + fraction_ns;
+    return true;
+}
+
+// "<prefix>", "<prefix>_order.csv" or "<prefix>_fill.csv" -> "<prefix>", the run a tool argument names
+inline std::string BacktestResultPrefix(const std::string& arg)
+{
+    static const char* suffixes[] = { "_order.csv", "_fill.csv", "_pnl.csv" };
+    for (size_t i = 0; i < 3; ++i) {
+        size_t length = strlen(suffixes[i]);
+        if (arg.size() > length && arg.compare(arg.size() - length, length, suffixes[i]) == 0)
+            return arg.substr(0, arg.size() - length);
+    }
+    return arg;
+}
+
+// Reads Strategy Studio result CSVs (BACK_*_order.csv, BACK_*_fill.csv, vwap_replay --out) row by
+// row, chaining several files with the same header in the order given, e.g. one per day. Columns
+// are looked up by header name once, so the readers do not depend on column order.
+class BacktestCsvReader {
+public:
+    BacktestCsvReader() : file_(NULL), next_path_(0), rows_(0) {}
+
+    ~BacktestCsvReader()
+    {
+        if (file_)
+            fclose(file_);
+    }
+
+    // Opens the first file and reads its header; false if it cannot be opened or is empty
+    bool Open(const std::vector<std::string>& paths)
+    {
+        paths_ = paths;
+        next_path_ = 0;
+        return OpenNext();
+    }
+
+    // Index of a header column, or -1
+    int Column(const char* name) const
+    {
+        for (size_t i = 0; i < header_.size(); ++i) {
+            if (header_[i] == name)
+                return int(i);
+        }
+        return -1;
+    }
+
+    // Advances to the next data row; false at the end of the last file
+    bool Next()
+    {
+        while (file_) {
+            if (ReadLine() && !line_.empty()) {
+                Split(line_, &fields_);
+                ++rows_;
+                return true;
+            }
+            if (ferror(file_)) {
+                error_ = "could not read " + path();
+                fclose(file_);
+                file_ = NULL;
+                return false;
+            }
+            if (feof(file_) && !OpenNext())
+                return false;
+        }
+        return false;
+    }
+
+    // Field of the current row, "" when the row is short or the column is missing
+    const char* Get(int column) const
+    {
+        return column >= 0 && size_t(column) < fields_.size() ? fields_[column].c_str() : "";
+    }
+
+    double GetDouble(int column) const { return atof(Get(column)); }
+
+    const std::string& path() const { return paths_[next_path_ - 1]; }
+    uint64_t rows() const { return rows_; }
+
+    // Why Open or Next stopped early; empty after a clean end of input
+    const std::string& error() const { return error_; }
+
+private:
+    bool OpenNext()
+    {
+        if (file_) {
+            fclose(file_);
+            file_ = NULL;
+        }
+        while (next_path_ < paths_.size()) {
+            file_ = fopen(paths_[next_path_++].c_str(), "r");
+            if (!file_) {
+                error_ = "could not open " + path();
+                return false;
+            }
+            bool read = ReadLine();
+            if (ferror(file_)) {
+                fclose(file_);
+                file_ = NULL;
+                error_ = "could not read " + path();
+                return false;
+            }
+            if (!read) {
+                fclose(file_);
+                file_ = NULL;
+                continue;
+            }
+            std::vector<std::string> header;
+            Split(line_, &header);
+            // Later files must keep the first file's layout so column indexes stay valid
+            if (!header_.empty() && header != header_) {
+                fclose(file_);
+                file_ = NULL;
+                error_ = path() + " has a different header";
+                return false;
+            }
+            header_.swap(header);
+            return true;
+        }
+        return false;
+    }
+
+    bool ReadLine()
+    {
+        line_.clear();
+        char buffer[1024];
+        while (fgets(buffer, sizeof(buffer), file_)) {
+            line_ += buffer;
+            if (!line_.empty() && line_[line_.size() - 1] == '\n')
+                break;
+        }
+        while (!line_.empty() && (line_[line_.size() - 1] == '\n' || line_[line_.size() - 1] == '\r'))
+            line_.erase(line_.size() - 1);
+        return !line_.empty() || !feof(file_);
+    }
+
+    // The result files never quote fields, so a plain comma split is enough
+    static void Split(const std::string& line, std::vector<std::string>* fields)
+    {
+        fields->clear();
+        size_t start = 0;
+        for (;;) {
+            size_t comma = line.find(',', start);
+            fields->push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (comma == std::string::npos)
+                break;
+            start = comma + 1;
+        }
+    }
+
+    std::vector<std::string> paths_;
+    FILE* file_;
+    size_t next_path_;
+    std::vector<std::string> header_;
+    std::string line_;
+    std::vector<std::string> fields_;
+    uint64_t rows_;
+    std::string error_;
+};
+
+#endif
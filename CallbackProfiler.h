@@ -0,0 +1,317 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_CALLBACK_PROFILER_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_CALLBACK_PROFILER_H_
+
+#include "TscClock.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #define CALLBACK_PROFILER_HAS_PERF 1
+#else
+    #define CALLBACK_PROFILER_HAS_PERF 0
+#endif
+
+#include <new>
+#include <sstream>
+#include <string>
+
+// Profiling build mode (make PROFILE=1 defines CALLBACK_PROFILE).
+//
+// PROFILE_CALLBACK(profiler, id) at the top of a callback counts the heap allocations and the
+// hardware events of everything the callback does, aggregated per callback type. Without
+// CALLBACK_PROFILE the macro expands to nothing and the profiler is never touched.
+//
+// Allocations are counted by a replacement global operator new. It only sees allocations made
+// inside libstdc++ (ostringstream buffers, string growth) when it lives in the executable or a
+// preloaded library, so it is compiled where CALLBACK_PROFILER_DEFINE_ALLOCATOR is defined:
+// vwap_replay, and callback_alloc_preload.so for the server (LD_PRELOAD). Everything else finds
+// the per-thread counts through a weak symbol and reports allocations as unavailable when no
+// interposer is loaded.
+
+struct CallbackAllocationCounts {
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+#ifdef CALLBACK_PROFILER_DEFINE_ALLOCATOR
+
+static __thread CallbackAllocationCounts callback_allocation_counts;
+
+extern "C" const CallbackAllocationCounts* CallbackProfilerAllocationCounts()
+{
+    return &callback_allocation_counts;
+}
+
+void* operator new(size_t size)
+{
+    ++callback_allocation_counts.allocations;
+    callback_allocation_counts.bytes += size;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++callback_allocation_counts.allocations;
+    callback_allocation_counts.bytes += size;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+// GCC 11+ flags free() of operator new memory once both are inlined; here that is the point
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+#pragma GCC diagnostic pop
+
+static inline const CallbackAllocationCounts* CallbackAllocationCountsIfLoaded()
+{
+    return &callback_allocation_counts;
+}
+
+#else
+
+extern "C" const CallbackAllocationCounts* CallbackProfilerAllocationCounts() __attribute__((weak));
+
+// Null when no interposer is linked in or preloaded
+static inline const CallbackAllocationCounts* CallbackAllocationCountsIfLoaded()
+{
+    return CallbackProfilerAllocationCounts ? CallbackProfilerAllocationCounts() : NULL;
+}
+
+#endif
+
+// Cycles, instructions, L1D read misses, LLC misses and branch misses of the calling thread,
+// read together as one perf_event_open group. Counters the kernel or CPU refuses (no PMU in a
+// VM, perf_event_paranoid) are reported as unavailable rather than failing.
+class PerfCounterGroup {
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, kCounters };
+
+    PerfCounterGroup() : leader_(-1), opened_(0)
+    {
+        for (int i = 0; i < kCounters; ++i) {
+            fds_[i] = -1;
+            slot_[i] = -1;
+        }
+    }
+
+    ~PerfCounterGroup()
+    {
+        for (int i = 0; i < kCounters; ++i)
+            if (fds_[i] >= 0)
+                close(fds_[i]);
+    }
+
+    // Opens the counters for the calling thread; false if none could be opened
+    bool Open()
+    {
+#if CALLBACK_PROFILER_HAS_PERF
+        static const uint32_t types[kCounters] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                                   PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+        static const uint64_t configs[kCounters] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int i = 0; i < kCounters; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = leader_ < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, leader_, 0));
+            if (fd < 0)
+                continue;
+            fds_[i] = fd;
+            slot_[i] = opened_++;
+            if (leader_ < 0)
+                leader_ = fd;
+        }
+        if (leader_ < 0)
+            return false;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Current counts; unavailable counters read as zero
+    bool Read(uint64_t* values) const
+    {
+        for (int i = 0; i < kCounters; ++i)
+            values[i] = 0;
+#if CALLBACK_PROFILER_HAS_PERF
+        if (leader_ < 0)
+            return false;
+        uint64_t buffer[1 + kCounters];
+        if (read(leader_, buffer, sizeof(buffer)) < ssize_t(sizeof(uint64_t)))
+            return false;
+        for (int i = 0; i < kCounters; ++i)
+            if (slot_[i] >= 0 && uint64_t(slot_[i]) < buffer[0])
+                values[i] = buffer[1 + slot_[i]];
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool available(Counter counter) const { return slot_[counter] >= 0; }
+
+    static const char* Name(int counter)
+    {
+        static const char* names[kCounters] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+        return names[counter];
+    }
+
+private:
+    int fds_[kCounters];
+    int slot_[kCounters];
+    int leader_;
+    int opened_;
+};
+
+// Per callback type totals. Counters are opened lazily on the first profiled callback, on that
+// callback's thread; Strategy Studio and the replay deliver a strategy's events on one thread.
+class CallbackProfiler {
+public:
+    enum { kMaxCallbacks = 16 };
+
+    CallbackProfiler() : callback_count_(0), started_(false), perf_available_(false) { memset(stats_, 0, sizeof(stats_)); }
+
+    // Returns the id to pass to PROFILE_CALLBACK
+    size_t Register(const char* name)
+    {
+        size_t id = callback_count_ < kMaxCallbacks ? callback_count_++ : kMaxCallbacks - 1;
+        names_[id] = name;
+        return id;
+    }
+
+    void Reset() { memset(stats_, 0, sizeof(stats_)); }
+
+    class Scope {
+    public:
+        Scope(CallbackProfiler& profiler, size_t id) : profiler_(profiler), id_(id)
+        {
+            profiler_.Start();
+            const CallbackAllocationCounts* allocations = CallbackAllocationCountsIfLoaded();
+            allocations_ = allocations ? *allocations : CallbackAllocationCounts();
+            profiler_.counters_.Read(counters_);
+            start_ticks_ = TscClock::Ticks();
+        }
+
+        ~Scope()
+        {
+            uint64_t end_ticks = TscClock::Ticks();
+            uint64_t counters[PerfCounterGroup::kCounters];
+            profiler_.counters_.Read(counters);
+            CallbackStats& stats = profiler_.stats_[id_];
+            ++stats.calls;
+            stats.ns += TscClock::Instance().TicksToNanos(end_ticks - start_ticks_);
+            for (int i = 0; i < PerfCounterGroup::kCounters; ++i)
+                stats.counters[i] += counters[i] - counters_[i];
+            if (const CallbackAllocationCounts* now = CallbackAllocationCountsIfLoaded()) {
+                uint64_t allocations = now->allocations - allocations_.allocations;
+                stats.allocations += allocations;
+                stats.bytes += now->bytes - allocations_.bytes;
+                stats.allocating_calls += allocations != 0;
+            }
+        }
+
+    private:
+        CallbackProfiler& profiler_;
+        size_t id_;
+        CallbackAllocationCounts allocations_;
+        uint64_t counters_[PerfCounterGroup::kCounters];
+        uint64_t start_ticks_;
+    };
+
+    // One line per callback type with per-call averages
+    std::string Report() const
+    {
+        std::ostringstream str;
+        bool allocations = CallbackAllocationCountsIfLoaded() != NULL;
+        if (!allocations)
+            str << "allocations unavailable: run with LD_PRELOAD=callback_alloc_preload.so\n";
+        if (started_ && !perf_available_)
+            str << "hardware counters unavailable: perf_event_open failed (check perf_event_paranoid)\n";
+        for (size_t id = 0; id < callback_count_; ++id) {
+            const CallbackStats& stats = stats_[id];
+            double calls = stats.calls ? double(stats.calls) : 1.0;
+            str << names_[id] << ": calls=" << stats.calls << " ns/call=" << stats.ns / calls;
+            if (allocations)
+                str << " allocs/call=" << stats.allocations / calls << " bytes/call=" << stats.bytes / calls
+                    << " allocating_calls=" << stats.allocating_calls;
+            for (int i = 0; i < PerfCounterGroup::kCounters; ++i)
+                if (counters_.available(PerfCounterGroup::Counter(i)))
+                    str << " " << PerfCounterGroup::Name(i) << "/call=" << stats.counters[i] / calls;
+            if (counters_.available(PerfCounterGroup::CYCLES) && counters_.available(PerfCounterGroup::INSTRUCTIONS) &&
+                stats.counters[PerfCounterGroup::CYCLES])
+                str << " ipc=" << double(stats.counters[PerfCounterGroup::INSTRUCTIONS]) / stats.counters[PerfCounterGroup::CYCLES];
+            str << "\n";
+        }
+        return str.str();
+    }
+
+private:
+    struct CallbackStats {
+        uint64_t calls;
+        uint64_t allocating_calls;
+        uint64_t allocations;
+        uint64_t bytes;
+        uint64_t ns;
+        uint64_t counters[PerfCounterGroup::kCounters];
+    };
+
+    void Start()
+    {
+        if (!started_) {
+            started_ = true;
+            perf_available_ = counters_.Open();
+        }
+    }
+
+    const char* names_[kMaxCallbacks];
+    CallbackStats stats_[kMaxCallbacks];
+    size_t callback_count_;
+    PerfCounterGroup counters_;
+    bool started_;
+    bool perf_available_;
+};
+
+#ifdef CALLBACK_PROFILE
+    #define PROFILE_CALLBACK(profiler, id) CallbackProfiler::Scope callback_profiler_scope(profiler, id)
+#else
+    #define PROFILE_CALLBACK(profiler, id)
+#endif
+
+#endif
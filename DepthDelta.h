@@ -0,0 +1,150 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_DEPTH_DELTA_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_DEPTH_DELTA_H_
+
+#include "TickStore.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// Depth captures as per-level changes. book_updates captures repeat the whole top N of both sides
+// on every update; DepthDeltaEncoder diffs consecutive snapshots of a symbol by price and keeps
+// only the levels that were added, resized or removed. DepthBook applies those records to a
+// price-keyed book, the way an OnDepth consumer maintains its mirror, and gives the top N back.
+
+struct DepthLevel {
+    double price;
+    int32_t size;
+
+    bool operator==(const DepthLevel& other) const { return price == other.price && size == other.size; }
+};
+
+// One side of a snapshot in snapshot order, empty levels left out
+typedef std::vector<DepthLevel> DepthSide;
+
+// True if the side is strictly in book order (bids falling, asks rising), the only snapshots a
+// price-keyed book can reproduce level for level
+inline bool IsBookOrdered(const DepthSide& levels, int side)
+{
+    for (size_t i = 1; i < levels.size(); ++i) {
+        if (side == TICK_DEPTH_BID ? levels[i].price >= levels[i - 1].price : levels[i].price <= levels[i - 1].price)
+            return false;
+    }
+    return true;
+}
+
+class DepthDeltaEncoder {
+public:
+    // Appends the changes from the symbol's previous snapshot to this one: deletes first, then adds
+    // and modifies in level order, the last one flagged TICK_DEPTH_FLAG_LAST. Returns how many.
+    size_t Encode(int64_t timestamp_ns, const std::string& symbol, const DepthSide sides[2],
+                  std::vector<DepthDeltaRecord>* out)
+    {
+        Snapshot& previous = previous_[symbol];
+        size_t first = out->size();
+        for (int side = 0; side < 2; ++side) {
+            const DepthSide& before = previous.sides[side];
+            const DepthSide& after = sides[side];
+            for (size_t i = 0; i < before.size(); ++i) {
+                if (Find(after, before[i].price) < 0)
+                    Append(timestamp_ns, symbol, side, i, TICK_DEPTH_DELETE, before[i].price, 0, out);
+            }
+            for (size_t i = 0; i < after.size(); ++i) {
+                int match = Find(before, after[i].price);
+                if (match < 0)
+                    Append(timestamp_ns, symbol, side, i, TICK_DEPTH_ADD, after[i].price, after[i].size, out);
+                else if (before[match].size != after[i].size)
+                    Append(timestamp_ns, symbol, side, i, TICK_DEPTH_MODIFY, after[i].price, after[i].size, out);
+            }
+            previous.sides[side] = after;
+        }
+        if (out->size() > first)
+            out->back().flags |= TICK_DEPTH_FLAG_LAST;
+        return out->size() - first;
+    }
+
+private:
+    struct Snapshot {
+        DepthSide sides[2];
+    };
+
+    // Top-N sides are a handful of levels, so a scan beats any index
+    static int Find(const DepthSide& levels, double price)
+    {
+        for (size_t i = 0; i < levels.size(); ++i) {
+            if (levels[i].price == price)
+                return int(i);
+        }
+        return -1;
+    }
+
+    static void Append(int64_t timestamp_ns, const std::string& symbol, int side, size_t level, int action,
+                       double price, int32_t size, std::vector<DepthDeltaRecord>* out)
+    {
+        DepthDeltaRecord record;
+        memset(&record, 0, sizeof(record));
+        record.timestamp_ns = timestamp_ns;
+        memcpy(record.symbol, symbol.c_str(), std::min(symbol.size(), sizeof(record.symbol)));
+        record.price = price;
+        record.size = size;
+        record.side = uint8_t(side);
+        record.level = uint8_t(level + 1);
+        record.action = uint8_t(action);
+        out->push_back(record);
+    }
+
+    std::map<std::string, Snapshot> previous_;
+};
+
+class DepthBook {
+public:
+    void Apply(const DepthDeltaRecord& record)
+    {
+        std::string symbol(record.symbol, strnlen(record.symbol, sizeof(record.symbol)));
+        Levels& levels = books_[symbol].sides[record.side & 1];
+        if (record.action == TICK_DEPTH_DELETE)
+            levels.erase(record.price);
+        else
+            levels[record.price] = record.size;
+    }
+
+    // Best levels of a side in book order, at most count of them
+    void Top(const std::string& symbol, int side, size_t count, DepthSide* out) const
+    {
+        out->clear();
+        std::map<std::string, Book>::const_iterator book = books_.find(symbol);
+        if (book == books_.end())
+            return;
+        const Levels& levels = book->second.sides[side & 1];
+        if (side == TICK_DEPTH_BID)
+            Copy(levels.rbegin(), levels.rend(), count, out);
+        else
+            Copy(levels.begin(), levels.end(), count, out);
+    }
+
+private:
+    typedef std::map<double, int32_t> Levels;
+
+    struct Book {
+        Levels sides[2];
+    };
+
+    template <typename Iterator>
+    static void Copy(Iterator it, Iterator end, size_t count, DepthSide* out)
+    {
+        for (; it != end && out->size() < count; ++it) {
+            DepthLevel level = { it->first, it->second };
+            out->push_back(level);
+        }
+    }
+
+    std::map<std::string, Book> books_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_FEATURE_EXPORT_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_FEATURE_EXPORT_H_
+
+#include "TickStore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Double buffered append-only writer for tick store files.
+//
+// The event thread only copies records into the active buffer. When it fills up the buffers
+// are swapped and a background thread writes the full one out, so disk latency never shows
+// up in the callback unless the disk falls a whole buffer behind, in which case Append waits
+// for the pending flush rather than dropping data.
+class TickStoreWriter {
+public:
+    explicit TickStoreWriter(size_t buffer_bytes = 4 << 20)
+        : fd_(-1), capacity_(buffer_bytes), active_(), pending_(), pending_full_(false),
+          stopping_(false), records_written_(0), write_errors_(0)
+    {
+    }
+
+    ~TickStoreWriter()
+    {
+        Close();
+    }
+
+    bool Open(const std::string& path, uint32_t record_type, uint32_t record_size)
+    {
+        Close();
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+            return false;
+
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        TickStoreHeader header(record_type, record_size, int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec);
+        if (!WriteAll(&header, sizeof(header))) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        active_.reserve(capacity_);
+        pending_.reserve(capacity_);
+        stopping_ = false;
+        flusher_ = std::thread(&TickStoreWriter::FlushLoop, this);
+        return true;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+
+    template<typename RecordType>
+    void Append(const RecordType& record)
+    {
+        if (active_.size() + sizeof(record) > capacity_)
+            SwapBuffers();
+        const char* bytes = reinterpret_cast<const char*>(&record);
+        active_.insert(active_.end(), bytes, bytes + sizeof(record));
+        ++records_written_;
+    }
+
+    // Hands whatever is buffered to the flush thread and waits for it to reach the file
+    void Flush()
+    {
+        if (fd_ < 0)
+            return;
+        SwapBuffers();
+        std::unique_lock<std::mutex> lock(mutex_);
+        flushed_.wait(lock, [this] { return !pending_full_; });
+    }
+
+    void Close()
+    {
+        if (fd_ < 0)
+            return;
+        Flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        ready_.notify_one();
+        flusher_.join();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    uint64_t records_written() const { return records_written_; }
+    uint64_t write_errors() const { return write_errors_; }
+
+private:
+    void SwapBuffers()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        flushed_.wait(lock, [this] { return !pending_full_; });
+        if (active_.empty())
+            return;
+        active_.swap(pending_);
+        pending_full_ = true;
+        lock.unlock();
+        ready_.notify_one();
+    }
+
+    void FlushLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            ready_.wait(lock, [this] { return pending_full_ || stopping_; });
+            if (pending_full_) {
+                // pending_ is owned by this thread until pending_full_ is cleared
+                lock.unlock();
+                if (!WriteAll(&pending_[0], pending_.size()))
+                    ++write_errors_;
+                pending_.clear();
+                lock.lock();
+                pending_full_ = false;
+                flushed_.notify_all();
+            } else if (stopping_) {
+                return;
+            }
+        }
+    }
+
+    bool WriteAll(const void* data, size_t size)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t n = ::write(fd_, p, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            p += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+private:
+    int fd_;
+    size_t capacity_;
+    std::vector<char> active_;       // filled by the event thread
+    std::vector<char> pending_;      // drained by the flush thread
+    bool pending_full_;
+    bool stopping_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable flushed_;
+    std::thread flusher_;
+    uint64_t records_written_;
+    std::atomic<uint64_t> write_errors_;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_MARKET_RECORDER_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_MARKET_RECORDER_H_
+
+#include "TickStore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records the market events a strategy is handed, as MarketEventRecords in a flat tick store file.
+//
+// Unlike TickStoreWriter, which waits when the disk falls a buffer behind, Record never blocks:
+// the event thread copies the record into a single-producer single-consumer ring and a background
+// thread writes whatever has accumulated straight from the ring. If the disk stalls long enough
+// for the ring to fill, new events are counted as dropped instead. One recorder belongs to one
+// event thread; Record must not be called from two threads at once.
+//
+// The file is append-only and readers ignore a torn last record, so a crash loses at most what
+// was still in the ring. A failed write cuts the file back to its last whole record and ends the
+// recording; every event after it is counted as dropped. tickpack pack turns a day's recording
+// into an indexed archive.
+class MarketRecorder {
+public:
+    // capacity is rounded up to a power of two
+    explicit MarketRecorder(size_t capacity = 1 << 16)
+        : fd_(-1), failed_(false), stopping_(false), head_(0), cached_tail_(0), tail_(0), written_(0), dropped_(0),
+          discarded_(0), write_errors_(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        ring_.resize(size);
+        mask_ = size - 1;
+    }
+
+    ~MarketRecorder()
+    {
+        Close();
+    }
+
+    bool Open(const std::string& path)
+    {
+        Close();
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+            return false;
+
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        TickStoreHeader header(TICK_RECORD_TYPE_MARKET, sizeof(MarketEventRecord),
+                               int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec);
+        size_t header_bytes;
+        if (!WriteAll(&header, sizeof(header), &header_bytes)) {
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        cached_tail_ = 0;
+        failed_ = false;
+        written_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+        discarded_.store(0, std::memory_order_relaxed);
+        write_errors_.store(0, std::memory_order_relaxed);
+        stopping_.store(false, std::memory_order_relaxed);
+        writer_ = std::thread(&MarketRecorder::WriteLoop, this);
+        return true;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+
+    // Copies the event into the ring, or counts it as dropped if the writer is a full ring behind
+    void Record(const MarketEventRecord& event)
+    {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ > mask_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ > mask_) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        ring_[head & mask_] = event;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Writes out what is left in the ring and closes the file
+    void Close()
+    {
+        if (fd_ < 0)
+            return;
+        stopping_.store(true, std::memory_order_release);
+        writer_.join();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+    // Events taken into the ring and not discarded after a write error
+    uint64_t recorded() const
+    {
+        return head_.load(std::memory_order_acquire) - discarded_.load(std::memory_order_acquire);
+    }
+    uint64_t written() const { return written_.load(std::memory_order_acquire); }
+    uint64_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed) + discarded_.load(std::memory_order_relaxed);
+    }
+    uint64_t write_errors() const { return write_errors_.load(std::memory_order_relaxed); }
+    size_t capacity() const { return ring_.size(); }
+
+private:
+    void WriteLoop()
+    {
+        for (;;) {
+            bool stopping = stopping_.load(std::memory_order_acquire);
+            uint64_t tail = tail_.load(std::memory_order_relaxed);
+            uint64_t head = head_.load(std::memory_order_acquire);
+            if (head == tail) {
+                if (stopping)
+                    return;
+                struct timespec pause = { 0, 1000000 };
+                nanosleep(&pause, NULL);
+                continue;
+            }
+            // The filled part of the ring, up to where it wraps; the rest goes on the next pass
+            size_t first = size_t(tail & mask_);
+            size_t count = std::min(size_t(head - tail), ring_.size() - first);
+            if (failed_) {
+                discarded_.fetch_add(count, std::memory_order_release);
+            } else {
+                size_t bytes;
+                bool ok = WriteAll(&ring_[first], count * sizeof(MarketEventRecord), &bytes);
+                size_t whole = bytes / sizeof(MarketEventRecord);
+                written_.fetch_add(whole, std::memory_order_release);
+                if (!ok)
+                    Fail(count - whole);
+            }
+            tail_.store(tail + count, std::memory_order_release);
+        }
+    }
+
+    // Cuts a torn record off the end of the file and stops writing, so the file stays whole
+    // records however long the caller keeps recording
+    void Fail(size_t unwritten)
+    {
+        write_errors_.fetch_add(1, std::memory_order_relaxed);
+        discarded_.fetch_add(unwritten, std::memory_order_release);
+        failed_ = true;
+        off_t size = off_t(sizeof(TickStoreHeader) + written_.load(std::memory_order_relaxed) * sizeof(MarketEventRecord));
+        if (::ftruncate(fd_, size) != 0)
+            write_errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Bytes actually written go to *written, also when the write fails part way
+    bool WriteAll(const void* data, size_t size, size_t* written)
+    {
+        const char* p = static_cast<const char*>(data);
+        *written = 0;
+        while (size > 0) {
+            ssize_t n = ::write(fd_, p, size);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            p += n;
+            size -= size_t(n);
+            *written += size_t(n);
+        }
+        return true;
+    }
+
+    int fd_;
+    bool failed_;                    // writer thread only: a write failed, the ring is discarded
+    std::vector<MarketEventRecord> ring_;
+    size_t mask_;
+    std::thread writer_;
+    std::atomic<bool> stopping_;
+
+    // Producer and writer positions on their own cache lines, so neither side's stores
+    // invalidate the line the other one polls
+    alignas(64) std::atomic<uint64_t> head_;
+    uint64_t cached_tail_;
+    alignas(64) std::atomic<uint64_t> tail_;
+    std::atomic<uint64_t> written_;
+    alignas(64) std::atomic<uint64_t> dropped_;      // ring full
+    std::atomic<uint64_t> discarded_;                // taken into the ring, not written after a write error
+    std::atomic<uint64_t> write_errors_;
+};
+
+#endif
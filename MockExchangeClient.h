@@ -0,0 +1,190 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_MOCK_EXCHANGE_CLIENT_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_MOCK_EXCHANGE_CLIENT_H_
+
+#include "MockExchangeProtocol.h"
+#include "TscClock.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Order parameters in the shape of Strategy Studio's OrderParams
+struct MockOrderParams {
+    std::string symbol;
+    int quantity;
+    double price;
+    MockOrderSide side;
+    MockOrderType order_type;
+
+    MockOrderParams(const std::string& s, int q, double p, MockOrderSide sd, MockOrderType t)
+        : symbol(s), quantity(q), price(p), side(sd), order_type(t) {}
+};
+
+// Client side of the mock exchange with the trade_actions() surface the strategies use
+// (SendNewOrder / SendCancelOrder / SendCancelAll). Requests are queued and written on Flush,
+// or immediately when autoflush is on, so callers can model one write per callback or batch
+// several orders into one. Poll reads reports and times each against the echoed send time.
+class MockExchangeClient {
+public:
+    MockExchangeClient() : fd_(-1), next_order_id_(1), autoflush_(true), read_used_(0) {}
+    ~MockExchangeClient() { Close(); }
+
+    bool Connect(const std::string& endpoint)
+    {
+        Close();
+        struct sockaddr_storage address;
+        socklen_t length;
+        int family = MockSocketAddress(endpoint, &address, &length);
+        if (family < 0)
+            return false;
+        fd_ = socket(family, SOCK_STREAM, 0);
+        if (fd_ < 0)
+            return false;
+        if (connect(fd_, reinterpret_cast<struct sockaddr*>(&address), length) != 0) {
+            Close();
+            return false;
+        }
+        MockTuneSocket(fd_, family);
+        read_buffer_.resize(64 * 1024);
+        read_used_ = 0;
+        return true;
+    }
+
+    void Close()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    void set_autoflush(bool autoflush) { autoflush_ = autoflush; }
+
+    // Returns the client order id
+    uint64_t SendNewOrder(const MockOrderParams& params)
+    {
+        MockNewOrder message;
+        InitMockMessage(message, MOCK_MSG_NEW_ORDER);
+        message.client_order_id = next_order_id_++;
+        memcpy(message.symbol, params.symbol.c_str(), std::min(params.symbol.size(), sizeof(message.symbol)));
+        message.price = params.price;
+        message.quantity = params.quantity;
+        message.side = uint8_t(params.side);
+        message.order_type = uint8_t(params.order_type);
+        message.client_send_ns = TscClock::Instance().NowNanos();
+        Queue(&message, sizeof(message));
+        return message.client_order_id;
+    }
+
+    void SendCancelOrder(uint64_t client_order_id)
+    {
+        MockCancel message;
+        InitMockMessage(message, MOCK_MSG_CANCEL);
+        message.client_order_id = client_order_id;
+        message.client_send_ns = TscClock::Instance().NowNanos();
+        Queue(&message, sizeof(message));
+    }
+
+    void SendCancelAll(const std::string& symbol = std::string())
+    {
+        MockCancel message;
+        InitMockMessage(message, MOCK_MSG_CANCEL_ALL);
+        memcpy(message.symbol, symbol.c_str(), std::min(symbol.size(), sizeof(message.symbol)));
+        message.client_send_ns = TscClock::Instance().NowNanos();
+        Queue(&message, sizeof(message));
+    }
+
+    bool Flush()
+    {
+        size_t sent = 0;
+        while (sent < write_buffer_.size()) {
+            ssize_t n = ::write(fd_, &write_buffer_[sent], write_buffer_.size() - sent);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            sent += size_t(n);
+        }
+        write_buffer_.clear();
+        return true;
+    }
+
+    // Reads whatever reports arrive within timeout_ms and hands each to handler(const MockExecutionReport&).
+    // Returns the number of reports, or -1 if the connection closed.
+    template<typename Handler>
+    int Poll(int timeout_ms, Handler handler)
+    {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            return 0;
+        ssize_t n = ::read(fd_, &read_buffer_[read_used_], read_buffer_.size() - read_used_);
+        if (n <= 0)
+            return (n < 0 && errno == EINTR) ? 0 : -1;
+        read_used_ += size_t(n);
+
+        int64_t now = TscClock::Instance().NowNanos();
+        int reports = 0;
+        size_t offset = 0;
+        while (read_used_ - offset >= sizeof(MockExecutionReport)) {
+            MockExecutionReport report;
+            memcpy(&report, &read_buffer_[offset], sizeof(report));
+            offset += sizeof(report);
+            Record(report, now);
+            handler(report);
+            ++reports;
+        }
+        memmove(&read_buffer_[0], &read_buffer_[offset], read_used_ - offset);
+        read_used_ -= offset;
+        return reports;
+    }
+
+    const LatencyHistogram& ack_latency() const { return ack_latency_; }
+    const LatencyHistogram& fill_latency() const { return fill_latency_; }
+    const LatencyHistogram& cancel_latency() const { return cancel_latency_; }
+    const LatencyHistogram& reject_latency() const { return reject_latency_; }
+
+private:
+    void Queue(const void* message, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(message);
+        write_buffer_.insert(write_buffer_.end(), bytes, bytes + size);
+        if (autoflush_)
+            Flush();
+    }
+
+    // Unsolicited reports (passive fills) carry no send time and are not timed
+    void Record(const MockExecutionReport& report, int64_t now)
+    {
+        if (report.client_send_ns == 0)
+            return;
+        int64_t latency = now - report.client_send_ns;
+        switch (report.header.type) {
+            case MOCK_MSG_ACK: ack_latency_.Record(latency); break;
+            case MOCK_MSG_FILL: fill_latency_.Record(latency); break;
+            case MOCK_MSG_CANCEL_ACK: cancel_latency_.Record(latency); break;
+            case MOCK_MSG_REJECT: reject_latency_.Record(latency); break;
+            default: break;
+        }
+    }
+
+private:
+    int fd_;
+    uint64_t next_order_id_;
+    bool autoflush_;
+    std::vector<char> write_buffer_;
+    std::vector<char> read_buffer_;
+    size_t read_used_;
+    LatencyHistogram ack_latency_;
+    LatencyHistogram fill_latency_;
+    LatencyHistogram cancel_latency_;
+    LatencyHistogram reject_latency_;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_MOCK_EXCHANGE_PROTOCOL_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_MOCK_EXCHANGE_PROTOCOL_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+
+// Binary order protocol between MockExchangeClient and mock_exchange.
+//
+// Every message is a fixed-size little-endian struct that starts with a MockMessageHeader, so
+// a reader can frame a stream by peeking at the header length. The client's send timestamp is
+// echoed back in every report, which lets the client measure round trips without keeping a
+// table of in-flight orders.
+
+enum MockMessageType {
+    MOCK_MSG_NEW_ORDER = 1,          // MockNewOrder
+    MOCK_MSG_CANCEL = 2,             // MockCancel
+    MOCK_MSG_CANCEL_ALL = 3,         // MockCancel, empty symbol means every symbol
+    MOCK_MSG_ACK = 11,               // MockExecutionReport
+    MOCK_MSG_CANCEL_ACK = 12,
+    MOCK_MSG_FILL = 13,
+    MOCK_MSG_REJECT = 14
+};
+
+enum MockOrderSide {
+    MOCK_SIDE_BUY = 1,
+    MOCK_SIDE_SELL = 2
+};
+
+enum MockOrderType {
+    MOCK_ORDER_TYPE_MARKET = 1,
+    MOCK_ORDER_TYPE_LIMIT = 2
+};
+
+enum MockRejectReason {
+    MOCK_REJECT_NONE = 0,
+    MOCK_REJECT_UNKNOWN_ORDER = 1,
+    MOCK_REJECT_BAD_QUANTITY = 2,
+    MOCK_REJECT_NO_MARKET = 3
+};
+
+struct MockMessageHeader {
+    uint16_t type;                   // MockMessageType
+    uint16_t length;                 // whole message including this header
+    uint32_t reserved;
+};
+
+struct MockNewOrder {
+    MockMessageHeader header;
+    uint64_t client_order_id;
+    int64_t client_send_ns;
+    char symbol[8];
+    double price;                    // limit price, indicative for market orders
+    int32_t quantity;
+    uint8_t side;                    // MockOrderSide
+    uint8_t order_type;              // MockOrderType
+    uint8_t reserved[2];
+};
+
+struct MockCancel {
+    MockMessageHeader header;
+    uint64_t client_order_id;        // unused by CANCEL_ALL
+    int64_t client_send_ns;
+    char symbol[8];                  // used by CANCEL_ALL
+};
+
+struct MockExecutionReport {
+    MockMessageHeader header;
+    uint64_t client_order_id;
+    int64_t client_send_ns;          // echoed from the request that caused this report
+    uint64_t exchange_order_id;
+    double price;                    // fill price
+    int32_t quantity;                // filled quantity on FILL, cancelled quantity on CANCEL_ACK
+    int32_t leaves;                  // quantity still working after this report
+    uint8_t reject_reason;           // MockRejectReason
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(MockMessageHeader) == 8, "MockMessageHeader layout changed");
+static_assert(sizeof(MockNewOrder) == 48, "MockNewOrder layout changed");
+static_assert(sizeof(MockCancel) == 32, "MockCancel layout changed");
+static_assert(sizeof(MockExecutionReport) == 56, "MockExecutionReport layout changed");
+
+template<typename MessageType>
+inline void InitMockMessage(MessageType& message, MockMessageType type)
+{
+    memset(&message, 0, sizeof(message));
+    message.header.type = uint16_t(type);
+    message.header.length = uint16_t(sizeof(message));
+}
+
+// Endpoints are "unix:/path/to/socket" or "tcp:host:port", port 1-65535. -1 for a malformed endpoint.
+inline int MockSocketAddress(const std::string& endpoint, struct sockaddr_storage* address, socklen_t* length)
+{
+    memset(address, 0, sizeof(*address));
+    if (endpoint.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(address);
+        std::string path = endpoint.substr(5);
+        if (path.size() >= sizeof(un->sun_path))
+            return -1;
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        *length = sizeof(*un);
+        return AF_UNIX;
+    }
+    if (endpoint.compare(0, 4, "tcp:") == 0) {
+        size_t colon = endpoint.rfind(':');
+        if (colon <= 4)
+            return -1;
+        const char* port_text = endpoint.c_str() + colon + 1;
+        char* end = NULL;
+        errno = 0;
+        long port = strtol(port_text, &end, 10);
+        if (end == port_text || *end != '\0' || errno != 0 || port < 1 || port > 65535)
+            return -1;
+        struct sockaddr_in* in = reinterpret_cast<struct sockaddr_in*>(address);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(uint16_t(port));
+        if (inet_pton(AF_INET, endpoint.substr(4, colon - 4).c_str(), &in->sin_addr) != 1)
+            return -1;
+        *length = sizeof(*in);
+        return AF_INET;
+    }
+    return -1;
+}
+
+inline void MockTuneSocket(int fd, int family)
+{
+    if (family == AF_INET) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_REPLAY_PACER_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_REPLAY_PACER_H_
+
+#include "TscClock.h"
+
+#include <stdint.h>
+#include <time.h>
+
+// Paces a replay against the original event timestamps at speed x real time.
+//
+// Each event is due at start + (event time - first event time) / speed. The pacer sleeps until
+// spin_ns before that point and busy waits the rest, because a plain sleep wakes tens of
+// microseconds late. Events that are already overdue when they come up are backlog: the replay
+// has fallen behind market time, either because a callback ran longer than the gap to the next
+// event or because a wakeup was late.
+class ReplayPacer {
+public:
+    explicit ReplayPacer(double speed = 1.0, int64_t spin_ns = 100000)
+        : clock_(TscClock::Instance()), speed_(speed), spin_ns_(spin_ns), started_(false),
+          first_event_ns_(0), start_wall_ns_(0), previous_event_ns_(0), callback_start_(0), last_callback_ns_(0),
+          events_(0), late_events_(0), overruns_(0), max_backlog_ns_(0)
+    {
+    }
+
+    // Blocks until event_ns is due, then starts timing the callback for it
+    void Wait(int64_t event_ns)
+    {
+        if (!started_) {
+            started_ = true;
+            first_event_ns_ = previous_event_ns_ = event_ns;
+            start_wall_ns_ = clock_.NowNanos();
+        }
+
+        // The previous callback overran if it took longer than the (scaled) gap to this event
+        if (events_ > 0 && double(last_callback_ns_) * speed_ > double(event_ns - previous_event_ns_))
+            ++overruns_;
+        previous_event_ns_ = event_ns;
+        ++events_;
+
+        int64_t due = start_wall_ns_ + int64_t(double(event_ns - first_event_ns_) / speed_);
+        int64_t now = clock_.NowNanos();
+        if (now > due) {
+            int64_t backlog = now - due;
+            ++late_events_;
+            backlog_.Record(backlog);
+            if (backlog > max_backlog_ns_)
+                max_backlog_ns_ = backlog;
+        } else {
+            if (due - now > spin_ns_) {
+                int64_t sleep_ns = due - now - spin_ns_;
+                struct timespec request = { time_t(sleep_ns / 1000000000LL), long(sleep_ns % 1000000000LL) };
+                nanosleep(&request, NULL);
+            }
+            while ((now = clock_.NowNanos()) < due)
+                ;
+            jitter_.Record(now - due);
+        }
+        callback_start_ = TscClock::Ticks();
+    }
+
+    // Marks the end of the callback started by the last Wait
+    void Done()
+    {
+        last_callback_ns_ = clock_.TicksToNanos(TscClock::Ticks() - callback_start_);
+        callback_.Record(last_callback_ns_);
+    }
+
+    double speed() const { return speed_; }
+    uint64_t events() const { return events_; }
+    uint64_t late_events() const { return late_events_; }
+    uint64_t overruns() const { return overruns_; }
+    int64_t max_backlog_ns() const { return max_backlog_ns_; }
+
+    // Wake error of events that were waited for
+    const LatencyHistogram& jitter() const { return jitter_; }
+    // How far behind market time overdue events were picked up
+    const LatencyHistogram& backlog() const { return backlog_; }
+    const LatencyHistogram& callback() const { return callback_; }
+
+private:
+    const TscClock& clock_;
+    double speed_;
+    int64_t spin_ns_;
+    bool started_;
+    int64_t first_event_ns_;
+    int64_t start_wall_ns_;
+    int64_t previous_event_ns_;
+    uint64_t callback_start_;
+    int64_t last_callback_ns_;
+    uint64_t events_;
+    uint64_t late_events_;
+    uint64_t overruns_;
+    int64_t max_backlog_ns_;
+    LatencyHistogram jitter_;
+    LatencyHistogram backlog_;
+    LatencyHistogram callback_;
+};
+
+#endif
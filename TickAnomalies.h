@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_ANOMALIES_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_ANOMALIES_H_
+
+#include "TickStore.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// Anomaly index of a tick archive: tick_validate writes <root>/<yyyymmdd>.anomalies next to each
+// <yyyymmdd>.tpk, a tick store of AnomalyRecords sorted by start time. Replays load the index of
+// the days they cover and look events up with a per-symbol cursor, so bad intervals are skipped
+// or counted without scanning the capture again.
+
+inline const char* TickAnomalyKindName(uint32_t kind)
+{
+    static const char* names[TICK_ANOMALY_KIND_COUNT] = { "none", "crossed", "locked", "zero_price", "stale_quote",
+                                                          "constant_size", "time_regression", "gap", "duplicate" };
+    return kind < TICK_ANOMALY_KIND_COUNT ? names[kind] : "unknown";
+}
+
+// "crossed,zero_price" -> bit mask of kinds (1 << kind); "all" is every kind but gaps, which
+// hold no events; "" is none. False on an unknown name.
+inline bool ParseTickAnomalyKinds(const std::string& spec, uint32_t* mask)
+{
+    *mask = 0;
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t comma = spec.find(',', start);
+        if (comma == std::string::npos)
+            comma = spec.size();
+        std::string name = spec.substr(start, comma - start);
+        uint32_t kind = 1;
+        while (kind < TICK_ANOMALY_KIND_COUNT && name != TickAnomalyKindName(kind))
+            ++kind;
+        if (name == "all")
+            *mask |= ((1u << TICK_ANOMALY_KIND_COUNT) - 2) & ~(1u << TICK_ANOMALY_GAP);
+        else if (kind < TICK_ANOMALY_KIND_COUNT)
+            *mask |= 1u << kind;
+        else
+            return false;
+        start = comma + 1;
+    }
+    return true;
+}
+
+// Canonical form of a mask for printing, in kind order
+inline std::string FormatTickAnomalyKinds(uint32_t mask)
+{
+    std::string spec;
+    for (uint32_t kind = 1; kind < TICK_ANOMALY_KIND_COUNT; ++kind) {
+        if (mask & (1u << kind))
+            spec += (spec.empty() ? "" : ",") + std::string(TickAnomalyKindName(kind));
+    }
+    return spec;
+}
+
+inline bool WriteAnomalyFile(const std::string& path, const std::vector<AnomalyRecord>& records, int64_t created_ns)
+{
+    FILE* out = fopen(path.c_str(), "wb");
+    if (!out)
+        return false;
+    TickStoreHeader header(TICK_RECORD_TYPE_ANOMALY, sizeof(AnomalyRecord), created_ns);
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              (records.empty() || fwrite(&records[0], sizeof(AnomalyRecord), records.size(), out) == records.size());
+    return fclose(out) == 0 && ok;
+}
+
+class TickAnomalyIndex {
+public:
+    struct Interval {
+        int64_t start_ns;
+        int64_t end_ns;
+        uint32_t kinds;              // mask of the kinds merged into this interval
+    };
+
+    // Position of one symbol in its intervals; events of a symbol arrive in time order
+    struct Cursor {
+        const std::vector<Interval>* intervals;
+        size_t next;
+        int64_t last_ns;
+
+        Cursor() : intervals(NULL), next(0), last_ns(INT64_MIN) {}
+    };
+
+    TickAnomalyIndex() : files_(0), records_(0) {}
+
+    // Loads the records of the kinds in mask from <root>/<date>.anomalies for each date; days
+    // without an index are skipped. Overlapping intervals are merged, so load one index per set
+    // of kinds that has to be told apart.
+    void Load(const std::string& root, const std::vector<std::string>& dates, uint32_t mask)
+    {
+        for (size_t d = 0; d < dates.size(); ++d) {
+            TickStoreFile file;
+            if (!file.Open(root + "/" + dates[d] + ".anomalies") ||
+                file.header().record_type != TICK_RECORD_TYPE_ANOMALY || file.header().record_size != sizeof(AnomalyRecord))
+                continue;
+            ++files_;
+            const AnomalyRecord* records = file.records<AnomalyRecord>();
+            for (size_t i = 0; i < file.record_count(); ++i) {
+                if (records[i].kind >= 32 || !(mask & (1u << records[i].kind)))
+                    continue;
+                std::string symbol(records[i].symbol, strnlen(records[i].symbol, sizeof(records[i].symbol)));
+                Interval interval = { records[i].start_ns, records[i].end_ns, 1u << records[i].kind };
+                intervals_[symbol].push_back(interval);
+                ++records_;
+            }
+        }
+        for (std::map<std::string, std::vector<Interval> >::iterator it = intervals_.begin(); it != intervals_.end(); ++it)
+            Merge(&it->second);
+    }
+
+    Cursor CursorFor(const std::string& symbol) const
+    {
+        Cursor cursor;
+        std::map<std::string, std::vector<Interval> >::const_iterator it = intervals_.find(symbol);
+        if (it != intervals_.end())
+            cursor.intervals = &it->second;
+        return cursor;
+    }
+
+    // Kinds of the interval covering timestamp_ns for the cursor's symbol, 0 if none. Amortized
+    // O(1) for events in time order; a timestamp before the previous one searches again.
+    static uint32_t Find(Cursor* cursor, int64_t timestamp_ns)
+    {
+        if (!cursor->intervals)
+            return 0;
+        const std::vector<Interval>& intervals = *cursor->intervals;
+        if (timestamp_ns < cursor->last_ns) {
+            cursor->next = std::lower_bound(intervals.begin(), intervals.end(), timestamp_ns, EndsBefore) - intervals.begin();
+        }
+        cursor->last_ns = timestamp_ns;
+        while (cursor->next < intervals.size() && intervals[cursor->next].end_ns < timestamp_ns)
+            ++cursor->next;
+        if (cursor->next < intervals.size() && intervals[cursor->next].start_ns <= timestamp_ns)
+            return intervals[cursor->next].kinds;
+        return 0;
+    }
+
+    size_t files() const { return files_; }
+    size_t records() const { return records_; }
+
+private:
+    static bool EndsBefore(const Interval& interval, int64_t timestamp_ns) { return interval.end_ns < timestamp_ns; }
+
+    // Sorts by start and unions overlapping intervals, so Find only ever looks at one
+    static void Merge(std::vector<Interval>* intervals)
+    {
+        std::sort(intervals->begin(), intervals->end(), StartsBefore);
+        size_t out = 0;
+        for (size_t i = 0; i < intervals->size(); ++i) {
+            Interval& current = (*intervals)[i];
+            if (out > 0 && current.start_ns <= (*intervals)[out - 1].end_ns) {
+                Interval& last = (*intervals)[out - 1];
+                last.end_ns = std::max(last.end_ns, current.end_ns);
+                last.kinds |= current.kinds;
+            } else {
+                (*intervals)[out++] = current;
+            }
+        }
+        intervals->resize(out);
+    }
+
+    static bool StartsBefore(const Interval& a, const Interval& b) { return a.start_ns < b.start_ns; }
+
+    std::map<std::string, std::vector<Interval> > intervals_;
+    size_t files_;
+    size_t records_;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_ARCHIVE_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_ARCHIVE_H_
+
+#include "TickCompression.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Multi-day archive of compressed tick stores: one <root>/<yyyymmdd>.tpk file per trading day.
+//
+// The block index of each day is the sparse time index (earliest/latest timestamp per block of
+// ~1k events) and carries a symbol bitmap per block. A cursor binary searches the index for
+// the start time and then only decodes blocks whose range and bitmap intersect the request,
+// so starting in the afternoon or replaying one name costs no more than the data it returns.
+// Events are returned in archive order; late events inside the range are kept.
+class TickArchive {
+public:
+    bool Open(const std::string& root)
+    {
+        root_ = root;
+        dates_.clear();
+        DIR* dir = opendir(root.c_str());
+        if (!dir)
+            return false;
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() == 12 && name.compare(8, 4, ".tpk") == 0 &&
+                name.find_first_not_of("0123456789") == 8) {
+                dates_.push_back(name.substr(0, 8));
+            }
+        }
+        closedir(dir);
+        std::sort(dates_.begin(), dates_.end());
+        return !dates_.empty();
+    }
+
+    const std::vector<std::string>& dates() const { return dates_; }
+    std::string DayPath(const std::string& date) const { return root_ + "/" + date + ".tpk"; }
+
+    // Parses "yyyymmdd", "yyyymmdd hh:mm:ss" or "yyyymmdd hh:mm:ss.ffffff" (UTC, like event times)
+    static bool ParseTime(const std::string& text, int64_t* timestamp_ns)
+    {
+        struct tm parts;
+        memset(&parts, 0, sizeof(parts));
+        double seconds = 0.0;
+        int matched = sscanf(text.c_str(), "%4d%2d%2d %d:%d:%lf", &parts.tm_year, &parts.tm_mon, &parts.tm_mday,
+                             &parts.tm_hour, &parts.tm_min, &seconds);
+        if (matched != 3 && matched != 6)
+            return false;
+        parts.tm_year -= 1900;
+        parts.tm_mon -= 1;
+        int64_t whole = int64_t(seconds);
+        parts.tm_sec = int(whole);
+        *timestamp_ns = int64_t(timegm(&parts)) * 1000000000LL + llround((seconds - whole) * 1e9);
+        return true;
+    }
+
+    static std::string DateOf(int64_t timestamp_ns)
+    {
+        time_t seconds = time_t(timestamp_ns / 1000000000LL);
+        struct tm parts;
+        gmtime_r(&seconds, &parts);
+        char buffer[16];
+        strftime(buffer, sizeof(buffer), "%Y%m%d", &parts);
+        return buffer;
+    }
+
+private:
+    std::string root_;
+    std::vector<std::string> dates_;
+};
+
+// Iterates the events of an archive in [start_ns, end_ns) for a set of symbols
+class TickArchiveCursor {
+public:
+    explicit TickArchiveCursor(const TickArchive& archive)
+        : archive_(archive), start_ns_(0), end_ns_(0), day_(0), block_(0), position_(0),
+          blocks_decoded_(0), blocks_skipped_(0)
+    {
+        memset(mask_, 0, sizeof(mask_));
+    }
+
+    // Positions the cursor at the first matching event at or after start_ns. An empty symbol list means all symbols.
+    bool Seek(int64_t start_ns, int64_t end_ns, const std::vector<std::string>& symbols)
+    {
+        start_ns_ = start_ns;
+        end_ns_ = end_ns;
+        symbols_ = symbols;
+        blocks_decoded_ = blocks_skipped_ = 0;
+        decoded_.clear();
+        position_ = 0;
+
+        const std::vector<std::string>& dates = archive_.dates();
+        day_ = std::lower_bound(dates.begin(), dates.end(), TickArchive::DateOf(start_ns)) - dates.begin();
+        return OpenDay(true);
+    }
+
+    // Next matching event, or NULL at the end of the range. The pointer is valid until the next call.
+    const MarketEventRecord* Next()
+    {
+        for (;;) {
+            while (position_ < decoded_.size()) {
+                const MarketEventRecord& record = decoded_[position_++];
+                if (record.timestamp_ns < start_ns_ || record.timestamp_ns >= end_ns_)
+                    continue;
+                if (!symbols_.empty() && !SymbolSelected(record))
+                    continue;
+                return &record;
+            }
+            if (!DecodeNextBlock())
+                return NULL;
+        }
+    }
+
+    uint64_t blocks_decoded() const { return blocks_decoded_; }
+    uint64_t blocks_skipped() const { return blocks_skipped_; }
+
+private:
+    const MarketEventRecord* Finish()
+    {
+        day_ = archive_.dates().size();
+        decoded_.clear();
+        position_ = 0;
+        return NULL;
+    }
+
+    bool OpenDay(bool seek)
+    {
+        const std::vector<std::string>& dates = archive_.dates();
+        for (; day_ < dates.size(); ++day_) {
+            reader_.reset(new CompressedTickReader());
+            if (!reader_->Open(archive_.DayPath(dates[day_])))
+                continue;
+
+            memset(mask_, 0, sizeof(mask_));
+            for (size_t i = 0; i < symbols_.size(); ++i) {
+                int id = reader_->FindSymbol(symbols_[i]);
+                if (id >= 0)
+                    mask_[id >> 6] |= uint64_t(1) << (id & 63);
+            }
+
+            // Sparse index lookup: first block that can hold an event at or after the start
+            block_ = seek ? reader_->SeekBlock(start_ns_) : 0;
+            return true;
+        }
+        return false;
+    }
+
+    bool DecodeNextBlock()
+    {
+        decoded_.clear();
+        position_ = 0;
+        while (day_ < archive_.dates().size()) {
+            while (block_ < reader_->block_count()) {
+                if (reader_->earliest_from(block_) >= end_ns_) {
+                    Finish();
+                    return false;
+                }
+                const CompressedBlockIndex& entry = reader_->block(block_);
+                size_t current = block_++;
+                if (!InRange(entry) || (!symbols_.empty() && !BlockSelected(entry))) {
+                    ++blocks_skipped_;
+                    continue;
+                }
+                decoded_.resize(entry.records);
+                reader_->DecodeBlock(current, &decoded_[0]);
+                ++blocks_decoded_;
+                return true;
+            }
+            ++day_;
+            if (!OpenDay(false))
+                return false;
+        }
+        return false;
+    }
+
+    bool InRange(const CompressedBlockIndex& entry) const
+    {
+        return entry.max_timestamp_ns >= start_ns_ && entry.min_timestamp_ns < end_ns_;
+    }
+
+    bool BlockSelected(const CompressedBlockIndex& entry) const
+    {
+        for (int i = 0; i < TICK_COMPRESSED_MAX_SYMBOLS / 64; ++i) {
+            if (entry.symbol_bitmap[i] & mask_[i])
+                return true;
+        }
+        return false;
+    }
+
+    bool SymbolSelected(const MarketEventRecord& record) const
+    {
+        for (size_t i = 0; i < symbols_.size(); ++i) {
+            if (strncmp(record.symbol, symbols_[i].c_str(), sizeof(record.symbol)) == 0)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    const TickArchive& archive_;
+    int64_t start_ns_;
+    int64_t end_ns_;
+    std::vector<std::string> symbols_;
+    uint64_t mask_[TICK_COMPRESSED_MAX_SYMBOLS / 64];   // requested symbols as ids of the current day
+    size_t day_;
+    size_t block_;
+    std::unique_ptr<CompressedTickReader> reader_;
+    std::vector<MarketEventRecord> decoded_;
+    size_t position_;
+    uint64_t blocks_decoded_;
+    uint64_t blocks_skipped_;
+};
+
+#endif
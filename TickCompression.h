@@ -0,0 +1,591 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_COMPRESSION_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_COMPRESSION_H_
+
+#include "TickStore.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#if defined(__x86_64__)
+    #include <immintrin.h>
+    #define TICK_COMPRESSION_HAS_AVX2 1
+#else
+    #define TICK_COMPRESSION_HAS_AVX2 0
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Compressed variant of the tick store for MarketEventRecord captures.
+//
+// File layout:
+//   TickStoreHeader (record_type MARKET, flags TICK_STORE_FLAG_COMPRESSED)
+//   blocks of up to block_records events, each encoded column by column
+//   symbol table (char[8] per symbol id)
+//   CompressedBlockIndex per block
+//   CompressedStoreFooter
+//
+// Inside a block every column is reduced to small unsigned residuals and bit-packed at the
+// narrowest width that fits the whole block:
+//   timestamps        delta-of-delta, zigzag
+//   symbol, event     raw ids
+//   bid, ask          ticks minus the symbol's first value in the block, zigzag
+//   trade price/size  only for trade events; price as above, size minus block minimum
+//   bid/ask sizes     minus block minimum
+// Fixed widths keep the decoder free of data dependent branches: columns are unpacked four
+// values at a time with AVX2 gathers and per-lane shifts when the CPU has them, and the
+// per-symbol base lookups are straight loops over independent elements; only the two
+// timestamp prefix sums are sequential.
+
+#define TICK_COMPRESSED_FOOTER_MAGIC "SSTPKIDX"
+
+enum {
+    TICK_COMPRESSED_MAX_SYMBOLS = 256,
+    TICK_COMPRESSED_MAX_WIDTH = 56,  // widest column that can be unpacked with one 64 bit load
+    TICK_COMPRESSED_SLACK = 8        // zero bytes after each packed column so the last load stays in bounds
+};
+
+enum TickCompressedColumn {
+    TICK_COLUMN_TIMESTAMP = 0,
+    TICK_COLUMN_SYMBOL,
+    TICK_COLUMN_EVENT_TYPE,
+    TICK_COLUMN_BID,
+    TICK_COLUMN_ASK,
+    TICK_COLUMN_BID_SIZE,
+    TICK_COLUMN_ASK_SIZE,
+    TICK_COLUMN_TRADE_PRICE,
+    TICK_COLUMN_TRADE_SIZE,
+    TICK_COLUMN_COUNT
+};
+
+// Blocks keep the events in arrival order, so a block's time range is its earliest and latest
+// event, and the ranges of neighbouring blocks can overlap when events arrive late
+struct CompressedBlockIndex {
+    int64_t min_timestamp_ns;
+    int64_t max_timestamp_ns;
+    uint64_t offset;                 // from the start of the file
+    uint32_t bytes;
+    uint32_t records;
+    uint64_t symbol_bitmap[TICK_COMPRESSED_MAX_SYMBOLS / 64];
+
+    bool HasSymbol(unsigned id) const { return (symbol_bitmap[id >> 6] >> (id & 63)) & 1; }
+};
+
+struct CompressedStoreFooter {
+    uint64_t index_offset;
+    uint64_t symbol_table_offset;
+    uint64_t record_count;
+    uint32_t block_count;
+    uint32_t symbol_count;
+    double price_scale;              // ticks per unit of price
+    char magic[8];
+};
+
+struct CompressedBlockHeader {
+    uint32_t records;
+    uint32_t trades;
+    uint32_t present_symbols;        // symbols with a price base below, in id order
+    uint8_t widths[TICK_COLUMN_COUNT];
+    uint8_t reserved[3];
+    int64_t first_timestamp_ns;
+    int64_t first_delta_ns;
+    int32_t size_min[3];             // bid size, ask size, trade size
+    int32_t reserved2;
+};
+
+static_assert(sizeof(CompressedBlockIndex) == 64, "CompressedBlockIndex layout changed");
+static_assert(sizeof(CompressedStoreFooter) == 48, "CompressedStoreFooter layout changed");
+static_assert(sizeof(CompressedBlockHeader) == 56, "CompressedBlockHeader layout changed");
+
+inline uint64_t ZigZagEncode(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+inline int64_t ZigZagDecode(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+inline int BitWidth(uint64_t v) { return v == 0 ? 0 : 64 - __builtin_clzll(v); }
+
+inline size_t PackedBytes(size_t count, int width)
+{
+    return ((count * width + 7) / 8 + TICK_COMPRESSED_SLACK + 7) & ~size_t(7);
+}
+
+// Appends count values of the given width to out, padded to PackedBytes
+inline void PackBits(const uint64_t* values, size_t count, int width, std::vector<char>& out)
+{
+    size_t start = out.size();
+    out.resize(start + PackedBytes(count, width), 0);
+    if (width == 0)
+        return;
+    unsigned char* dst = reinterpret_cast<unsigned char*>(&out[start]);
+    for (size_t i = 0; i < count; ++i) {
+        size_t bit = i * width;
+        uint64_t word;
+        memcpy(&word, dst + (bit >> 3), sizeof(word));
+        word |= values[i] << (bit & 7);
+        memcpy(dst + (bit >> 3), &word, sizeof(word));
+    }
+}
+
+inline void UnpackBitsScalar(const unsigned char* src, size_t begin, size_t count, int width, uint64_t* values)
+{
+    const uint64_t mask = (width == 0) ? 0 : (~uint64_t(0) >> (64 - width));
+    for (size_t i = begin; i < count; ++i) {
+        size_t bit = i * width;
+        uint64_t word;
+        memcpy(&word, src + (bit >> 3), sizeof(word));
+        values[i] = (word >> (bit & 7)) & mask;
+    }
+}
+
+#if TICK_COMPRESSION_HAS_AVX2
+// Four values per step: gather the 64 bit words holding each value, then shift each lane by its own bit offset
+__attribute__((target("avx2")))
+inline size_t UnpackBitsAvx2(const unsigned char* src, size_t count, int width, uint64_t* values)
+{
+    const __m256i mask = _mm256_set1_epi64x(int64_t(~uint64_t(0) >> (64 - width)));
+    const __m256i seven = _mm256_set1_epi64x(7);
+    const __m256i step = _mm256_set1_epi64x(int64_t(4 * width));
+    __m256i bits = _mm256_set_epi64x(3 * width, 2 * width, width, 0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i bytes = _mm256_srli_epi64(bits, 3);
+        __m256i words = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(src), bytes, 1);
+        __m256i shifted = _mm256_srlv_epi64(words, _mm256_and_si256(bits, seven));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), _mm256_and_si256(shifted, mask));
+        bits = _mm256_add_epi64(bits, step);
+    }
+    return i;
+}
+#endif
+
+inline void UnpackBits(const unsigned char* src, size_t count, int width, uint64_t* values)
+{
+    size_t done = 0;
+    if (width == 0) {
+        memset(values, 0, count * sizeof(uint64_t));
+        return;
+    }
+#if TICK_COMPRESSION_HAS_AVX2
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+        done = UnpackBitsAvx2(src, count, width, values);
+#endif
+    UnpackBitsScalar(src, done, count, width, values);
+}
+
+class CompressedTickWriter {
+public:
+    CompressedTickWriter()
+        : file_(NULL), price_scale_(10000.0), block_records_(1024), offset_(0), record_count_(0),
+          max_price_error_(0.0), failed_(false)
+    {
+    }
+
+    ~CompressedTickWriter() { Close(); }
+
+    // price_scale must make every price an integer number of ticks to be lossless, see max_price_error.
+    // block_records must be at least 1.
+    bool Open(const std::string& path, double price_scale = 10000.0, size_t block_records = 1024)
+    {
+        Close();
+        if (block_records == 0 || block_records > UINT32_MAX)
+            return false;
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_)
+            return false;
+        price_scale_ = price_scale;
+        block_records_ = block_records;
+        pending_.clear();
+        index_.clear();
+        symbols_.clear();
+        record_count_ = 0;
+        max_price_error_ = 0.0;
+        failed_ = false;
+
+        TickStoreHeader header(TICK_RECORD_TYPE_MARKET, sizeof(MarketEventRecord), 0);
+        header.flags = TICK_STORE_FLAG_COMPRESSED;
+        offset_ = 0;
+        Write(&header, sizeof(header));
+        return !failed_;
+    }
+
+    // False once anything failed, including writing out a full block; the writer then takes no
+    // more records
+    bool Append(const MarketEventRecord& record)
+    {
+        if (failed_)
+            return false;
+        if (SymbolId(record.symbol) < 0) {
+            failed_ = true;
+            return false;
+        }
+        pending_.push_back(record);
+        if (pending_.size() == block_records_)
+            return FlushBlock();
+        return true;
+    }
+
+    // Writes the trailing block, symbol table, index and footer. Returns false if anything failed.
+    bool Close()
+    {
+        if (!file_)
+            return !failed_;
+        FlushBlock();
+
+        CompressedStoreFooter footer;
+        memset(&footer, 0, sizeof(footer));
+        footer.symbol_table_offset = offset_;
+        for (size_t i = 0; i < symbols_.size(); ++i)
+            Write(symbols_[i].name, sizeof(symbols_[i].name));
+        footer.index_offset = offset_;
+        if (!index_.empty())
+            Write(&index_[0], index_.size() * sizeof(CompressedBlockIndex));
+        footer.record_count = record_count_;
+        footer.block_count = uint32_t(index_.size());
+        footer.symbol_count = uint32_t(symbols_.size());
+        footer.price_scale = price_scale_;
+        memcpy(footer.magic, TICK_COMPRESSED_FOOTER_MAGIC, sizeof(footer.magic));
+        Write(&footer, sizeof(footer));
+
+        if (fclose(file_) != 0)
+            failed_ = true;
+        file_ = NULL;
+        return !failed_;
+    }
+
+    uint64_t record_count() const { return record_count_; }
+    uint64_t bytes_written() const { return offset_; }
+    double max_price_error() const { return max_price_error_; }
+
+private:
+    struct SymbolName { char name[8]; };
+
+    int SymbolId(const char* symbol)
+    {
+        for (size_t i = 0; i < symbols_.size(); ++i) {
+            if (memcmp(symbols_[i].name, symbol, sizeof(symbols_[i].name)) == 0)
+                return int(i);
+        }
+        if (symbols_.size() == TICK_COMPRESSED_MAX_SYMBOLS)
+            return -1;
+        SymbolName name;
+        memcpy(name.name, symbol, sizeof(name.name));
+        symbols_.push_back(name);
+        return int(symbols_.size() - 1);
+    }
+
+    int64_t ToTicks(double price)
+    {
+        double scaled = price * price_scale_;
+        int64_t ticks = llround(scaled);
+        double error = fabs(double(ticks) / price_scale_ - price);
+        if (error > max_price_error_)
+            max_price_error_ = error;
+        return ticks;
+    }
+
+    void Write(const void* data, size_t size)
+    {
+        if (size && fwrite(data, 1, size, file_) != size)
+            failed_ = true;
+        offset_ += size;
+    }
+
+    // Bit-packs one column at the narrowest width for the block
+    bool PackColumn(CompressedBlockHeader& header, TickCompressedColumn column, const std::vector<uint64_t>& values)
+    {
+        uint64_t all = 0;
+        for (size_t i = 0; i < values.size(); ++i)
+            all |= values[i];
+        int width = BitWidth(all);
+        if (width > TICK_COMPRESSED_MAX_WIDTH)
+            return false;
+        header.widths[column] = uint8_t(width);
+        PackBits(values.empty() ? NULL : &values[0], values.size(), width, block_);
+        return true;
+    }
+
+    // Encodes and writes the pending records as one block. Returns false if it or an earlier
+    // write failed.
+    bool FlushBlock()
+    {
+        if (failed_)
+            return false;
+        if (pending_.empty())
+            return true;
+
+        const size_t n = pending_.size();
+        CompressedBlockHeader header;
+        memset(&header, 0, sizeof(header));
+        header.records = uint32_t(n);
+
+        CompressedBlockIndex entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.min_timestamp_ns = entry.max_timestamp_ns = pending_[0].timestamp_ns;
+        for (size_t i = 1; i < n; ++i) {
+            entry.min_timestamp_ns = std::min(entry.min_timestamp_ns, pending_[i].timestamp_ns);
+            entry.max_timestamp_ns = std::max(entry.max_timestamp_ns, pending_[i].timestamp_ns);
+        }
+        entry.records = uint32_t(n);
+
+        std::vector<int> ids(n);
+        for (size_t i = 0; i < n; ++i) {
+            ids[i] = SymbolId(pending_[i].symbol);
+            entry.symbol_bitmap[ids[i] >> 6] |= uint64_t(1) << (ids[i] & 63);
+            if (pending_[i].event_type == TICK_EVENT_TYPE_TRADE)
+                ++header.trades;
+        }
+
+        // Per-symbol price bases: the first bid, ask and trade price of the symbol in this block
+        std::vector<int64_t> base(TICK_COMPRESSED_MAX_SYMBOLS * 3, 0);
+        std::vector<char> seen(TICK_COMPRESSED_MAX_SYMBOLS * 3, 0);
+        for (size_t i = 0; i < n; ++i) {
+            const MarketEventRecord& r = pending_[i];
+            int64_t* b = &base[ids[i] * 3];
+            char* s = &seen[ids[i] * 3];
+            if (!s[0]) { b[0] = ToTicks(r.bid); s[0] = 1; }
+            if (!s[1]) { b[1] = ToTicks(r.ask); s[1] = 1; }
+            if (!s[2] && r.event_type == TICK_EVENT_TYPE_TRADE) { b[2] = ToTicks(r.trade_price); s[2] = 1; }
+        }
+        std::vector<int64_t> present_bases;
+        for (int id = 0; id < TICK_COMPRESSED_MAX_SYMBOLS; ++id) {
+            if (entry.HasSymbol(id)) {
+                present_bases.insert(present_bases.end(), &base[id * 3], &base[id * 3] + 3);
+                ++header.present_symbols;
+            }
+        }
+
+        int32_t size_min[3] = { INT32_MAX, INT32_MAX, INT32_MAX };
+        for (size_t i = 0; i < n; ++i) {
+            const MarketEventRecord& r = pending_[i];
+            if (r.bid_size < size_min[0]) size_min[0] = r.bid_size;
+            if (r.ask_size < size_min[1]) size_min[1] = r.ask_size;
+            if (r.event_type == TICK_EVENT_TYPE_TRADE && r.trade_size < size_min[2]) size_min[2] = r.trade_size;
+        }
+        if (header.trades == 0)
+            size_min[2] = 0;
+        memcpy(header.size_min, size_min, sizeof(size_min));
+
+        header.first_timestamp_ns = pending_[0].timestamp_ns;
+        header.first_delta_ns = (n > 1) ? pending_[1].timestamp_ns - pending_[0].timestamp_ns : 0;
+
+        block_.clear();
+        block_.resize(sizeof(header) + present_bases.size() * sizeof(int64_t));
+        if (!present_bases.empty())
+            memcpy(&block_[sizeof(header)], &present_bases[0], present_bases.size() * sizeof(int64_t));
+
+        std::vector<uint64_t> column(n);
+        bool ok = true;
+
+        for (size_t i = 0; i < n; ++i) {
+            if (i < 2) {
+                column[i] = 0;
+            } else {
+                int64_t delta = pending_[i].timestamp_ns - pending_[i - 1].timestamp_ns;
+                int64_t prev_delta = pending_[i - 1].timestamp_ns - pending_[i - 2].timestamp_ns;
+                column[i] = ZigZagEncode(delta - prev_delta);
+            }
+        }
+        ok = ok && PackColumn(header, TICK_COLUMN_TIMESTAMP, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = uint64_t(ids[i]);
+        ok = ok && PackColumn(header, TICK_COLUMN_SYMBOL, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = pending_[i].event_type;
+        ok = ok && PackColumn(header, TICK_COLUMN_EVENT_TYPE, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = ZigZagEncode(ToTicks(pending_[i].bid) - base[ids[i] * 3]);
+        ok = ok && PackColumn(header, TICK_COLUMN_BID, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = ZigZagEncode(ToTicks(pending_[i].ask) - base[ids[i] * 3 + 1]);
+        ok = ok && PackColumn(header, TICK_COLUMN_ASK, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = uint64_t(int64_t(pending_[i].bid_size) - size_min[0]);
+        ok = ok && PackColumn(header, TICK_COLUMN_BID_SIZE, column);
+
+        for (size_t i = 0; i < n; ++i) column[i] = uint64_t(int64_t(pending_[i].ask_size) - size_min[1]);
+        ok = ok && PackColumn(header, TICK_COLUMN_ASK_SIZE, column);
+
+        std::vector<uint64_t> trade_prices, trade_sizes;
+        for (size_t i = 0; i < n; ++i) {
+            if (pending_[i].event_type != TICK_EVENT_TYPE_TRADE)
+                continue;
+            trade_prices.push_back(ZigZagEncode(ToTicks(pending_[i].trade_price) - base[ids[i] * 3 + 2]));
+            trade_sizes.push_back(uint64_t(int64_t(pending_[i].trade_size) - size_min[2]));
+        }
+        ok = ok && PackColumn(header, TICK_COLUMN_TRADE_PRICE, trade_prices);
+        ok = ok && PackColumn(header, TICK_COLUMN_TRADE_SIZE, trade_sizes);
+
+        if (!ok) {
+            failed_ = true;
+            return false;
+        }
+
+        memcpy(&block_[0], &header, sizeof(header));
+        entry.offset = offset_;
+        entry.bytes = uint32_t(block_.size());
+        Write(&block_[0], block_.size());
+        index_.push_back(entry);
+        record_count_ += n;
+        pending_.clear();
+        return !failed_;
+    }
+
+private:
+    FILE* file_;
+    double price_scale_;
+    size_t block_records_;
+    uint64_t offset_;
+    uint64_t record_count_;
+    double max_price_error_;
+    bool failed_;
+    std::vector<MarketEventRecord> pending_;
+    std::vector<char> block_;
+    std::vector<CompressedBlockIndex> index_;
+    std::vector<SymbolName> symbols_;
+};
+
+class CompressedTickReader {
+public:
+    CompressedTickReader() : footer_(), index_(NULL), symbols_(NULL), price_scale_(1.0) {}
+
+    bool Open(const std::string& path, int advice = MADV_SEQUENTIAL)
+    {
+        if (!file_.Open(path, advice) || !file_.compressed())
+            return false;
+        if (file_.size() < sizeof(TickStoreHeader) + sizeof(CompressedStoreFooter))
+            return false;
+        memcpy(&footer_, file_.data() + file_.size() - sizeof(footer_), sizeof(footer_));
+        if (memcmp(footer_.magic, TICK_COMPRESSED_FOOTER_MAGIC, sizeof(footer_.magic)) != 0)
+            return false;
+        if (footer_.index_offset + uint64_t(footer_.block_count) * sizeof(CompressedBlockIndex) > file_.size())
+            return false;
+        index_ = reinterpret_cast<const CompressedBlockIndex*>(file_.data() + footer_.index_offset);
+        symbols_ = file_.data() + footer_.symbol_table_offset;
+        price_scale_ = footer_.price_scale;
+
+        // Running bounds over the block ranges, which are monotone where the ranges are not
+        latest_through_.resize(footer_.block_count);
+        earliest_from_.resize(footer_.block_count);
+        for (size_t i = 0; i < footer_.block_count; ++i)
+            latest_through_[i] = i ? std::max(latest_through_[i - 1], index_[i].max_timestamp_ns) : index_[i].max_timestamp_ns;
+        for (size_t i = footer_.block_count; i-- > 0;) {
+            earliest_from_[i] = (i + 1 < footer_.block_count) ? std::min(earliest_from_[i + 1], index_[i].min_timestamp_ns)
+                                                              : index_[i].min_timestamp_ns;
+        }
+        return true;
+    }
+
+    uint64_t record_count() const { return footer_.record_count; }
+    size_t block_count() const { return footer_.block_count; }
+    const CompressedBlockIndex& block(size_t i) const { return index_[i]; }
+    size_t symbol_count() const { return footer_.symbol_count; }
+    const char* symbol(size_t id) const { return symbols_ + id * 8; }
+    size_t file_size() const { return file_.size(); }
+
+    // First block that can hold an event at or after start_ns; every block before it ends earlier
+    size_t SeekBlock(int64_t start_ns) const
+    {
+        return std::lower_bound(latest_through_.begin(), latest_through_.end(), start_ns) - latest_through_.begin();
+    }
+
+    // Earliest event in block i or any block after it
+    int64_t earliest_from(size_t i) const { return earliest_from_[i]; }
+
+    // Symbol id for a name, or -1 if the file never saw it
+    int FindSymbol(const std::string& name) const
+    {
+        char padded[8];
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, name.c_str(), std::min(name.size(), sizeof(padded)));
+        for (size_t i = 0; i < footer_.symbol_count; ++i) {
+            if (memcmp(symbol(i), padded, sizeof(padded)) == 0)
+                return int(i);
+        }
+        return -1;
+    }
+
+    // Decodes block i into out, which must hold block(i).records entries. Returns the record count.
+    size_t DecodeBlock(size_t i, MarketEventRecord* out)
+    {
+        const char* base = file_.data() + index_[i].offset;
+        CompressedBlockHeader header;
+        memcpy(&header, base, sizeof(header));
+        const size_t n = header.records;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(base + sizeof(header));
+
+        // Expand the per-symbol bases into a lookup indexed by symbol id
+        const int64_t* present = reinterpret_cast<const int64_t*>(p);
+        size_t k = 0;
+        for (int id = 0; id < TICK_COMPRESSED_MAX_SYMBOLS && k < header.present_symbols; ++id) {
+            if (index_[i].HasSymbol(id)) {
+                memcpy(&bases_[id * 3], &present[k * 3], 3 * sizeof(int64_t));
+                ++k;
+            }
+        }
+        p += header.present_symbols * 3 * sizeof(int64_t);
+
+        for (int c = 0; c < TICK_COLUMN_COUNT; ++c) {
+            size_t count = (c >= TICK_COLUMN_TRADE_PRICE) ? header.trades : n;
+            columns_[c].resize(count + 1);
+            UnpackBits(p, count, header.widths[c], &columns_[c][0]);
+            p += PackedBytes(count, header.widths[c]);
+        }
+
+        const uint64_t* ts = &columns_[TICK_COLUMN_TIMESTAMP][0];
+        const uint64_t* sym = &columns_[TICK_COLUMN_SYMBOL][0];
+        const uint64_t* evt = &columns_[TICK_COLUMN_EVENT_TYPE][0];
+        const uint64_t* bid = &columns_[TICK_COLUMN_BID][0];
+        const uint64_t* ask = &columns_[TICK_COLUMN_ASK][0];
+        const uint64_t* bid_size = &columns_[TICK_COLUMN_BID_SIZE][0];
+        const uint64_t* ask_size = &columns_[TICK_COLUMN_ASK_SIZE][0];
+        const uint64_t* trade_price = &columns_[TICK_COLUMN_TRADE_PRICE][0];
+        const uint64_t* trade_size = &columns_[TICK_COLUMN_TRADE_SIZE][0];
+
+        // Independent per-record work first, so it stays a straight loop
+        for (size_t j = 0; j < n; ++j) {
+            MarketEventRecord& r = out[j];
+            const int64_t* b = &bases_[sym[j] * 3];
+            memcpy(r.symbol, symbols_ + sym[j] * 8, sizeof(r.symbol));
+            r.event_type = uint8_t(evt[j]);
+            r.reserved[0] = r.reserved[1] = r.reserved[2] = 0;
+            r.trade_size = 0;
+            r.trade_price = 0.0;
+            r.bid = double(b[0] + ZigZagDecode(bid[j])) / price_scale_;
+            r.ask = double(b[1] + ZigZagDecode(ask[j])) / price_scale_;
+            r.bid_size = int32_t(int64_t(bid_size[j]) + header.size_min[0]);
+            r.ask_size = int32_t(int64_t(ask_size[j]) + header.size_min[1]);
+        }
+
+        int64_t t = header.first_timestamp_ns;
+        int64_t delta = header.first_delta_ns;
+        size_t trade = 0;
+        for (size_t j = 0; j < n; ++j) {
+            if (j >= 2)
+                delta += ZigZagDecode(ts[j]);
+            if (j >= 1)
+                t += delta;
+            out[j].timestamp_ns = t;
+            if (out[j].event_type == TICK_EVENT_TYPE_TRADE) {
+                out[j].trade_price = double(bases_[sym[j] * 3 + 2] + ZigZagDecode(trade_price[trade])) / price_scale_;
+                out[j].trade_size = int32_t(int64_t(trade_size[trade]) + header.size_min[2]);
+                ++trade;
+            }
+        }
+        return n;
+    }
+
+private:
+    TickStoreFile file_;
+    CompressedStoreFooter footer_;
+    const CompressedBlockIndex* index_;
+    const char* symbols_;
+    double price_scale_;
+    std::vector<int64_t> latest_through_;
+    std::vector<int64_t> earliest_from_;
+    int64_t bases_[TICK_COMPRESSED_MAX_SYMBOLS * 3];
+    std::vector<uint64_t> columns_[TICK_COLUMN_COUNT];
+};
+
+#endif
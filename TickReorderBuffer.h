@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_REORDER_BUFFER_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_REORDER_BUFFER_H_
+
+#include "TickStore.h"
+#include "TscClock.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+// Bounded-delay reorder stage for events merged from feeds that disagree on order, e.g. trades and
+// quotes on separate lines, so a trade is never handled against a quote from after it.
+//
+// Events are held in a min-heap keyed on exchange timestamp, ties in arrival order. The watermark
+// is the newest timestamp that has arrived, and an event is released once it is at least
+// max_hold_ns behind the watermark. An event that arrives further behind than that can no longer
+// be put back in order; it is counted as late and released at once. Added latency is measured in
+// stream time, from the watermark at arrival to the watermark at release, so it is the same in a
+// replay as the hold would cost live.
+class TickReorderBuffer {
+public:
+    explicit TickReorderBuffer(int64_t max_hold_ns = 0)
+        : max_hold_ns_(max_hold_ns), watermark_ns_(0), next_sequence_(0), flushing_(false),
+          out_of_order_(0), late_(0), max_held_(0)
+    {
+    }
+
+    void Push(const MarketEventRecord& event)
+    {
+        if (next_sequence_ == 0 || event.timestamp_ns > watermark_ns_) {
+            watermark_ns_ = event.timestamp_ns;
+        } else if (event.timestamp_ns < watermark_ns_) {
+            ++out_of_order_;
+            if (event.timestamp_ns < watermark_ns_ - max_hold_ns_)
+                ++late_;
+        }
+        Held held = { event, next_sequence_++, watermark_ns_ };
+        heap_.push_back(held);
+        std::push_heap(heap_.begin(), heap_.end(), Later);
+        max_held_ = std::max(max_held_, heap_.size());
+    }
+
+    // Copies the next event due for release to *out; false while none is due
+    bool Pop(MarketEventRecord* out)
+    {
+        if (heap_.empty() || (!flushing_ && heap_.front().event.timestamp_ns > watermark_ns_ - max_hold_ns_))
+            return false;
+        std::pop_heap(heap_.begin(), heap_.end(), Later);
+        const Held& held = heap_.back();
+        added_latency_.Record(watermark_ns_ - held.arrival_watermark_ns);
+        *out = held.event;
+        heap_.pop_back();
+        return true;
+    }
+
+    // End of stream: everything still held is due
+    void Flush() { flushing_ = true; }
+
+    int64_t max_hold_ns() const { return max_hold_ns_; }
+    uint64_t events() const { return next_sequence_; }
+    uint64_t out_of_order() const { return out_of_order_; }     // arrived behind the watermark
+    uint64_t late() const { return late_; }                     // ...by more than the hold, left out of order
+    size_t max_held() const { return max_held_; }
+    const LatencyHistogram& added_latency() const { return added_latency_; }
+
+private:
+    struct Held {
+        MarketEventRecord event;
+        uint64_t sequence;
+        int64_t arrival_watermark_ns;
+    };
+
+    // Heap order: the earliest timestamp, then the earliest arrival, on top
+    static bool Later(const Held& a, const Held& b)
+    {
+        if (a.event.timestamp_ns != b.event.timestamp_ns)
+            return a.event.timestamp_ns > b.event.timestamp_ns;
+        return a.sequence > b.sequence;
+    }
+
+    int64_t max_hold_ns_;
+    int64_t watermark_ns_;
+    uint64_t next_sequence_;
+    bool flushing_;
+    uint64_t out_of_order_;
+    uint64_t late_;
+    size_t max_held_;
+    std::vector<Held> heap_;
+    LatencyHistogram added_latency_;
+};
+
+#endif
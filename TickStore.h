@@ -0,0 +1,236 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_STORE_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TICK_STORE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+
+// Binary tick store layout shared by the strategies, the offline tools and tick_store.py.
+//
+// A file is a TickStoreHeader followed by a flat array of fixed-size records of a single
+// record type. Everything is little-endian and naturally aligned so that the records can
+// be mapped directly as a numpy structured array (see tick_store.py) without copying.
+
+#define TICK_STORE_MAGIC "SSTICK1"
+#define TICK_STORE_VERSION 1
+
+enum TickRecordType {
+    TICK_RECORD_TYPE_FEATURE = 1,    // FeatureRecord, written by the feature export mode
+    TICK_RECORD_TYPE_MARKET = 2,     // MarketEventRecord
+    TICK_RECORD_TYPE_ANOMALY = 3,    // AnomalyRecord, written by tick_validate
+    TICK_RECORD_TYPE_DEPTH = 4       // DepthDeltaRecord, written by book_delta
+};
+
+enum TickStoreFlags {
+    TICK_STORE_FLAG_COMPRESSED = 1   // blocks encoded by TickCompression.h instead of a flat record array
+};
+
+enum TickEventType {
+    TICK_EVENT_TYPE_TRADE = 1,
+    TICK_EVENT_TYPE_QUOTE = 2
+};
+
+struct TickStoreHeader {
+    char magic[8];                   // TICK_STORE_MAGIC, NUL padded
+    uint32_t version;                // TICK_STORE_VERSION
+    uint32_t record_type;            // TickRecordType
+    uint32_t record_size;            // sizeof(record), lets readers reject stale layouts
+    uint32_t flags;
+    int64_t created_ns;              // wall clock time the file was opened
+
+    TickStoreHeader(uint32_t type = 0, uint32_t size = 0, int64_t created = 0)
+        : version(TICK_STORE_VERSION), record_type(type), record_size(size), flags(0), created_ns(created)
+    {
+        memset(magic, 0, sizeof(magic));
+        memcpy(magic, TICK_STORE_MAGIC, sizeof(TICK_STORE_MAGIC) - 1);
+    }
+
+    bool IsValid() const { return memcmp(magic, TICK_STORE_MAGIC, sizeof(TICK_STORE_MAGIC) - 1) == 0; }
+};
+
+// One row of the feature vector the strategy saw on a trade or top quote event.
+// Fields that do not apply to the event (eg trade_price on a quote) are left at zero.
+struct FeatureRecord {
+    int64_t timestamp_ns;            // event time, nanoseconds since the unix epoch
+    char symbol[8];                  // NUL padded, truncated if longer
+    uint8_t event_type;              // TickEventType
+    uint8_t vwap_ready;
+    uint16_t reserved;
+    int32_t trade_size;
+    double trade_price;
+    double bid;
+    double ask;
+    int32_t bid_size;
+    int32_t ask_size;
+    double mid;
+    double spread;
+    double vwap;
+    double deviation_bps;
+    double ofi;                      // cumulative top of book order flow imbalance, in shares
+    int32_t position;
+    int32_t window_trades;
+    int64_t window_volume;
+};
+
+// The market data part of an event, without anything derived by a strategy
+struct MarketEventRecord {
+    int64_t timestamp_ns;            // event time, nanoseconds since the unix epoch
+    char symbol[8];                  // NUL padded, truncated if longer
+    uint8_t event_type;              // TickEventType
+    uint8_t reserved[3];
+    int32_t trade_size;
+    double trade_price;
+    double bid;
+    double ask;
+    int32_t bid_size;
+    int32_t ask_size;
+};
+
+// Data-quality problems tick_validate finds in a capture
+enum TickAnomalyKind {
+    TICK_ANOMALY_CROSSED = 1,        // bid > ask
+    TICK_ANOMALY_LOCKED = 2,         // bid == ask
+    TICK_ANOMALY_ZERO_PRICE = 3,     // quote side or trade price/size at or below zero
+    TICK_ANOMALY_STALE_QUOTE = 4,    // same bid/ask for longer than the stale limit while events keep arriving
+    TICK_ANOMALY_CONSTANT_SIZE = 5,  // prices move but the top sizes never change
+    TICK_ANOMALY_TIME_REGRESSION = 6,// timestamp earlier than the previous event in the file
+    TICK_ANOMALY_GAP = 7,            // no events for the symbol for longer than the gap limit
+    TICK_ANOMALY_DUPLICATE = 8,      // byte-identical to the symbol's previous event
+    TICK_ANOMALY_KIND_COUNT = 9
+};
+
+// One run of consecutive anomalous events of one symbol and kind
+struct AnomalyRecord {
+    int64_t start_ns;                // earliest event of the run (for gaps, the last event before it)
+    int64_t end_ns;                  // latest event of the run, inclusive (for gaps, the first event after it)
+    char symbol[8];                  // NUL padded, truncated if longer
+    uint32_t kind;                   // TickAnomalyKind
+    uint32_t events;                 // events in the run, 0 for gaps
+};
+
+enum TickDepthSide {
+    TICK_DEPTH_BID = 0,
+    TICK_DEPTH_ASK = 1
+};
+
+enum TickDepthAction {
+    TICK_DEPTH_ADD = 1,              // price level not in the previous snapshot
+    TICK_DEPTH_MODIFY = 2,           // same price, new size
+    TICK_DEPTH_DELETE = 3            // price level gone from the snapshot
+};
+
+enum TickDepthFlags {
+    TICK_DEPTH_FLAG_LAST = 1         // last change of one snapshot; the book is consistent after it
+};
+
+// One price level change between consecutive top-of-book snapshots of a symbol
+struct DepthDeltaRecord {
+    int64_t timestamp_ns;            // snapshot time, nanoseconds since the unix epoch
+    char symbol[8];                  // NUL padded, truncated if longer
+    double price;
+    int32_t size;                    // size at the price after the change, 0 for deletes
+    uint8_t side;                    // TickDepthSide
+    uint8_t level;                   // 1-based position in the snapshot (in the previous one for deletes)
+    uint8_t action;                  // TickDepthAction
+    uint8_t flags;                   // TickDepthFlags
+};
+
+// Keep in sync with FEATURE_DTYPE, MARKET_DTYPE, ANOMALY_DTYPE and DEPTH_DTYPE in tick_store.py
+static_assert(sizeof(TickStoreHeader) == 32, "TickStoreHeader layout changed");
+static_assert(sizeof(FeatureRecord) == 112, "FeatureRecord layout changed");
+static_assert(sizeof(MarketEventRecord) == 56, "MarketEventRecord layout changed");
+static_assert(sizeof(AnomalyRecord) == 32, "AnomalyRecord layout changed");
+static_assert(sizeof(DepthDeltaRecord) == 32, "DepthDeltaRecord layout changed");
+
+inline MarketEventRecord ToMarketEvent(const FeatureRecord& feature)
+{
+    MarketEventRecord event;
+    memset(&event, 0, sizeof(event));
+    event.timestamp_ns = feature.timestamp_ns;
+    memcpy(event.symbol, feature.symbol, sizeof(event.symbol));
+    event.event_type = feature.event_type;
+    event.trade_size = feature.trade_size;
+    event.trade_price = feature.trade_price;
+    event.bid = feature.bid;
+    event.ask = feature.ask;
+    event.bid_size = feature.bid_size;
+    event.ask_size = feature.ask_size;
+    return event;
+}
+
+// Read-only memory mapping of a tick store file
+class TickStoreFile {
+public:
+    TickStoreFile() : fd_(-1), base_(NULL), size_(0), header_() {}
+    ~TickStoreFile() { Close(); }
+
+    bool Open(const std::string& path, int advice = MADV_SEQUENTIAL)
+    {
+        Close();
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || size_t(st.st_size) < sizeof(TickStoreHeader)) {
+            Close();
+            return false;
+        }
+        size_ = size_t(st.st_size);
+        void* mapped = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (mapped == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        base_ = static_cast<const char*>(mapped);
+        madvise(const_cast<char*>(base_), size_, advice);
+        memcpy(&header_, base_, sizeof(header_));
+        if (!header_.IsValid() || header_.version != TICK_STORE_VERSION || header_.record_size == 0) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (base_)
+            munmap(const_cast<char*>(base_), size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+        base_ = NULL;
+        size_ = 0;
+    }
+
+    const TickStoreHeader& header() const { return header_; }
+    bool compressed() const { return (header_.flags & TICK_STORE_FLAG_COMPRESSED) != 0; }
+    const char* data() const { return base_; }
+    size_t size() const { return size_; }
+
+    // Flat record array of an uncompressed file; a trailing partial record is ignored
+    size_t record_count() const { return compressed() ? 0 : (size_ - sizeof(TickStoreHeader)) / header_.record_size; }
+
+    template<typename RecordType>
+    const RecordType* records() const
+    {
+        return reinterpret_cast<const RecordType*>(base_ + sizeof(TickStoreHeader));
+    }
+
+private:
+    TickStoreFile(const TickStoreFile&);
+    TickStoreFile& operator=(const TickStoreFile&);
+
+    int fd_;
+    const char* base_;
+    size_t size_;
+    TickStoreHeader header_;
+};
+
+#endif
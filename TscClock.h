@@ -0,0 +1,299 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_TSC_CLOCK_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_TSC_CLOCK_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #include <cpuid.h>
+    #define TSC_CLOCK_HAS_RDTSC 1
+#else
+    #define TSC_CLOCK_HAS_RDTSC 0
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Process-wide nanosecond clock for hot path timestamps.
+//
+// Reads the TSC directly and converts ticks to CLOCK_MONOTONIC_RAW nanoseconds with a fixed point
+// multiply. The conversion is calibrated at startup and refined by a helper thread that measures
+// the TSC frequency over an ever longer baseline. Without an invariant TSC every read falls back
+// to clock_gettime, so callers never need to care which source is in use.
+class TscClock {
+public:
+    static TscClock& Instance()
+    {
+        static TscClock clock;
+        return clock;
+    }
+
+    // Raw clock reading, only meaningful relative to other readings or through ToNanos. TSC ticks
+    // when the TSC is invariant, CLOCK_MONOTONIC_RAW nanoseconds otherwise, so the conversions
+    // never see cycles they have no calibration for
+    static inline uint64_t Ticks()
+    {
+#if TSC_CLOCK_HAS_RDTSC
+        if (UsesTsc())
+            return __rdtsc();
+#endif
+        return uint64_t(MonotonicRawNanos());
+    }
+
+    // Whether Ticks() reads the TSC; decided once per process
+    static inline bool UsesTsc()
+    {
+        static const bool invariant = HasInvariantTsc();
+        return invariant;
+    }
+
+    inline int64_t NowNanos() const
+    {
+        return invariant_tsc_ ? ToNanos(Ticks()) : MonotonicRawNanos();
+    }
+
+    // Converts a Ticks() reading to CLOCK_MONOTONIC_RAW nanoseconds
+    inline int64_t ToNanos(uint64_t ticks) const
+    {
+        if (!invariant_tsc_)
+            return int64_t(ticks);
+
+        uint64_t base_ticks, mult;
+        int64_t base_ns;
+        uint32_t seq;
+        do {
+            seq = seq_.load(std::memory_order_acquire);
+            base_ticks = base_ticks_.load(std::memory_order_relaxed);
+            base_ns = base_ns_.load(std::memory_order_relaxed);
+            mult = mult_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+
+        int64_t delta = int64_t(ticks - base_ticks);
+        return base_ns + int64_t((__int128(delta) * __int128(mult)) >> kShift);
+    }
+
+    // Converts a tick interval (end - start) to nanoseconds
+    inline int64_t TicksToNanos(uint64_t ticks) const
+    {
+        if (!invariant_tsc_)
+            return int64_t(ticks);
+        return int64_t((unsigned __int128)(ticks) * mult_.load(std::memory_order_relaxed) >> kShift);
+    }
+
+    bool invariant_tsc() const { return invariant_tsc_; }
+    double ticks_per_ns() const { return ticks_per_ns_.load(std::memory_order_relaxed); }
+
+    // Average cost of one NowNanos() call, measured at startup
+    double read_overhead_ns() const { return read_overhead_ns_; }
+
+    static int64_t MonotonicRawNanos()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    static bool HasInvariantTsc()
+    {
+#if TSC_CLOCK_HAS_RDTSC
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+            return false;
+        __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+        return (edx & (1u << 8)) != 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    enum {
+        kShift = 32,
+        kCalibrationMillis = 50,
+        kRecalibrationSeconds = 10
+    };
+
+    TscClock()
+        : invariant_tsc_(UsesTsc()), seq_(0), base_ticks_(0), base_ns_(0), mult_(uint64_t(1) << kShift),
+          ticks_per_ns_(1.0), anchor_ticks_(0), anchor_ns_(0), read_overhead_ns_(0.0), stopping_(false)
+    {
+        if (invariant_tsc_) {
+            Calibrate();
+            recalibrator_ = std::thread(&TscClock::RecalibrationLoop, this);
+        }
+        MeasureReadOverhead();
+    }
+
+    ~TscClock()
+    {
+        if (recalibrator_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            stop_.notify_one();
+            recalibrator_.join();
+        }
+    }
+
+    TscClock(const TscClock&);
+    TscClock& operator=(const TscClock&);
+
+    // Reads both clocks as close together as possible
+    static void Sample(uint64_t* ticks, int64_t* ns)
+    {
+        uint64_t before = Ticks();
+        *ns = MonotonicRawNanos();
+        uint64_t after = Ticks();
+        *ticks = before + (after - before) / 2;
+    }
+
+    void Calibrate()
+    {
+        Sample(&anchor_ticks_, &anchor_ns_);
+        int64_t deadline = anchor_ns_ + kCalibrationMillis * 1000000LL;
+        uint64_t ticks;
+        int64_t ns;
+        do {
+            Sample(&ticks, &ns);
+        } while (ns < deadline);
+        Publish(ticks, ns, double(ticks - anchor_ticks_) / double(ns - anchor_ns_));
+    }
+
+    // Refines the frequency against the startup anchor; the base is re-anchored on the current
+    // conversion so readings never step backwards when the frequency estimate moves
+    void Recalibrate()
+    {
+        uint64_t ticks;
+        int64_t ns;
+        Sample(&ticks, &ns);
+        int64_t continuous_ns = ToNanos(ticks);
+        Publish(ticks, continuous_ns, double(ticks - anchor_ticks_) / double(ns - anchor_ns_));
+    }
+
+    void Publish(uint64_t ticks, int64_t ns, double ticks_per_ns)
+    {
+        uint64_t mult = uint64_t(double(uint64_t(1) << kShift) / ticks_per_ns);
+        seq_.fetch_add(1, std::memory_order_acq_rel);
+        base_ticks_.store(ticks, std::memory_order_relaxed);
+        base_ns_.store(ns, std::memory_order_relaxed);
+        mult_.store(mult, std::memory_order_relaxed);
+        ticks_per_ns_.store(ticks_per_ns, std::memory_order_relaxed);
+        seq_.fetch_add(1, std::memory_order_release);
+    }
+
+    void RecalibrationLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_.wait_for(lock, std::chrono::seconds(kRecalibrationSeconds), [this] { return stopping_; })) {
+            Recalibrate();
+        }
+    }
+
+    void MeasureReadOverhead()
+    {
+        const int reads = 10000;
+        int64_t start = MonotonicRawNanos();
+        int64_t sink = 0;
+        for (int i = 0; i < reads; ++i)
+            sink += NowNanos();
+        int64_t elapsed = MonotonicRawNanos() - start;
+        read_overhead_ns_ = (sink != 0) ? double(elapsed) / reads : 0.0;
+    }
+
+private:
+    const bool invariant_tsc_;
+    std::atomic<uint32_t> seq_;      // odd while Publish is updating the conversion
+    std::atomic<uint64_t> base_ticks_;
+    std::atomic<int64_t> base_ns_;
+    std::atomic<uint64_t> mult_;     // ns per tick << kShift
+    std::atomic<double> ticks_per_ns_;
+    uint64_t anchor_ticks_;
+    int64_t anchor_ns_;
+    double read_overhead_ns_;
+    bool stopping_;
+    std::mutex mutex_;
+    std::condition_variable stop_;
+    std::thread recalibrator_;
+};
+
+// Log2 bucketed latency histogram, cheap enough to update on every callback
+class LatencyHistogram {
+public:
+    enum { kBuckets = 40 };
+
+    LatencyHistogram() { Reset(); }
+
+    void Reset()
+    {
+        for (int i = 0; i < kBuckets; ++i)
+            buckets_[i] = 0;
+        count_ = 0;
+        total_ns_ = 0;
+        max_ns_ = 0;
+    }
+
+    inline void Record(int64_t ns)
+    {
+        if (ns < 0)
+            ns = 0;
+        int bucket = (ns == 0) ? 0 : 64 - __builtin_clzll(uint64_t(ns));
+        ++buckets_[bucket < kBuckets ? bucket : kBuckets - 1];
+        ++count_;
+        total_ns_ += ns;
+        if (ns > max_ns_)
+            max_ns_ = ns;
+    }
+
+    // Upper bound of the bucket holding the given quantile (0..1)
+    int64_t Quantile(double q) const
+    {
+        if (count_ == 0)
+            return 0;
+        uint64_t target = uint64_t(q * double(count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += buckets_[i];
+            if (seen >= target)
+                return (i == 0) ? 0 : (int64_t(1) << i) - 1;
+        }
+        return max_ns_;
+    }
+
+    uint64_t count() const { return count_; }
+    double mean_ns() const { return count_ ? double(total_ns_) / count_ : 0.0; }
+    int64_t max_ns() const { return max_ns_; }
+
+private:
+    uint64_t buckets_[kBuckets];     // bucket i holds [2^(i-1), 2^i) ns
+    uint64_t count_;
+    int64_t total_ns_;
+    int64_t max_ns_;
+};
+
+// Records the lifetime of the enclosing scope into a LatencyHistogram
+class ScopedLatencyTimer {
+public:
+    explicit ScopedLatencyTimer(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(TscClock::Ticks())
+    {
+    }
+
+    ~ScopedLatencyTimer()
+    {
+        histogram_.Record(TscClock::Instance().TicksToNanos(TscClock::Ticks() - start_));
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    uint64_t start_;
+};
+
+#endif
@@ -21,40 +21,93 @@ using namespace std;
 
 VWAPStrategy::VWAPStrategy(StrategyID strategyID, const std::string& strategyName, const std::string& groupName):
     Strategy(strategyID, strategyName, groupName),
-    vwap_window_(),
-    cumulative_pv_(0.0),
-    cumulative_volume_(0),
+    vwap_window_(300, 1800),
     vwap_window_seconds_(300),
+    vwap_max_horizon_seconds_(1800),
     entry_threshold_bps_(0.1),
     max_inventory_(5),
     position_size_(1),
-    debug_(true)
+    debug_(true),
+    symbol_params_file_(),
+    symbol_params_(),
+    symbol_param_file_table_(),
+    symbol_param_overrides_(),
+    instrument_slots_(),
+    slot_symbols_(),
+    slot_params_(),
+    slot_signals_(),
+    export_features_(false),
+    export_prefix_(strategyName),
+    export_date_(),
+    feature_writer_(),
+    quote_state_map_(),
+    record_market_data_(false),
+    record_date_(),
+    market_recorder_(),
+    shadow_variants_(),
+    shadow_book_(),
+    on_trade_latency_(),
+    profiler_(),
+    on_trade_profile_(profiler_.Register("OnTrade")),
+    on_top_quote_profile_(profiler_.Register("OnTopQuote")),
+    on_order_update_profile_(profiler_.Register("OnOrderUpdate"))
 {
+    // Calibrate the clock before the first event rather than inside it
+    TscClock::Instance();
 }
 
 VWAPStrategy::~VWAPStrategy()
 {
+    feature_writer_.Close();
+    market_recorder_.Close();
+#ifdef CALLBACK_PROFILE
+    // The logger may already be gone at shutdown, so the final profile goes to a file
+    std::string path = export_prefix_ + "_profile.txt";
+    if (FILE* out = fopen(path.c_str(), "w")) {
+        fputs(profiler_.Report().c_str(), out);
+        fclose(out);
+    }
+#endif
 }
 
 void VWAPStrategy::OnResetStrategyState()
 {
-    vwap_window_.clear();
-    cumulative_pv_ = 0.0;
-    cumulative_volume_ = 0;
+    vwap_window_.Clear();
+    quote_state_map_.clear();
+    feature_writer_.Flush();
+    shadow_book_.Reset();
+    for (size_t slot = 0; slot < slot_signals_.size(); ++slot) {
+        slot_signals_[slot] = VWAPSignalGraph();
+        slot_signals_[slot].SetParams(slot_params_[slot]);
+    }
+    on_trade_latency_.Reset();
+    profiler_.Reset();
 }
 
 void VWAPStrategy::DefineStrategyParams()
 {
-    params().CreateParam(CreateStrategyParamArgs("vwap_window_seconds", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_INT, vwap_window_seconds_));
+    params().CreateParam(CreateStrategyParamArgs("vwap_window_seconds", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_INT, vwap_window_seconds_));
+    params().CreateParam(CreateStrategyParamArgs("vwap_max_horizon_seconds", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_INT, vwap_max_horizon_seconds_));
     params().CreateParam(CreateStrategyParamArgs("entry_threshold_bps", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_DOUBLE, entry_threshold_bps_));
     params().CreateParam(CreateStrategyParamArgs("max_inventory", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_INT, max_inventory_));
     params().CreateParam(CreateStrategyParamArgs("position_size", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_INT, position_size_));
+    params().CreateParam(CreateStrategyParamArgs("symbol_params_file", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_STRING, symbol_params_file_));
+    params().CreateParam(CreateStrategyParamArgs("symbol_params", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_STRING, symbol_params_));
     params().CreateParam(CreateStrategyParamArgs("debug", STRATEGY_PARAM_TYPE_RUNTIME, VALUE_TYPE_BOOL, debug_));
+    params().CreateParam(CreateStrategyParamArgs("export_features", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_BOOL, export_features_));
+    params().CreateParam(CreateStrategyParamArgs("record_market_data", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_BOOL, record_market_data_));
+    params().CreateParam(CreateStrategyParamArgs("shadow_variants", STRATEGY_PARAM_TYPE_STARTUP, VALUE_TYPE_STRING, shadow_variants_));
 }
 
 void VWAPStrategy::DefineStrategyCommands()
 {
     commands().AddCommand(StrategyCommand(1, "Cancel All Orders"));
+    commands().AddCommand(StrategyCommand(2, "Log Latency Stats"));
+    commands().AddCommand(StrategyCommand(3, "Log Shadow Results"));
+    commands().AddCommand(StrategyCommand(4, "Log Callback Profile"));
+    commands().AddCommand(StrategyCommand(5, "Log Symbol Params"));
+    commands().AddCommand(StrategyCommand(6, "Log Recording Stats"));
+    commands().AddCommand(StrategyCommand(8, "Log Signal Graph"));
 }
 
 void VWAPStrategy::RegisterForStrategyEvents(StrategyEventRegister* eventRegister, DateType currDate)
@@ -64,34 +117,58 @@ void VWAPStrategy::RegisterForStrategyEvents(StrategyEventRegister* eventRegiste
     for (auto it = symbols_begin(); it != symbols_end(); ++it) {
         eventRegister->RegisterForFutures(*it);
     }
+
+    if (!symbol_params_file_.empty()) {
+        std::string error;
+        if (!symbol_param_file_table_.LoadFile(symbol_params_file_, &error))
+            throw StrategyStudioException("Could not load symbol_params_file: " + error);
+        RefreshSymbolParams();
+        LogSymbolParams();
+    }
+
+    if (export_features_) {
+        OpenFeatureExport(currDate);
+    }
+
+    if (record_market_data_) {
+        OpenMarketRecording(currDate);
+    }
 }
 
 void VWAPStrategy::OnTrade(const TradeDataEventMsg& msg)
 {
+    PROFILE_CALLBACK(profiler_, on_trade_profile_);
+    ScopedLatencyTimer latency_timer(on_trade_latency_);
+
+    if (record_market_data_) {
+        RecordMarketEvent(&msg.instrument(), TICK_EVENT_TYPE_TRADE, msg.event_time(), msg.trade().price(), msg.trade().size());
+    }
+
     // 1. Add this trade to our VWAP window
     AddTradeToWindow(msg.trade().price(), msg.trade().size(), msg.event_time());
     
     // 2. Remove trades older than our window size
-    boost::posix_time::time_duration window_duration = boost::posix_time::seconds(vwap_window_seconds_);
-    Utilities::TimeType cutoff_time = msg.event_time() - window_duration;
-    PruneOldTrades(cutoff_time);
+    PruneOldTrades(msg.event_time());
+
+    if (export_features_) {
+        ExportFeatures(&msg.instrument(), TICK_EVENT_TYPE_TRADE, msg.event_time(), msg.trade().price(), msg.trade().size());
+    }
     
-    // 3. Skip trading logic if VWAP window not ready (need 5 minutes of data)
-    if (!IsVWAPReady()) {
+    // 3. Skip trading logic if VWAP window not ready (need 5 minutes of data). The signal graph
+    // only takes the window here; VWAP, mid and deviation are computed when something reads them
+    const Instrument* instr = &msg.instrument();
+    size_t slot = InstrumentSlot(instr);
+    VWAPSignalGraph& signal = slot_signals_[slot];
+    signal.SetWindow(IsVWAPReady(), vwap_window_.cumulative_pv(), vwap_window_.cumulative_volume());
+    if (!signal.window_ready()) {
         if (debug_) {
             ostringstream str;
             str << "VWAP window not ready yet (size=" << vwap_window_.size() << ")";
             logger().LogToClient(LOGLEVEL_DEBUG, str.str());
         }
-        std::cout << "Skipped" << std::endl;
         return;
     }
     
-    // 4. Calculate current VWAP and mid-price
-    double vwap = GetVWAP();
-    const Instrument* instr = &msg.instrument();
-    
-    std::cout << "vwap" << std::endl;
     // Validate quote before proceeding
     if (!instr->top_quote().IsValid()) {
         if (debug_) {
@@ -100,76 +177,75 @@ void VWAPStrategy::OnTrade(const TradeDataEventMsg& msg)
         return;
     }
     
-    double mid_price = CalculateMidPrice(instr);
-    double deviation_bps = CalculateDeviation(mid_price, vwap);
-    
-    // Get current position from portfolio tracker
+    // 4. Hand the graph the quote and the current position from the portfolio tracker
+    signal.SetQuote(instr->top_quote().bid(), instr->top_quote().ask());
     int current_position = portfolio().position(instr);
+    signal.SetPosition(current_position);
     
     // Debug logging
     if (debug_) {
         ostringstream str;
         str << instr->symbol() 
             << " | Trade: " << msg.trade().size() << "@" << msg.trade().price()
-            << " | Mid=" << mid_price 
-            << " | VWAP=" << vwap 
-            << " | Dev=" << deviation_bps << "bps"
+            << " | Mid=" << signal.mid() 
+            << " | VWAP=" << signal.vwap() 
+            << " | Dev=" << signal.deviation_bps() << "bps"
             << " | Pos=" << current_position;
         logger().LogToClient(LOGLEVEL_DEBUG, str.str());
     }
-    std::cout << instr->symbol()
-            << " | Trade: " << msg.trade().size() << "@" << msg.trade().price()
-            << " | Mid=" << mid_price
-            << " | VWAP=" << vwap
-            << " | Dev=" << deviation_bps << "bps"
-            << " | Pos=" << current_position << std::endl;
-    
-    // 5. Determine desired position based on VWAP deviation
-    int desired_position = 0;
-    
-    // Exit logic: if we have a position and price has reverted to VWAP
-    if (current_position > 0 && deviation_bps >= 0) {
-        // Long position and price >= VWAP, exit to flat
-        desired_position = 0;
-        if (debug_) {
-            logger().LogToClient(LOGLEVEL_DEBUG, "EXIT LONG signal - price reverted to VWAP");
-        }
-    }
-    else if (current_position < 0 && deviation_bps <= 0) {
-        // Short position and price <= VWAP, exit to flat
-        desired_position = 0;
-        if (debug_) {
-            logger().LogToClient(LOGLEVEL_DEBUG, "EXIT SHORT signal - price reverted to VWAP");
-        }
+
+    // Shadow variants see the same deviation but only trade virtually
+    if (shadow_book_.variant_count() > 0) {
+        UpdateShadows(slot, instr, signal.deviation_bps());
     }
-    // Entry logic: only if not at max inventory
-    else if (abs(current_position) < max_inventory_) {
-        if (deviation_bps < -entry_threshold_bps_) {
-            // BUY signal: price significantly below VWAP
-            desired_position = current_position + position_size_;
-            if (debug_) {
-                ostringstream str;
-                str << "ENTRY BUY signal (dev=" << deviation_bps << "bps)";
-                logger().LogToClient(LOGLEVEL_DEBUG, str.str());
-            }
-        }
-        else if (deviation_bps > entry_threshold_bps_) {
-            // SELL signal: price significantly above VWAP
-            desired_position = current_position - position_size_;
-            if (debug_) {
+
+    // 5. Determine desired position based on VWAP deviation, with this symbol's parameters
+    const VWAPDecision& decision = signal.decision();
+    
+    if (debug_) {
+        switch (decision.signal) {
+            case VWAP_SIGNAL_EXIT_LONG:
+                logger().LogToClient(LOGLEVEL_DEBUG, "EXIT LONG signal - price reverted to VWAP");
+                break;
+            case VWAP_SIGNAL_EXIT_SHORT:
+                logger().LogToClient(LOGLEVEL_DEBUG, "EXIT SHORT signal - price reverted to VWAP");
+                break;
+            case VWAP_SIGNAL_ENTRY_BUY:
+            case VWAP_SIGNAL_ENTRY_SELL: {
                 ostringstream str;
-                str << "ENTRY SELL signal (dev=" << deviation_bps << "bps)";
+                str << "ENTRY " << (decision.signal == VWAP_SIGNAL_ENTRY_BUY ? "BUY" : "SELL")
+                    << " signal (dev=" << signal.deviation_bps() << "bps)";
                 logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+                break;
             }
+            default:
+                break;
         }
     }
     
     // 6. Adjust portfolio if desired position differs from current
-    AdjustPortfolio(instr, desired_position);
+    AdjustPortfolio(instr, decision.desired_position);
+}
+
+void VWAPStrategy::OnTopQuote(const QuoteEventMsg& msg)
+{
+    PROFILE_CALLBACK(profiler_, on_top_quote_profile_);
+
+    if (record_market_data_) {
+        RecordMarketEvent(&msg.instrument(), TICK_EVENT_TYPE_QUOTE, msg.event_time(), 0.0, 0);
+    }
+
+    // Quotes only feed the feature export, trading decisions are made in OnTrade
+    if (export_features_) {
+        UpdateOrderFlowImbalance(&msg.instrument());
+        ExportFeatures(&msg.instrument(), TICK_EVENT_TYPE_QUOTE, msg.event_time(), 0.0, 0);
+    }
 }
 
 void VWAPStrategy::OnOrderUpdate(const OrderUpdateEventMsg& msg)
 {
+    PROFILE_CALLBACK(profiler_, on_order_update_profile_);
+
     if (debug_) {
         ostringstream str;
         str << "Order Update - OrderID: " << msg.order_id()
@@ -260,6 +336,24 @@ void VWAPStrategy::OnStrategyCommand(const StrategyCommandEventMsg& msg)
             trade_actions()->SendCancelAll();
             logger().LogToClient(LOGLEVEL_DEBUG, "Cancelled all orders via command");
             break;
+        case 2:
+            LogLatencyStats();
+            break;
+        case 3:
+            LogShadowResults();
+            break;
+        case 4:
+            LogCallbackProfile();
+            break;
+        case 5:
+            LogSymbolParams();
+            break;
+        case 6:
+            LogRecordingStats();
+            break;
+        case 8:
+            LogSignalGraph();
+            break;
         default:
             logger().LogToClient(LOGLEVEL_DEBUG, "Unknown strategy command received");
             break;
@@ -269,31 +363,80 @@ void VWAPStrategy::OnStrategyCommand(const StrategyCommandEventMsg& msg)
 void VWAPStrategy::OnParamChanged(StrategyParam& param)
 {
     if (param.param_name() == "vwap_window_seconds") {
-        if (!param.Get(&vwap_window_seconds_))
+        int seconds;
+        if (!param.Get(&seconds))
             throw StrategyStudioException("Could not get vwap_window_seconds");
+        if (seconds <= 0)
+            throw StrategyStudioException("vwap_window_seconds must be positive");
+        vwap_window_seconds_ = seconds;
+        // Moves the window cursor over the retained history, no warmup needed
+        vwap_window_.SetWindowSeconds(vwap_window_seconds_);
+        CheckWindowHorizon();
+    } else if (param.param_name() == "vwap_max_horizon_seconds") {
+        int seconds;
+        if (!param.Get(&seconds))
+            throw StrategyStudioException("Could not get vwap_max_horizon_seconds");
+        if (seconds <= 0)
+            throw StrategyStudioException("vwap_max_horizon_seconds must be positive");
+        vwap_max_horizon_seconds_ = seconds;
+        vwap_window_.SetMaxHorizonSeconds(vwap_max_horizon_seconds_);
+        CheckWindowHorizon();
     } else if (param.param_name() == "entry_threshold_bps") {
         if (!param.Get(&entry_threshold_bps_))
             throw StrategyStudioException("Could not get entry_threshold_bps");
+        RefreshSymbolParams();
     } else if (param.param_name() == "max_inventory") {
         if (!param.Get(&max_inventory_))
             throw StrategyStudioException("Could not get max_inventory");
+        RefreshSymbolParams();
     } else if (param.param_name() == "position_size") {
         if (!param.Get(&position_size_))
             throw StrategyStudioException("Could not get position_size");
+        RefreshSymbolParams();
+    } else if (param.param_name() == "symbol_params_file") {
+        // Loaded in RegisterForStrategyEvents
+        if (!param.Get(&symbol_params_file_))
+            throw StrategyStudioException("Could not get symbol_params_file");
+    } else if (param.param_name() == "symbol_params") {
+        if (!param.Get(&symbol_params_))
+            throw StrategyStudioException("Could not get symbol_params");
+        std::string error;
+        if (!symbol_param_overrides_.Parse(symbol_params_, &error))
+            throw StrategyStudioException("Could not parse symbol_params: " + error);
+        RefreshSymbolParams();
     } else if (param.param_name() == "debug") {
         if (!param.Get(&debug_))
             throw StrategyStudioException("Could not get debug");
+    } else if (param.param_name() == "export_features") {
+        if (!param.Get(&export_features_))
+            throw StrategyStudioException("Could not get export_features");
+    } else if (param.param_name() == "record_market_data") {
+        if (!param.Get(&record_market_data_))
+            throw StrategyStudioException("Could not get record_market_data");
+    } else if (param.param_name() == "shadow_variants") {
+        if (!param.Get(&shadow_variants_))
+            throw StrategyStudioException("Could not get shadow_variants");
+        if (!shadow_book_.Configure(shadow_variants_))
+            throw StrategyStudioException("Could not parse shadow_variants, expected threshold_bps:max_inventory:position_size,... with threshold_bps >= 0");
     }
 }
 
 // VWAP Calculation Helper Methods
 
+// The two params arrive one at a time, so a window past the horizon is logged rather than rejected
+void VWAPStrategy::CheckWindowHorizon()
+{
+    if (vwap_window_seconds_ > vwap_max_horizon_seconds_) {
+        ostringstream str;
+        str << "vwap_window_seconds " << vwap_window_seconds_ << " exceeds vwap_max_horizon_seconds "
+            << vwap_max_horizon_seconds_ << ", VWAP is computed over the last " << vwap_window_.window_seconds() << "s";
+        logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+    }
+}
+
 void VWAPStrategy::AddTradeToWindow(double price, int volume, Utilities::TimeType timestamp)
 {
-    VWAPTradeRecord record(timestamp, price, volume);
-    vwap_window_.push_back(record);
-    cumulative_pv_ += price * volume;
-    cumulative_volume_ += volume;
+    vwap_window_.Add(ToEpochNanos(timestamp), price, volume);
     
     if (debug_) {
         ostringstream str;
@@ -304,16 +447,9 @@ void VWAPStrategy::AddTradeToWindow(double price, int volume, Utilities::TimeTyp
     }
 }
 
-void VWAPStrategy::PruneOldTrades(Utilities::TimeType cutoff_time)
+void VWAPStrategy::PruneOldTrades(Utilities::TimeType now)
 {
-    int removed_count = 0;
-    while (!vwap_window_.empty() && vwap_window_.front().timestamp < cutoff_time) {
-        const VWAPTradeRecord& old_record = vwap_window_.front();
-        cumulative_pv_ -= old_record.price * old_record.volume;
-        cumulative_volume_ -= old_record.volume;
-        vwap_window_.pop_front();
-        removed_count++;
-    }
+    int removed_count = vwap_window_.Advance(ToEpochNanos(now));
     
     if (debug_ && removed_count > 0) {
         ostringstream str;
@@ -324,22 +460,14 @@ void VWAPStrategy::PruneOldTrades(Utilities::TimeType cutoff_time)
 
 double VWAPStrategy::GetVWAP() const
 {
-    if (cumulative_volume_ == 0) {
-        return 0.0;
-    }
-    return cumulative_pv_ / cumulative_volume_;
+    return vwap_window_.vwap();
 }
 
 bool VWAPStrategy::IsVWAPReady() const
 {
     // VWAP is ready when we have at least the specified window duration of data
     const int MIN_TRADE_REQUIRED = 3;
-    if (vwap_window_.size() >= MIN_TRADE_REQUIRED) {
-        return true;
-    }
-    
-    boost::posix_time::time_duration window_span = vwap_window_.back().timestamp - vwap_window_.front().timestamp;
-    return window_span.total_seconds() >= vwap_window_seconds_;
+    return vwap_window_.Ready(MIN_TRADE_REQUIRED);
 }
 
 double VWAPStrategy::CalculateMidPrice(const Instrument* instrument) const
@@ -350,9 +478,269 @@ double VWAPStrategy::CalculateMidPrice(const Instrument* instrument) const
 
 double VWAPStrategy::CalculateDeviation(double mid_price, double vwap) const
 {
-    if (vwap == 0.0) {
-        return 0.0;
+    return VWAPDeviationBps(mid_price, vwap);
+}
+
+int64_t VWAPStrategy::ToEpochNanos(Utilities::TimeType time)
+{
+    static const Utilities::TimeType epoch(boost::gregorian::date(1970, 1, 1));
+    return (time - epoch).total_microseconds() * 1000;
+}
+
+
+void VWAPStrategy::LogLatencyStats()
+{
+    const TscClock& clock = TscClock::Instance();
+    ostringstream str;
+    str << "OnTrade latency: count=" << on_trade_latency_.count()
+        << " mean=" << on_trade_latency_.mean_ns() << "ns"
+        << " p50<=" << on_trade_latency_.Quantile(0.5) << "ns"
+        << " p99<=" << on_trade_latency_.Quantile(0.99) << "ns"
+        << " max=" << on_trade_latency_.max_ns() << "ns"
+        << " | clock: " << (clock.invariant_tsc() ? "tsc" : "clock_gettime")
+        << " read=" << clock.read_overhead_ns() << "ns";
+    logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+}
+
+void VWAPStrategy::LogCallbackProfile()
+{
+#ifdef CALLBACK_PROFILE
+    logger().LogToClient(LOGLEVEL_DEBUG, "Callback profile:\n" + profiler_.Report());
+#else
+    logger().LogToClient(LOGLEVEL_DEBUG, "Callback profiling is off, rebuild with make PROFILE=1");
+#endif
+}
+
+// Per-Symbol Parameter Helper Methods
+
+size_t VWAPStrategy::InstrumentSlot(const Instrument* instrument)
+{
+    boost::unordered_map<const Instrument*, size_t>::iterator it = instrument_slots_.find(instrument);
+    if (it != instrument_slots_.end()) {
+        return it->second;
     }
-    return ((mid_price - vwap) / vwap) * 10000.0;  // Convert to basis points
+    size_t slot = slot_symbols_.size();
+    slot_symbols_.push_back(instrument->symbol());
+    slot_params_.push_back(ResolveSymbolParams(instrument->symbol()));
+    slot_signals_.push_back(VWAPSignalGraph());
+    slot_signals_.back().SetParams(slot_params_.back());
+    instrument_slots_.insert(std::make_pair(instrument, slot));
+    return slot;
 }
 
+// Global params, overlaid by the startup file, overlaid by the runtime overrides
+VWAPSymbolParams VWAPStrategy::ResolveSymbolParams(const std::string& symbol) const
+{
+    VWAPSymbolParams defaults = { entry_threshold_bps_, max_inventory_, position_size_ };
+    return symbol_param_overrides_.Resolve(symbol, symbol_param_file_table_.Resolve(symbol, defaults));
+}
+
+void VWAPStrategy::RefreshSymbolParams()
+{
+    for (size_t slot = 0; slot < slot_symbols_.size(); ++slot) {
+        slot_params_[slot] = ResolveSymbolParams(slot_symbols_[slot]);
+        slot_signals_[slot].SetParams(slot_params_[slot]);
+    }
+}
+
+void VWAPStrategy::LogSymbolParams()
+{
+    for (auto it = symbols_begin(); it != symbols_end(); ++it) {
+        VWAPSymbolParams params = ResolveSymbolParams(*it);
+        ostringstream str;
+        str << *it << " | threshold=" << params.entry_threshold_bps << "bps"
+            << " max_inventory=" << params.max_inventory
+            << " position_size=" << params.position_size;
+        logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+    }
+}
+
+// How often each node of every symbol's signal graph was evaluated since the last reset; nodes
+// below the trade count were skipped on trades that did not need them
+void VWAPStrategy::LogSignalGraph()
+{
+    for (size_t slot = 0; slot < slot_signals_.size(); ++slot) {
+        ostringstream str;
+        str << slot_symbols_[slot] << " | evaluations";
+        for (int node = 0; node < VWAP_NODE_COUNT; ++node) {
+            str << " " << VWAPSignalNodeName(node) << "=" << slot_signals_[slot].evaluations(node);
+        }
+        logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+    }
+}
+
+// Shadow Variant Helper Methods
+
+void VWAPStrategy::UpdateShadows(size_t slot, const Instrument* instrument, double deviation_bps)
+{
+    // Configure() drops the slots, so they are re-created on demand
+    while (shadow_book_.slot_count() <= slot) {
+        shadow_book_.AddSlot();
+    }
+    const Quote& top_quote = instrument->top_quote();
+    shadow_book_.Update(slot, deviation_bps, top_quote.bid(), top_quote.ask());
+}
+
+void VWAPStrategy::LogShadowResults()
+{
+    if (shadow_book_.variant_count() == 0) {
+        logger().LogToClient(LOGLEVEL_DEBUG, "No shadow variants configured");
+        return;
+    }
+    for (size_t i = 0; i < shadow_book_.variant_count(); ++i) {
+        ostringstream str;
+        str << "Shadow " << i
+            << " | threshold=" << shadow_book_.entry_threshold_bps(i) << "bps"
+            << " max_inventory=" << shadow_book_.max_inventory(i)
+            << " position_size=" << shadow_book_.position_size(i)
+            << " | PnL=" << shadow_book_.pnl(i)
+            << " trades=" << shadow_book_.trades(i)
+            << " volume=" << shadow_book_.traded_volume(i)
+            << " gross_position=" << shadow_book_.gross_position(i);
+        logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+    }
+}
+
+// Feature Export Helper Methods
+
+void VWAPStrategy::OpenFeatureExport(DateType currDate)
+{
+    if (feature_writer_.is_open() && export_date_ == currDate) {
+        return;
+    }
+
+    // One file per trading day: <prefix>_features_<yyyymmdd>.bin
+    std::string path = export_prefix_ + "_features_" + boost::gregorian::to_iso_string(currDate) + ".bin";
+    if (!feature_writer_.Open(path, TICK_RECORD_TYPE_FEATURE, sizeof(FeatureRecord))) {
+        logger().LogToClient(LOGLEVEL_DEBUG, "Could not open feature export file " + path + ", export disabled");
+        export_features_ = false;
+        return;
+    }
+    export_date_ = currDate;
+    logger().LogToClient(LOGLEVEL_DEBUG, "Exporting features to " + path);
+}
+
+void VWAPStrategy::UpdateOrderFlowImbalance(const Instrument* instrument)
+{
+    const Quote& quote = instrument->top_quote();
+    if (!quote.IsValid()) {
+        return;
+    }
+
+    VWAPQuoteState& state = quote_state_map_[instrument];
+    double bid = quote.bid();
+    double ask = quote.ask();
+    int bid_size = quote.bid_size();
+    int ask_size = quote.ask_size();
+
+    // Cont, Kukanov & Stoikov: bid side inflow minus ask side inflow since the previous quote
+    if (state.bid > 0.0 && state.ask > 0.0) {
+        double e = 0.0;
+        if (bid >= state.bid) e += bid_size;
+        if (bid <= state.bid) e -= state.bid_size;
+        if (ask <= state.ask) e -= ask_size;
+        if (ask >= state.ask) e += state.ask_size;
+        state.ofi += e;
+    }
+
+    state.bid = bid;
+    state.ask = ask;
+    state.bid_size = bid_size;
+    state.ask_size = ask_size;
+}
+
+void VWAPStrategy::ExportFeatures(const Instrument* instrument, TickEventType event_type, Utilities::TimeType event_time,
+                                  double trade_price, int trade_size)
+{
+    if (!feature_writer_.is_open()) {
+        return;
+    }
+
+    FeatureRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = ToEpochNanos(event_time);
+    strncpy(record.symbol, instrument->symbol().c_str(), sizeof(record.symbol));
+    record.event_type = static_cast<uint8_t>(event_type);
+    record.vwap_ready = IsVWAPReady() ? 1 : 0;
+    record.trade_price = trade_price;
+    record.trade_size = trade_size;
+
+    const Quote& quote = instrument->top_quote();
+    if (quote.IsValid()) {
+        record.bid = quote.bid();
+        record.ask = quote.ask();
+        record.bid_size = quote.bid_size();
+        record.ask_size = quote.ask_size();
+        record.mid = CalculateMidPrice(instrument);
+        record.spread = record.ask - record.bid;
+    }
+
+    record.vwap = GetVWAP();
+    record.deviation_bps = (record.mid > 0.0) ? CalculateDeviation(record.mid, record.vwap) : 0.0;
+
+    boost::unordered_map<const Instrument*, VWAPQuoteState>::const_iterator it = quote_state_map_.find(instrument);
+    record.ofi = (it != quote_state_map_.end()) ? it->second.ofi : 0.0;
+
+    record.position = portfolio().position(instrument);
+    record.window_trades = static_cast<int32_t>(vwap_window_.size());
+    record.window_volume = vwap_window_.cumulative_volume();
+
+    feature_writer_.Append(record);
+}
+
+// Market Data Recording Helper Methods
+
+void VWAPStrategy::OpenMarketRecording(DateType currDate)
+{
+    if (market_recorder_.is_open() && record_date_ == currDate) {
+        return;
+    }
+
+    // One file per trading day: <prefix>_market_<yyyymmdd>.bin, packable with tickpack
+    std::string path = export_prefix_ + "_market_" + boost::gregorian::to_iso_string(currDate) + ".bin";
+    if (!market_recorder_.Open(path)) {
+        logger().LogToClient(LOGLEVEL_DEBUG, "Could not open market data recording " + path + ", recording disabled");
+        record_market_data_ = false;
+        return;
+    }
+    record_date_ = currDate;
+    logger().LogToClient(LOGLEVEL_DEBUG, "Recording market data to " + path);
+}
+
+void VWAPStrategy::RecordMarketEvent(const Instrument* instrument, TickEventType event_type, Utilities::TimeType event_time,
+                                     double trade_price, int trade_size)
+{
+    if (!market_recorder_.is_open()) {
+        return;
+    }
+
+    MarketEventRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = ToEpochNanos(event_time);
+    strncpy(record.symbol, instrument->symbol().c_str(), sizeof(record.symbol));
+    record.event_type = static_cast<uint8_t>(event_type);
+    record.trade_price = trade_price;
+    record.trade_size = trade_size;
+
+    const Quote& quote = instrument->top_quote();
+    if (quote.IsValid()) {
+        record.bid = quote.bid();
+        record.ask = quote.ask();
+        record.bid_size = quote.bid_size();
+        record.ask_size = quote.ask_size();
+    }
+
+    market_recorder_.Record(record);
+}
+
+void VWAPStrategy::LogRecordingStats()
+{
+    ostringstream str;
+    str << "Market data recording: " << (market_recorder_.is_open() ? "on" : "off")
+        << " recorded=" << market_recorder_.recorded()
+        << " written=" << market_recorder_.written()
+        << " dropped=" << market_recorder_.dropped()
+        << " write_errors=" << market_recorder_.write_errors()
+        << " buffer=" << market_recorder_.capacity() << " events";
+    logger().LogToClient(LOGLEVEL_DEBUG, str.str());
+}
@@ -14,20 +14,28 @@
 #include <Strategy.h>
 #include <MarketModels/Instrument.h>
 #include <Utilities/ParseConfig.h>
+#include "CallbackProfiler.h"
+#include "FeatureExport.h"
+#include "MarketRecorder.h"
+#include "TscClock.h"
+#include "VWAPShadow.h"
+#include "VWAPSignal.h"
+#include "VWAPSignalGraph.h"
+#include "VWAPSymbolParams.h"
 #include <map>
 #include <iostream>
-#include <deque>
 
 using namespace RCM::StrategyStudio;
 
-// Structure to hold trade data for VWAP calculation
-struct VWAPTradeRecord {
-    Utilities::TimeType timestamp;
-    double price;
-    int volume;
-    
-    VWAPTradeRecord(Utilities::TimeType t, double p, int v) 
-        : timestamp(t), price(p), volume(v) {}
+// Last top of book seen per instrument, used to accumulate order flow imbalance for the feature export
+struct VWAPQuoteState {
+    double bid;
+    double ask;
+    int bid_size;
+    int ask_size;
+    double ofi;
+
+    VWAPQuoteState() : bid(0.0), ask(0.0), bid_size(0), ask_size(0), ofi(0.0) {}
 };
 
 class VWAPStrategy : public Strategy {
@@ -37,7 +45,7 @@ public:
 
 public: /* from IEventCallback */
     virtual void OnTrade(const TradeDataEventMsg& msg);
-    virtual void OnTopQuote(const QuoteEventMsg& msg) {}
+    virtual void OnTopQuote(const QuoteEventMsg& msg);
     virtual void OnQuote(const QuoteEventMsg& msg) {}
     virtual void OnDepth(const MarketDepthEventMsg& msg) {}
     virtual void OnBar(const BarEventMsg& msg) {}
@@ -61,25 +69,88 @@ private:
     void SendOrder(const Instrument* instrument, int trade_size);
     
     // VWAP calculation helpers
+    void CheckWindowHorizon();
     void AddTradeToWindow(double price, int volume, Utilities::TimeType timestamp);
-    void PruneOldTrades(Utilities::TimeType cutoff_time);
+    void PruneOldTrades(Utilities::TimeType now);
     double GetVWAP() const;
     bool IsVWAPReady() const;
     double CalculateMidPrice(const Instrument* instrument) const;
     double CalculateDeviation(double mid_price, double vwap) const;
+    static int64_t ToEpochNanos(Utilities::TimeType time);
+    void LogLatencyStats();
+    void LogCallbackProfile();
+
+    // Per-symbol parameter helpers
+    size_t InstrumentSlot(const Instrument* instrument);
+    VWAPSymbolParams ResolveSymbolParams(const std::string& symbol) const;
+    void RefreshSymbolParams();
+    void LogSymbolParams();
+    void LogSignalGraph();
+
+    // Shadow variant helpers
+    void UpdateShadows(size_t slot, const Instrument* instrument, double deviation_bps);
+    void LogShadowResults();
+
+    // Feature export helpers
+    void OpenFeatureExport(DateType currDate);
+    void UpdateOrderFlowImbalance(const Instrument* instrument);
+    void ExportFeatures(const Instrument* instrument, TickEventType event_type, Utilities::TimeType event_time,
+                        double trade_price, int trade_size);
+
+    // Market data recording helpers
+    void OpenMarketRecording(DateType currDate);
+    void RecordMarketEvent(const Instrument* instrument, TickEventType event_type, Utilities::TimeType event_time,
+                           double trade_price, int trade_size);
+    void LogRecordingStats();
 
 private:
     // VWAP calculation
-    std::deque<VWAPTradeRecord> vwap_window_;
-    double cumulative_pv_;           // Sum of (price * volume)
-    int cumulative_volume_;          // Sum of volume
+    VWAPWindow vwap_window_;
     int vwap_window_seconds_;        // Rolling window size (default 300 = 5 min)
+    int vwap_max_horizon_seconds_;   // Trade history kept so the window can grow at runtime (default 1800)
     
     // Strategy parameters
     double entry_threshold_bps_;     // Deviation threshold to enter (default 2.0)
     int max_inventory_;              // Maximum position size (default 5)
     int position_size_;              // Shares per order (default 1)
     bool debug_;                     // Enable debug logging
+
+    // Per-symbol entry parameters, resolved into one slot per instrument whenever the globals,
+    // the startup file or the runtime overrides change, so OnTrade reads them by slot
+    std::string symbol_params_file_; // CSV: symbol,entry_threshold_bps,max_inventory,position_size
+    std::string symbol_params_;      // Runtime overrides "SYMBOL:threshold_bps:max_inventory:position_size,..."
+    VWAPSymbolParamTable symbol_param_file_table_;
+    VWAPSymbolParamTable symbol_param_overrides_;
+    boost::unordered_map<const Instrument*, size_t> instrument_slots_;
+    std::vector<std::string> slot_symbols_;
+    std::vector<VWAPSymbolParams> slot_params_;
+    std::vector<VWAPSignalGraph> slot_signals_;
+
+    // Feature export
+    bool export_features_;           // Append the feature vector of every trade/quote to a tick store file
+    std::string export_prefix_;      // Output file prefix, defaults to the strategy name
+    DateType export_date_;
+    TickStoreWriter feature_writer_;
+    boost::unordered_map<const Instrument*, VWAPQuoteState> quote_state_map_;
+
+    // Market data recording: callbacks run on the strategy's one event thread, which is the
+    // recorder's single producer
+    bool record_market_data_;        // Copy every trade/quote the strategy is handed to a tick store file
+    DateType record_date_;
+    MarketRecorder market_recorder_;
+
+    // Shadow variants: alternative parameter sets traded virtually on the live OnTrade stream
+    std::string shadow_variants_;    // "threshold_bps:max_inventory:position_size,..."
+    VWAPShadowBook shadow_book_;     // Slots follow instrument_slots_
+
+    // Callback latency, timed with the TSC clock
+    LatencyHistogram on_trade_latency_;
+
+    // Allocation and hardware counter totals per callback, only collected with make PROFILE=1
+    CallbackProfiler profiler_;
+    size_t on_trade_profile_;
+    size_t on_top_quote_profile_;
+    size_t on_order_update_profile_;
 };
 
 extern "C" {
@@ -0,0 +1,200 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SHADOW_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SHADOW_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__)
+    #define VWAP_SHADOW_HAS_AVX2 1
+#else
+    #define VWAP_SHADOW_HAS_AVX2 0
+#endif
+
+#include <string>
+#include <vector>
+
+// One pass over all variants of a slot. Bitwise rather than short-circuit logic keeps the loop
+// free of branches. GCC only vectorizes the mixed int/double widths from AVX2 on, so
+// VWAPShadowBook::Update picks the AVX2 clone at runtime when the CPU has it.
+__attribute__((always_inline))
+inline void UpdateVWAPShadows(size_t n, double deviation_bps, double bid, double ask, const double* threshold,
+                              const int* max_inventory, const int* size, int* position, double* cash,
+                              int64_t* volume, int64_t* trades)
+{
+    int up = deviation_bps >= 0;
+    int down = deviation_bps <= 0;
+    double negated = -deviation_bps;
+    for (size_t i = 0; i < n; ++i) {
+        int current = position[i];
+        int exit = ((current > 0) & up) | ((current < 0) & down);
+        int magnitude = current < 0 ? -current : current;
+        int entry = ((threshold[i] < negated) - (threshold[i] < deviation_bps)) * size[i];
+        // Same as DecideVWAPPosition: anything but an entry below max inventory targets flat
+        int take = (exit ^ 1) & (magnitude < max_inventory[i]) & (entry != 0);
+        int desired = take * (current + entry);
+        int trade = desired - current;
+        double price = trade > 0 ? ask : bid;
+        cash[i] -= trade * price;
+        volume[i] += trade < 0 ? -trade : trade;
+        trades[i] += trade != 0;
+        position[i] = desired;
+    }
+}
+
+#if VWAP_SHADOW_HAS_AVX2
+__attribute__((target("avx2")))
+inline void UpdateVWAPShadowsAvx2(size_t n, double deviation_bps, double bid, double ask, const double* threshold,
+                                  const int* max_inventory, const int* size, int* position, double* cash,
+                                  int64_t* volume, int64_t* trades)
+{
+    UpdateVWAPShadows(n, deviation_bps, bid, ask, threshold, max_inventory, size, position, cash, volume, trades);
+}
+#endif
+
+// Shadow evaluation of alternative VWAP parameter sets on the live trade stream.
+//
+// Every variant applies the same entry/exit rules as DecideVWAPPosition to the live deviation,
+// but trades a virtual position that fills immediately at the touch and never sends orders.
+// State is kept as structure of arrays: parameters and cash per variant, and positions in one
+// contiguous block of variant_count() ints per instrument slot, so one trade updates all
+// variants in a single branch-free loop the compiler can vectorize.
+class VWAPShadowBook {
+public:
+    VWAPShadowBook() {}
+
+    // Parses "threshold_bps:max_inventory:position_size,..." e.g. "0.5:5:1,2.0:10:2". An empty spec disables shadows.
+    // Negative thresholds are rejected, see AddVariant.
+    bool Configure(const std::string& spec)
+    {
+        std::vector<double> thresholds;
+        std::vector<int> inventories, sizes;
+        size_t start = 0;
+        while (start < spec.size()) {
+            size_t comma = spec.find(',', start);
+            if (comma == std::string::npos)
+                comma = spec.size();
+            double threshold;
+            int inventory, size;
+            if (sscanf(spec.substr(start, comma - start).c_str(), "%lf:%d:%d", &threshold, &inventory, &size) != 3 ||
+                !(threshold >= 0.0))
+                return false;
+            thresholds.push_back(threshold);
+            inventories.push_back(inventory);
+            sizes.push_back(size);
+            start = comma + 1;
+        }
+        Clear();
+        for (size_t i = 0; i < thresholds.size(); ++i)
+            AddVariant(thresholds[i], inventories[i], sizes[i]);
+        return true;
+    }
+
+    // Removes all variants and slots
+    void Clear()
+    {
+        entry_threshold_bps_.clear();
+        max_inventory_.clear();
+        position_size_.clear();
+        position_.clear();
+        mid_.clear();
+        Reset();
+    }
+
+    // Variants must all be added before the first AddSlot. entry_threshold_bps must not be negative:
+    // the branch-free kernel scores a buy and a sell against each other, which only matches
+    // DecideVWAPPosition when the two entry bands cannot overlap.
+    void AddVariant(double entry_threshold_bps, int max_inventory, int position_size)
+    {
+        entry_threshold_bps_.push_back(entry_threshold_bps);
+        max_inventory_.push_back(max_inventory);
+        position_size_.push_back(position_size);
+        Reset();
+    }
+
+    // Zeroes virtual positions and PnL, keeping the variants and slots
+    void Reset()
+    {
+        size_t n = variant_count();
+        cash_.assign(n, 0.0);
+        traded_volume_.assign(n, 0);
+        trades_.assign(n, 0);
+        position_.assign(position_.size(), 0);
+        mid_.assign(mid_.size(), 0.0);
+    }
+
+    // Adds an instrument and returns its slot
+    size_t AddSlot()
+    {
+        position_.resize(position_.size() + variant_count(), 0);
+        mid_.push_back(0.0);
+        return mid_.size() - 1;
+    }
+
+    // Applies one live trade's deviation to every variant of the instrument in slot
+    void Update(size_t slot, double deviation_bps, double bid, double ask)
+    {
+        size_t n = variant_count();
+        int* position = &position_[slot * n];
+        const double* threshold = &entry_threshold_bps_[0];
+        const int* max_inventory = &max_inventory_[0];
+        const int* size = &position_size_[0];
+        double* cash = &cash_[0];
+        int64_t* volume = &traded_volume_[0];
+        int64_t* trades = &trades_[0];
+        mid_[slot] = (bid + ask) / 2.0;
+
+#if VWAP_SHADOW_HAS_AVX2
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        if (has_avx2) {
+            UpdateVWAPShadowsAvx2(n, deviation_bps, bid, ask, threshold, max_inventory, size, position, cash, volume, trades);
+            return;
+        }
+#endif
+        UpdateVWAPShadows(n, deviation_bps, bid, ask, threshold, max_inventory, size, position, cash, volume, trades);
+    }
+
+    size_t variant_count() const { return entry_threshold_bps_.size(); }
+    size_t slot_count() const { return mid_.size(); }
+
+    double entry_threshold_bps(size_t i) const { return entry_threshold_bps_[i]; }
+    int max_inventory(size_t i) const { return max_inventory_[i]; }
+    int position_size(size_t i) const { return position_size_[i]; }
+    int64_t traded_volume(size_t i) const { return traded_volume_[i]; }
+    int64_t trades(size_t i) const { return trades_[i]; }
+    int position(size_t slot, size_t i) const { return position_[slot * variant_count() + i]; }
+
+    // Cash plus every slot's position marked to the last live mid
+    double pnl(size_t i) const
+    {
+        double value = cash_[i];
+        size_t n = variant_count();
+        for (size_t slot = 0; slot < mid_.size(); ++slot)
+            value += position_[slot * n + i] * mid_[slot];
+        return value;
+    }
+
+    // Sum of absolute positions across slots
+    int gross_position(size_t i) const
+    {
+        int gross = 0;
+        size_t n = variant_count();
+        for (size_t slot = 0; slot < mid_.size(); ++slot)
+            gross += abs(position_[slot * n + i]);
+        return gross;
+    }
+
+private:
+    std::vector<double> entry_threshold_bps_;
+    std::vector<int> max_inventory_;
+    std::vector<int> position_size_;
+    std::vector<double> cash_;
+    std::vector<int64_t> traded_volume_;
+    std::vector<int64_t> trades_;
+    std::vector<int> position_;      // [slot * variant_count() + variant]
+    std::vector<double> mid_;        // last live mid per slot
+};
+
+#endif
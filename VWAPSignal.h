@@ -0,0 +1,198 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SIGNAL_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SIGNAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <deque>
+
+// Structure to hold trade data for VWAP calculation
+struct VWAPTradeRecord {
+    int64_t timestamp_ns;            // event time, nanoseconds since the unix epoch
+    double price;
+    int volume;
+
+    VWAPTradeRecord(int64_t t, double p, int v)
+        : timestamp_ns(t), price(p), volume(v) {}
+};
+
+// Rolling time window VWAP that keeps trades for up to max_horizon_seconds.
+//
+// Only trades from the cursor onwards are part of the window. Trades that fall out of the
+// window stay in the history until they are older than the horizon, so the window length can
+// be changed at runtime by moving the cursor back or forward over the retained trades instead
+// of rebuilding the accumulators or waiting for a new warmup.
+class VWAPWindow {
+public:
+    VWAPWindow(int window_seconds = 300, int max_horizon_seconds = 1800)
+        : history_(), start_(0), cumulative_pv_(0.0), cumulative_volume_(0), last_time_ns_(0),
+          window_seconds_(window_seconds), max_horizon_seconds_(max_horizon_seconds)
+    {
+    }
+
+    void Clear()
+    {
+        history_.clear();
+        start_ = 0;
+        cumulative_pv_ = 0.0;
+        cumulative_volume_ = 0;
+        last_time_ns_ = 0;
+    }
+
+    void Add(int64_t timestamp_ns, double price, int volume)
+    {
+        history_.push_back(VWAPTradeRecord(timestamp_ns, price, volume));
+        cumulative_pv_ += price * volume;
+        cumulative_volume_ += volume;
+        if (timestamp_ns > last_time_ns_)
+            last_time_ns_ = timestamp_ns;
+    }
+
+    // Moves the cursor past trades older than the window and drops trades older than the horizon.
+    // Returns the number of trades that left the window.
+    int Advance(int64_t now_ns)
+    {
+        if (now_ns > last_time_ns_)
+            last_time_ns_ = now_ns;
+
+        int64_t cutoff = last_time_ns_ - int64_t(window_seconds()) * 1000000000LL;
+        int removed = 0;
+        while (start_ < history_.size() && history_[start_].timestamp_ns < cutoff) {
+            const VWAPTradeRecord& old_record = history_[start_];
+            cumulative_pv_ -= old_record.price * old_record.volume;
+            cumulative_volume_ -= old_record.volume;
+            ++start_;
+            ++removed;
+        }
+
+        // The window never exceeds the horizon, so anything dropped here is already behind the cursor
+        int64_t horizon_cutoff = last_time_ns_ - int64_t(max_horizon_seconds_) * 1000000000LL;
+        while (start_ > 0 && history_.front().timestamp_ns < horizon_cutoff) {
+            history_.pop_front();
+            --start_;
+        }
+        return removed;
+    }
+
+    // Changes the window length, re-admitting retained trades when it grows
+    void SetWindowSeconds(int seconds)
+    {
+        window_seconds_ = seconds;
+        Reposition();
+    }
+
+    void SetMaxHorizonSeconds(int seconds)
+    {
+        max_horizon_seconds_ = seconds;
+        Reposition();
+    }
+
+    double vwap() const
+    {
+        if (cumulative_volume_ == 0)
+            return 0.0;
+        return cumulative_pv_ / cumulative_volume_;
+    }
+
+    bool empty() const { return start_ == history_.size(); }
+    size_t size() const { return history_.size() - start_; }
+    size_t retained() const { return history_.size(); }
+    const VWAPTradeRecord& front() const { return history_[start_]; }
+    const VWAPTradeRecord& back() const { return history_.back(); }
+
+    double cumulative_pv() const { return cumulative_pv_; }
+    int64_t cumulative_volume() const { return cumulative_volume_; }
+
+    // Enough data to trade on: a few trades, or a single trade spanning the whole window
+    bool Ready(size_t min_trades = 3) const
+    {
+        if (size() >= min_trades)
+            return true;
+        if (empty())
+            return false;
+        return (back().timestamp_ns - front().timestamp_ns) / 1000000000LL >= window_seconds();
+    }
+
+    // Effective window length, capped by the retention horizon. Callers validate both lengths as positive
+    // and report a window longer than the horizon.
+    int window_seconds() const { return window_seconds_ < max_horizon_seconds_ ? window_seconds_ : max_horizon_seconds_; }
+    int max_horizon_seconds() const { return max_horizon_seconds_; }
+
+private:
+    void Reposition()
+    {
+        if (history_.empty())
+            return;
+
+        int64_t cutoff = last_time_ns_ - int64_t(window_seconds()) * 1000000000LL;
+        while (start_ > 0 && history_[start_ - 1].timestamp_ns >= cutoff) {
+            --start_;
+            const VWAPTradeRecord& record = history_[start_];
+            cumulative_pv_ += record.price * record.volume;
+            cumulative_volume_ += record.volume;
+        }
+        Advance(last_time_ns_);
+    }
+
+private:
+    std::deque<VWAPTradeRecord> history_;
+    size_t start_;                   // index of the oldest trade inside the window
+    double cumulative_pv_;           // Sum of (price * volume) inside the window
+    int64_t cumulative_volume_;      // Sum of volume inside the window
+    int64_t last_time_ns_;
+    int window_seconds_;
+    int max_horizon_seconds_;
+};
+
+enum VWAPSignalType {
+    VWAP_SIGNAL_NONE = 0,            // no exit or entry: target is flat
+    VWAP_SIGNAL_EXIT_LONG,
+    VWAP_SIGNAL_EXIT_SHORT,
+    VWAP_SIGNAL_ENTRY_BUY,
+    VWAP_SIGNAL_ENTRY_SELL
+};
+
+struct VWAPDecision {
+    int desired_position;
+    VWAPSignalType signal;
+};
+
+inline double VWAPDeviationBps(double mid_price, double vwap)
+{
+    if (vwap == 0.0)
+        return 0.0;
+    return ((mid_price - vwap) / vwap) * 10000.0;  // Convert to basis points
+}
+
+// Target position after a trade, shared by VWAPStrategy::OnTrade and the offline replay tools
+inline VWAPDecision DecideVWAPPosition(int current_position, double deviation_bps, double entry_threshold_bps,
+                                       int max_inventory, int position_size)
+{
+    VWAPDecision decision = { 0, VWAP_SIGNAL_NONE };
+
+    // Exit logic: if we have a position and price has reverted to VWAP
+    if (current_position > 0 && deviation_bps >= 0) {
+        decision.signal = VWAP_SIGNAL_EXIT_LONG;
+    }
+    else if (current_position < 0 && deviation_bps <= 0) {
+        decision.signal = VWAP_SIGNAL_EXIT_SHORT;
+    }
+    // Entry logic: only if not at max inventory
+    else if (abs(current_position) < max_inventory) {
+        if (deviation_bps < -entry_threshold_bps) {
+            // BUY signal: price significantly below VWAP
+            decision.desired_position = current_position + position_size;
+            decision.signal = VWAP_SIGNAL_ENTRY_BUY;
+        }
+        else if (deviation_bps > entry_threshold_bps) {
+            // SELL signal: price significantly above VWAP
+            decision.desired_position = current_position - position_size;
+            decision.signal = VWAP_SIGNAL_ENTRY_SELL;
+        }
+    }
+    return decision;
+}
+
+#endif
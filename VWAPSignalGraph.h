@@ -0,0 +1,199 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SIGNAL_GRAPH_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SIGNAL_GRAPH_H_
+
+#include "VWAPSignal.h"
+#include "VWAPSymbolParams.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Incremental dataflow graph of one instrument's trading signal.
+//
+// Events only set inputs and mark the nodes that depend on them dirty; a node is evaluated when a
+// consumer asks for it, once per change of its inputs. The dependencies are declared per node
+// below and resolved at compile time, so marking is one OR of a constant mask and pulling a node
+// inlines the checks of everything beneath it. Per-node evaluation counts show what was skipped.
+
+enum VWAPSignalNode {
+    VWAP_NODE_WINDOW = 0,            // window readiness and running sums after the latest trade
+    VWAP_NODE_VWAP,                  // volume weighted average price of the window
+    VWAP_NODE_MID,                   // mid of the latest valid top of book
+    VWAP_NODE_DEVIATION,             // mid against VWAP, in bps
+    VWAP_NODE_THRESHOLDS,            // the instrument's entry threshold, inventory and size
+    VWAP_NODE_DECISION,              // target position
+    VWAP_NODE_COUNT
+};
+
+#define VWAP_NODE_BIT(node) (1u << (node))
+
+// Direct inputs of each node. A node may only depend on nodes listed before it, so the enum order
+// is a topological order; checked below.
+template <int Node> struct VWAPNodeInputs;
+template <> struct VWAPNodeInputs<VWAP_NODE_WINDOW> { static const unsigned mask = 0; };
+template <> struct VWAPNodeInputs<VWAP_NODE_VWAP> { static const unsigned mask = VWAP_NODE_BIT(VWAP_NODE_WINDOW); };
+template <> struct VWAPNodeInputs<VWAP_NODE_MID> { static const unsigned mask = 0; };
+template <> struct VWAPNodeInputs<VWAP_NODE_DEVIATION> {
+    static const unsigned mask = VWAP_NODE_BIT(VWAP_NODE_VWAP) | VWAP_NODE_BIT(VWAP_NODE_MID);
+};
+template <> struct VWAPNodeInputs<VWAP_NODE_THRESHOLDS> { static const unsigned mask = 0; };
+template <> struct VWAPNodeInputs<VWAP_NODE_DECISION> {
+    static const unsigned mask = VWAP_NODE_BIT(VWAP_NODE_DEVIATION) | VWAP_NODE_BIT(VWAP_NODE_THRESHOLDS);
+};
+
+template <int Limit> struct VWAPNodesOrdered {
+    static const bool value = VWAPNodesOrdered<Limit - 1>::value && VWAPNodeInputs<Limit - 1>::mask < VWAP_NODE_BIT(Limit - 1);
+};
+template <> struct VWAPNodesOrdered<0> { static const bool value = true; };
+static_assert(VWAPNodesOrdered<VWAP_NODE_COUNT>::value, "signal graph nodes must be listed after their inputs");
+
+// Nodes before Limit that depend on Node, directly or through other nodes
+template <int Node, int Limit> struct VWAPNodeDependents {
+    static const unsigned below = VWAPNodeDependents<Node, Limit - 1>::mask;
+    static const unsigned mask =
+        below | ((VWAPNodeInputs<Limit - 1>::mask & (below | VWAP_NODE_BIT(Node))) ? VWAP_NODE_BIT(Limit - 1) : 0u);
+};
+template <int Node> struct VWAPNodeDependents<Node, 0> { static const unsigned mask = 0; };
+
+inline const char* VWAPSignalNodeName(int node)
+{
+    static const char* names[VWAP_NODE_COUNT] = { "window", "vwap", "mid", "deviation", "thresholds", "decision" };
+    return node >= 0 && node < VWAP_NODE_COUNT ? names[node] : "unknown";
+}
+
+class VWAPSignalGraph {
+public:
+    VWAPSignalGraph()
+        : dirty_((1u << VWAP_NODE_COUNT) - 1), input_ready_(false), input_pv_(0.0), input_volume_(0),
+          input_bid_(0.0), input_ask_(0.0), input_position_(0), window_ready_(false), window_pv_(0.0),
+          window_volume_(0), vwap_(0.0), mid_(0.0), deviation_bps_(0.0)
+    {
+        memset(&input_params_, 0, sizeof(input_params_));
+        memset(&thresholds_, 0, sizeof(thresholds_));
+        memset(&decision_, 0, sizeof(decision_));
+        memset(evaluations_, 0, sizeof(evaluations_));
+    }
+
+    // Inputs. Each marks its node and everything downstream dirty, unless nothing changed.
+
+    // The shared window after a trade: readiness and running sums
+    void SetWindow(bool ready, double cumulative_pv, int64_t cumulative_volume)
+    {
+        input_ready_ = ready;
+        input_pv_ = cumulative_pv;
+        input_volume_ = cumulative_volume;
+        Invalidate<VWAP_NODE_WINDOW>();
+    }
+
+    // A valid top of book
+    void SetQuote(double bid, double ask)
+    {
+        if (bid == input_bid_ && ask == input_ask_)
+            return;
+        input_bid_ = bid;
+        input_ask_ = ask;
+        Invalidate<VWAP_NODE_MID>();
+    }
+
+    void SetParams(const VWAPSymbolParams& params)
+    {
+        input_params_ = params;
+        Invalidate<VWAP_NODE_THRESHOLDS>();
+    }
+
+    void SetPosition(int position)
+    {
+        if (position == input_position_)
+            return;
+        input_position_ = position;
+        Invalidate<VWAP_NODE_DECISION>();
+    }
+
+    // Nodes, evaluated on demand
+
+    bool window_ready() const { Update<VWAP_NODE_WINDOW>(); return window_ready_; }
+    double vwap() const { Update<VWAP_NODE_VWAP>(); return vwap_; }
+    double mid() const { Update<VWAP_NODE_MID>(); return mid_; }
+    double deviation_bps() const { Update<VWAP_NODE_DEVIATION>(); return deviation_bps_; }
+    const VWAPSymbolParams& thresholds() const { Update<VWAP_NODE_THRESHOLDS>(); return thresholds_; }
+    const VWAPDecision& decision() const { Update<VWAP_NODE_DECISION>(); return decision_; }
+
+    uint64_t evaluations(int node) const { return evaluations_[node]; }
+
+private:
+    template <int Node> struct Tag {};
+
+    template <int Node>
+    void Invalidate()
+    {
+        dirty_ |= VWAP_NODE_BIT(Node) | VWAPNodeDependents<Node, VWAP_NODE_COUNT>::mask;
+    }
+
+    template <int Node>
+    void Update() const
+    {
+        if (dirty_ & VWAP_NODE_BIT(Node)) {
+            Evaluate(Tag<Node>());
+            dirty_ &= ~VWAP_NODE_BIT(Node);
+            ++evaluations_[Node];
+        }
+    }
+
+    void Evaluate(Tag<VWAP_NODE_WINDOW>) const
+    {
+        window_ready_ = input_ready_;
+        window_pv_ = input_pv_;
+        window_volume_ = input_volume_;
+    }
+
+    // Same as VWAPWindow::vwap()
+    void Evaluate(Tag<VWAP_NODE_VWAP>) const
+    {
+        Update<VWAP_NODE_WINDOW>();
+        vwap_ = (window_volume_ == 0) ? 0.0 : window_pv_ / window_volume_;
+    }
+
+    void Evaluate(Tag<VWAP_NODE_MID>) const { mid_ = (input_bid_ + input_ask_) / 2.0; }
+
+    void Evaluate(Tag<VWAP_NODE_DEVIATION>) const { deviation_bps_ = VWAPDeviationBps(mid(), vwap()); }
+
+    void Evaluate(Tag<VWAP_NODE_THRESHOLDS>) const { thresholds_ = input_params_; }
+
+    // At or past max inventory every outcome of DecideVWAPPosition is flat, so the deviation is
+    // not pulled for it; it is still used to label an exit when a consumer already needed it
+    void Evaluate(Tag<VWAP_NODE_DECISION>) const
+    {
+        const VWAPSymbolParams& params = thresholds();
+        if (abs(input_position_) >= params.max_inventory && (dirty_ & VWAP_NODE_BIT(VWAP_NODE_DEVIATION))) {
+            decision_.desired_position = 0;
+            decision_.signal = VWAP_SIGNAL_NONE;
+            return;
+        }
+        decision_ = DecideVWAPPosition(input_position_, deviation_bps(), params.entry_threshold_bps,
+                                       params.max_inventory, params.position_size);
+    }
+
+    mutable unsigned dirty_;
+
+    bool input_ready_;
+    double input_pv_;
+    int64_t input_volume_;
+    double input_bid_;
+    double input_ask_;
+    VWAPSymbolParams input_params_;
+    int input_position_;
+
+    mutable bool window_ready_;
+    mutable double window_pv_;
+    mutable int64_t window_volume_;
+    mutable double vwap_;
+    mutable double mid_;
+    mutable double deviation_bps_;
+    mutable VWAPSymbolParams thresholds_;
+    mutable VWAPDecision decision_;
+    mutable uint64_t evaluations_[VWAP_NODE_COUNT];
+};
+
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+
+#ifndef _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SYMBOL_PARAMS_H_
+#define _STRATEGY_STUDIO_LIB_EXAMPLES_VWAP_SYMBOL_PARAMS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Entry parameters one instrument trades with
+struct VWAPSymbolParams {
+    double entry_threshold_bps;
+    int max_inventory;
+    int position_size;
+};
+
+// Per-symbol overrides of the entry parameters.
+//
+// Every field is optional: a symbol that only overrides its threshold keeps following the
+// global max_inventory and position_size, including runtime changes to them. Tables can be
+// layered with Apply, so a startup file can be adjusted symbol by symbol while running.
+class VWAPSymbolParamTable {
+public:
+    void Clear() { overrides_.clear(); }
+
+    // "AAPL:2.5:10:2,MSFT:1.0::" (symbol:threshold_bps:max_inventory:position_size), empty fields
+    // follow the global param. Whitespace around entries and fields is ignored, so
+    // "AAPL:2.5:10:2, MSFT:1.0::" works too. Replaces the table; on failure the table is left unchanged.
+    bool Parse(const std::string& spec, std::string* error)
+    {
+        std::map<std::string, Override> parsed;
+        size_t start = 0;
+        while (start < spec.size()) {
+            size_t comma = spec.find(',', start);
+            if (comma == std::string::npos)
+                comma = spec.size();
+            std::string entry = Trim(spec.substr(start, comma - start));
+            if (!entry.empty() && !ParseEntry(entry, ':', &parsed, error))
+                return false;
+            start = comma + 1;
+        }
+        overrides_.swap(parsed);
+        return true;
+    }
+
+    // CSV with the columns symbol,entry_threshold_bps,max_inventory,position_size. A header row
+    // and lines starting with '#' are skipped. Replaces the table; on failure it is left unchanged.
+    bool LoadFile(const std::string& path, std::string* error)
+    {
+        FILE* in = fopen(path.c_str(), "r");
+        if (!in) {
+            *error = "could not open " + path;
+            return false;
+        }
+        std::map<std::string, Override> parsed;
+        char buffer[512];
+        bool ok = true;
+        while (ok && fgets(buffer, sizeof(buffer), in)) {
+            std::string line(buffer);
+            line.erase(line.find_last_not_of(" \t\r\n") + 1);
+            if (line.empty() || line[0] == '#' || line.compare(0, 7, "symbol,") == 0)
+                continue;
+            ok = ParseEntry(line, ',', &parsed, error);
+        }
+        fclose(in);
+        if (!ok) {
+            *error = path + ": " + *error;
+            return false;
+        }
+        overrides_.swap(parsed);
+        return true;
+    }
+
+    // Layers other's fields over this table's
+    void Apply(const VWAPSymbolParamTable& other)
+    {
+        for (std::map<std::string, Override>::const_iterator it = other.overrides_.begin(); it != other.overrides_.end(); ++it) {
+            Override& target = overrides_[it->first];
+            const Override& source = it->second;
+            if (source.has_threshold) {
+                target.params.entry_threshold_bps = source.params.entry_threshold_bps;
+                target.has_threshold = true;
+            }
+            if (source.has_inventory) {
+                target.params.max_inventory = source.params.max_inventory;
+                target.has_inventory = true;
+            }
+            if (source.has_size) {
+                target.params.position_size = source.params.position_size;
+                target.has_size = true;
+            }
+        }
+    }
+
+    VWAPSymbolParams Resolve(const std::string& symbol, const VWAPSymbolParams& defaults) const
+    {
+        std::map<std::string, Override>::const_iterator it = overrides_.find(symbol);
+        if (it == overrides_.end())
+            return defaults;
+        const Override& o = it->second;
+        VWAPSymbolParams params = {
+            o.has_threshold ? o.params.entry_threshold_bps : defaults.entry_threshold_bps,
+            o.has_inventory ? o.params.max_inventory : defaults.max_inventory,
+            o.has_size ? o.params.position_size : defaults.position_size };
+        return params;
+    }
+
+    // Canonical spec in the Parse format, symbols sorted
+    std::string ToString() const
+    {
+        std::string spec;
+        char field[64];
+        for (std::map<std::string, Override>::const_iterator it = overrides_.begin(); it != overrides_.end(); ++it) {
+            const Override& o = it->second;
+            spec += (spec.empty() ? "" : ",") + it->first + ":";
+            if (o.has_threshold) {
+                snprintf(field, sizeof(field), "%.17g", o.params.entry_threshold_bps);
+                spec += field;
+            }
+            spec += ":";
+            if (o.has_inventory)
+                spec += std::to_string(o.params.max_inventory);
+            spec += ":";
+            if (o.has_size)
+                spec += std::to_string(o.params.position_size);
+        }
+        return spec;
+    }
+
+    size_t size() const { return overrides_.size(); }
+
+private:
+    struct Override {
+        VWAPSymbolParams params;
+        bool has_threshold;
+        bool has_inventory;
+        bool has_size;
+
+        Override() : has_threshold(false), has_inventory(false), has_size(false)
+        {
+            params.entry_threshold_bps = 0.0;
+            params.max_inventory = 0;
+            params.position_size = 0;
+        }
+    };
+
+    static std::string Trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+            return std::string();
+        return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    }
+
+    static bool ParseEntry(const std::string& entry, char separator, std::map<std::string, Override>* parsed,
+                           std::string* error)
+    {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (;;) {
+            size_t end = entry.find(separator, start);
+            fields.push_back(Trim(entry.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+            if (end == std::string::npos)
+                break;
+            start = end + 1;
+        }
+        if (fields.size() != 4 || fields[0].empty()) {
+            *error = "expected symbol" + std::string(1, separator) + "threshold_bps" + separator + "max_inventory" +
+                     separator + "position_size, got \"" + entry + "\"";
+            return false;
+        }
+        Override o;
+        char* end;
+        if (!fields[1].empty()) {
+            o.params.entry_threshold_bps = strtod(fields[1].c_str(), &end);
+            o.has_threshold = *end == '\0';
+        }
+        if (!fields[2].empty()) {
+            o.params.max_inventory = int(strtol(fields[2].c_str(), &end, 10));
+            o.has_inventory = *end == '\0';
+        }
+        if (!fields[3].empty()) {
+            o.params.position_size = int(strtol(fields[3].c_str(), &end, 10));
+            o.has_size = *end == '\0';
+        }
+        if (o.has_threshold != !fields[1].empty() || o.has_inventory != !fields[2].empty() ||
+            o.has_size != !fields[3].empty()) {
+            *error = "bad number in \"" + entry + "\"";
+            return false;
+        }
+        (*parsed)[fields[0]] = o;
+        return true;
+    }
+
+    std::map<std::string, Override> overrides_;
+};
+
+#endif
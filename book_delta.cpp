@@ -0,0 +1,273 @@
+// book_delta: encode book_updates depth captures as per-level changes and check them.
+//
+//   book_delta encode <book_updates.csv> <out.bin>
+//   book_delta verify <book_updates.csv> <deltas.bin>
+//
+// The captures hold one COLLECTION_TIME, SYMBOL, BID_PRICE_1..N, BID_SIZE_1..N, ASK_PRICE_1..N,
+// ASK_SIZE_1..N row per update, N taken from the header. encode diffs each row against the
+// previous one of its symbol (DepthDelta.h) and writes the changes as DepthDeltaRecords to a tick
+// store file, which tick_store.open_store loads as well. verify applies the records to a DepthBook
+// row by row and checks that its top N matches every snapshot, then times the book on the
+// changes alone. Compressed captures can be piped in: zcat x.csv.gz | book_delta encode /dev/stdin x.bin
+//
+// COLLECTION_TIME is "2020-02-12 13:32:17.983467008" (UTC) or integer nanoseconds. Levels with
+// no price or size are empty. Rows whose levels are out of book order (or repeat a price) cannot
+// be reproduced by a price-keyed book; they are encoded all the same and counted as irregular.
+
+#include "BacktestCsv.h"
+#include "DepthDelta.h"
+#include "FeatureExport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool ParseCollectionTime(const char* text, int64_t* timestamp_ns)
+{
+    char* end;
+    long long integer = strtoll(text, &end, 10);
+    if (*text && *end == '\0') {
+        *timestamp_ns = integer;
+        return true;
+    }
+    int year, month, day, hours, minutes, seconds, consumed = 0;
+    if (sscanf(text, "%d-%d-%d%*1[ T]%d:%d:%d%n", &year, &month, &day, &hours, &minutes, &seconds, &consumed) != 6)
+        return false;
+    struct tm parts;
+    memset(&parts, 0, sizeof(parts));
+    parts.tm_year = year - 1900;
+    parts.tm_mon = month - 1;
+    parts.tm_mday = day;
+    parts.tm_hour = hours;
+    parts.tm_min = minutes;
+    parts.tm_sec = seconds;
+    int64_t fraction_ns = 0;
+    const char* p = text + consumed;
+    if (*p == '.') {
+        int64_t scale = 100000000;
+        for (++p; *p >= '0' && *p <= '9'; ++p, scale /= 10)
+            fraction_ns += (*p - '0') * scale;
+    }
+    *timestamp_ns = int64_t(timegm(&parts)) * 1000000000LL + fraction_ns;
+    return true;
+}
+
+// A book_updates capture read row by row into snapshot sides
+class BookUpdatesReader {
+public:
+    bool Open(const std::string& path, std::string* error)
+    {
+        if (!csv_.Open(std::vector<std::string>(1, path))) {
+            *error = csv_.error().empty() ? path + " is empty" : csv_.error();
+            return false;
+        }
+        time_ = csv_.Column("COLLECTION_TIME");
+        symbol_ = csv_.Column("SYMBOL");
+        for (int side = 0; side < 2; ++side) {
+            const char* name = (side == TICK_DEPTH_BID) ? "BID" : "ASK";
+            for (int level = 1; level <= 255; ++level) {
+                char price[32], size[32];
+                snprintf(price, sizeof(price), "%s_PRICE_%d", name, level);
+                snprintf(size, sizeof(size), "%s_SIZE_%d", name, level);
+                if (csv_.Column(price) < 0 || csv_.Column(size) < 0)
+                    break;
+                price_[side].push_back(csv_.Column(price));
+                size_[side].push_back(csv_.Column(size));
+            }
+        }
+        if (time_ < 0 || symbol_ < 0 || price_[0].empty() || price_[0].size() != price_[1].size()) {
+            *error = path + " lacks COLLECTION_TIME, SYMBOL or matching BID/ASK_PRICE_n and _SIZE_n columns";
+            return false;
+        }
+        return true;
+    }
+
+    // Next row; false at the end or on a bad timestamp (then error() says which row)
+    bool Next(int64_t* timestamp_ns, std::string* symbol, DepthSide sides[2])
+    {
+        if (!csv_.Next())
+            return false;
+        if (!ParseCollectionTime(csv_.Get(time_), timestamp_ns)) {
+            error_ = "bad COLLECTION_TIME at row " + std::to_string(csv_.rows());
+            return false;
+        }
+        symbol->assign(csv_.Get(symbol_));
+        for (int side = 0; side < 2; ++side) {
+            sides[side].clear();
+            for (size_t i = 0; i < price_[side].size(); ++i) {
+                DepthLevel level = { csv_.GetDouble(price_[side][i]), atoi(csv_.Get(size_[side][i])) };
+                if (level.price > 0.0 && level.size > 0)
+                    sides[side].push_back(level);
+            }
+        }
+        return true;
+    }
+
+    size_t levels() const { return price_[0].size(); }
+    uint64_t rows() const { return csv_.rows(); }
+    const std::string& error() const { return error_.empty() ? csv_.error() : error_; }
+
+private:
+    BacktestCsvReader csv_;
+    int time_;
+    int symbol_;
+    std::vector<int> price_[2];
+    std::vector<int> size_[2];
+    std::string error_;
+};
+
+static int Encode(const char* in_path, const char* out_path)
+{
+    BookUpdatesReader reader;
+    std::string error;
+    if (!reader.Open(in_path, &error)) {
+        fprintf(stderr, "book_delta: %s\n", error.c_str());
+        return 1;
+    }
+    TickStoreWriter writer;
+    if (!writer.Open(out_path, TICK_RECORD_TYPE_DEPTH, sizeof(DepthDeltaRecord))) {
+        fprintf(stderr, "book_delta: could not open %s\n", out_path);
+        return 1;
+    }
+
+    DepthDeltaEncoder encoder;
+    std::vector<DepthDeltaRecord> changes;
+    uint64_t unchanged = 0, irregular = 0, actions[4] = { 0 };
+    int64_t timestamp_ns;
+    std::string symbol;
+    DepthSide sides[2];
+    while (reader.Next(&timestamp_ns, &symbol, sides)) {
+        changes.clear();
+        if (encoder.Encode(timestamp_ns, symbol, sides, &changes) == 0)
+            ++unchanged;
+        if (!IsBookOrdered(sides[TICK_DEPTH_BID], TICK_DEPTH_BID) || !IsBookOrdered(sides[TICK_DEPTH_ASK], TICK_DEPTH_ASK))
+            ++irregular;
+        for (size_t i = 0; i < changes.size(); ++i) {
+            writer.Append(changes[i]);
+            ++actions[changes[i].action & 3];
+        }
+    }
+    writer.Close();
+    if (!reader.error().empty()) {
+        fprintf(stderr, "book_delta: %s\n", reader.error().c_str());
+        return 1;
+    }
+    if (writer.write_errors()) {
+        fprintf(stderr, "book_delta: write errors on %s\n", out_path);
+        return 1;
+    }
+
+    uint64_t rows = reader.rows();
+    uint64_t records = writer.records_written();
+    printf("%llu snapshots of %zu levels (%llu unchanged, %llu irregular) -> %llu changes: add=%llu modify=%llu delete=%llu\n",
+           (unsigned long long)rows, reader.levels(), (unsigned long long)unchanged, (unsigned long long)irregular,
+           (unsigned long long)records, (unsigned long long)actions[TICK_DEPTH_ADD],
+           (unsigned long long)actions[TICK_DEPTH_MODIFY], (unsigned long long)actions[TICK_DEPTH_DELETE]);
+
+    // Against the capture itself and against the same snapshots as fixed-size binary rows
+    double out_bytes = double(sizeof(TickStoreHeader) + records * sizeof(DepthDeltaRecord));
+    double flat_bytes = double(rows) * (8 + 8 + 2 * reader.levels() * (sizeof(double) + sizeof(int32_t)));
+    struct stat st;
+    printf("%.2f changes per snapshot, %.1f MB, %.1fx smaller than binary snapshots", rows ? double(records) / rows : 0.0,
+           out_bytes / 1e6, flat_bytes / out_bytes);
+    if (stat(in_path, &st) == 0 && S_ISREG(st.st_mode))
+        printf(" and %.1fx smaller than the %.1f MB csv", st.st_size / out_bytes, st.st_size / 1e6);
+    printf("\n");
+    return 0;
+}
+
+static bool BookMatches(const DepthBook& book, const std::string& symbol, const DepthSide sides[2], size_t levels)
+{
+    DepthSide top;
+    for (int side = 0; side < 2; ++side) {
+        book.Top(symbol, side, levels, &top);
+        if (top != sides[side])
+            return false;
+    }
+    return true;
+}
+
+static int Verify(const char* csv_path, const char* deltas_path)
+{
+    BookUpdatesReader reader;
+    std::string error;
+    if (!reader.Open(csv_path, &error)) {
+        fprintf(stderr, "book_delta: %s\n", error.c_str());
+        return 1;
+    }
+    TickStoreFile file;
+    if (!file.Open(deltas_path) || file.header().record_type != TICK_RECORD_TYPE_DEPTH ||
+        file.header().record_size != sizeof(DepthDeltaRecord)) {
+        fprintf(stderr, "book_delta: %s is not a depth delta file\n", deltas_path);
+        return 1;
+    }
+    const DepthDeltaRecord* records = file.records<DepthDeltaRecord>();
+    size_t count = file.record_count();
+
+    // A row that differs from the book takes the next batch of changes, if they are its own
+    DepthBook book;
+    size_t next = 0;
+    uint64_t mismatches = 0, irregular = 0;
+    int64_t timestamp_ns;
+    std::string symbol;
+    DepthSide sides[2];
+    while (reader.Next(&timestamp_ns, &symbol, sides)) {
+        if (BookMatches(book, symbol, sides, reader.levels()))
+            continue;
+        if (next < count && records[next].timestamp_ns == timestamp_ns &&
+            strncmp(records[next].symbol, symbol.c_str(), sizeof(records[next].symbol)) == 0) {
+            do
+                book.Apply(records[next]);
+            while (!(records[next++].flags & TICK_DEPTH_FLAG_LAST) && next < count);
+        }
+        if (BookMatches(book, symbol, sides, reader.levels()))
+            continue;
+        if (!IsBookOrdered(sides[TICK_DEPTH_BID], TICK_DEPTH_BID) || !IsBookOrdered(sides[TICK_DEPTH_ASK], TICK_DEPTH_ASK)) {
+            ++irregular;
+        } else if (++mismatches <= 5) {
+            fprintf(stderr, "book_delta: %s differs from the book at row %llu\n", symbol.c_str(),
+                    (unsigned long long)reader.rows());
+        }
+    }
+    if (!reader.error().empty()) {
+        fprintf(stderr, "book_delta: %s\n", reader.error().c_str());
+        return 1;
+    }
+    printf("%llu snapshots, %zu of %zu changes applied: %llu mismatches, %llu irregular\n",
+           (unsigned long long)reader.rows(), next, count, (unsigned long long)mismatches, (unsigned long long)irregular);
+
+    // What a depth mirror pays when it is only handed the changes
+    double started = Seconds();
+    DepthBook mirror;
+    for (size_t i = 0; i < count; ++i)
+        mirror.Apply(records[i]);
+    double elapsed = Seconds() - started;
+    printf("book mirror: %zu changes in %.3fs (%.1f M changes/s)\n", count, elapsed,
+           elapsed > 0.0 ? count / elapsed / 1e6 : 0.0);
+    return (mismatches == 0 && next == count) ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc == 4 && strcmp(argv[1], "encode") == 0)
+        return Encode(argv[2], argv[3]);
+    if (argc == 4 && strcmp(argv[1], "verify") == 0)
+        return Verify(argv[2], argv[3]);
+
+    fprintf(stderr,
+            "usage: book_delta encode <book_updates.csv> <out.bin>\n"
+            "       book_delta verify <book_updates.csv> <deltas.bin>\n");
+    return 2;
+}
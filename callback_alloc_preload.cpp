@@ -0,0 +1,10 @@
+// callback_alloc_preload.so: allocation counter for profiling strategies inside the server.
+//
+//   LD_PRELOAD=/path/to/callback_alloc_preload.so ./StrategyServer ...
+//
+// Replaces the global operator new for the whole process, so allocations made by libstdc++ on a
+// strategy's behalf are counted too. Strategies built with make PROFILE=1 pick the counts up
+// through CallbackProfiler.h; without the preload they report allocations as unavailable.
+
+#define CALLBACK_PROFILER_DEFINE_ALLOCATOR
+#include "CallbackProfiler.h"
@@ -0,0 +1,162 @@
+"""
+Check markouts against pandas merge_asof on a capture with late events
+
+Builds a small synthetic day whose quotes and feature records are partly out of time order (as
+a capture with late events is), packs it with tickpack, runs markouts on random fills and
+compares every curve point and signal bucket with a share weighted merge_asof(direction=
+'backward') over the same data. Exits non-zero on the first mismatch.
+
+Usage:
+    make tickpack markouts && python check_markouts.py [--bin-dir .] [--seed 7]
+"""
+
+import argparse
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+from tick_store import (FEATURE_DTYPE, HEADER_DTYPE, MARKET_DTYPE, TICK_EVENT_TYPE_QUOTE, TICK_STORE_MAGIC,
+                        TICK_STORE_VERSION, TICK_RECORD_TYPE_FEATURE, TICK_RECORD_TYPE_MARKET)
+
+DAY_START_NS = 1568381400 * 1000000000  # 2019-09-13 13:30:00 UTC
+HORIZONS_MS = [0, 10, 100, 1000, 5000]
+SIGNAL_EDGES = [1.0, 2.0]
+
+
+def write_store(path, record_type, records):
+    header = np.zeros(1, dtype=HEADER_DTYPE)
+    header['magic'] = TICK_STORE_MAGIC
+    header['version'] = TICK_STORE_VERSION
+    header['record_type'] = record_type
+    header['record_size'] = records.dtype.itemsize
+    with open(path, 'wb') as out:
+        out.write(header.tobytes())
+        out.write(records.tobytes())
+
+
+def delay_some(rng, timestamps, fraction=0.05, max_delay=400):
+    """File order for timestamps: most in time order, a fraction arriving up to max_delay records late"""
+    keys = np.arange(len(timestamps), dtype=float)
+    late = rng.random(len(timestamps)) < fraction
+    keys[late] += rng.integers(1, max_delay, late.sum()) + 0.5
+    return np.argsort(keys, kind='stable')
+
+
+def synthetic_day(rng, symbols, events=20000):
+    quotes = np.zeros(events, dtype=MARKET_DTYPE)
+    times = DAY_START_NS + np.sort(rng.integers(0, 1200 * 10**9, events))
+    times[1::50] = times[0::50][:len(times[1::50])]  # some timestamps repeat
+    names = rng.choice(symbols, events)
+    mids = 100.0 + np.cumsum(rng.normal(0.0, 0.01, events))
+    quotes['timestamp_ns'] = times
+    quotes['symbol'] = names
+    quotes['event_type'] = TICK_EVENT_TYPE_QUOTE
+    quotes['bid'] = np.round(mids - 0.01, 2)
+    quotes['ask'] = np.round(mids + 0.01, 2)
+    quotes['bid_size'] = quotes['ask_size'] = 100
+    return quotes[delay_some(rng, times)]
+
+
+def synthetic_features(rng, symbols, records=5000):
+    features = np.zeros(records, dtype=FEATURE_DTYPE)
+    times = DAY_START_NS + np.sort(rng.integers(0, 1200 * 10**9, records))
+    features['timestamp_ns'] = times
+    features['symbol'] = rng.choice(symbols, records)
+    features['vwap_ready'] = 1
+    features['deviation_bps'] = rng.normal(0.0, 2.0, records)
+    return features[delay_some(rng, times)]
+
+
+def synthetic_fills(rng, symbols, fills=2000):
+    times = DAY_START_NS + rng.integers(10**9, 1200 * 10**9, fills)
+    quantity = rng.integers(1, 10, fills) * rng.choice([-1, 1], fills)
+    stamps = pd.to_datetime(times, unit='ns')
+    return pd.DataFrame({
+        'timestamp_ns': times,
+        'TradeTime': [t.strftime('%Y-%b-%d %H:%M:%S.%f') for t in stamps],
+        'Symbol': rng.choice(symbols, fills),
+        'Quantity': quantity,
+        'Price': np.round(100.0 + rng.normal(0.0, 0.5, fills), 2),
+        'OrderID': np.arange(1, fills + 1),
+    })
+
+
+def expected_curves(quotes, features, fills):
+    """Share weighted markouts per symbol, bucket and horizon from merge_asof on time sorted data"""
+    quotes = pd.DataFrame({'t': quotes['timestamp_ns'], 'Symbol': quotes['symbol'].astype(str),
+                           'mid': (quotes['bid'] + quotes['ask']) / 2.0}).sort_values('t', kind='stable')
+    features = pd.DataFrame({'t': features['timestamp_ns'], 'Symbol': features['symbol'].astype(str),
+                             'deviation': features['deviation_bps']}).sort_values('t', kind='stable')
+    fills = fills.assign(t=fills['timestamp_ns']).sort_values('t', kind='stable')
+    fills = pd.merge_asof(fills, features, on='t', by='Symbol', direction='backward')
+    fills['bucket'] = np.searchsorted(SIGNAL_EDGES, fills['deviation'].abs().fillna(0.0), side='right')
+    last_quote = quotes.groupby('Symbol')['t'].max()
+
+    rows = []
+    for horizon in HORIZONS_MS:
+        at = fills.assign(t=fills['timestamp_ns'] + horizon * 10**6).sort_values('t', kind='stable')
+        at = pd.merge_asof(at, quotes, on='t', by='Symbol', direction='backward')
+        at = at[at['mid'].notna() & (at['t'] <= at['Symbol'].map(last_quote))]
+        sign = np.sign(at['Quantity'])
+        at = at.assign(shares=at['Quantity'].abs(), bps=sign * (at['mid'] - at['Price']) / at['Price'] * 1e4)
+        for (symbol, bucket), group in at.groupby(['Symbol', 'bucket']):
+            rows.append((symbol, int(bucket), horizon, np.average(group['bps'], weights=group['shares'])))
+    return rows
+
+
+def bucket_label(bucket):
+    if bucket == 0:
+        return f"<{SIGNAL_EDGES[0]:g}"
+    if bucket == len(SIGNAL_EDGES):
+        return f">={SIGNAL_EDGES[-1]:g}"
+    return f"{SIGNAL_EDGES[bucket - 1]:g}-{SIGNAL_EDGES[bucket]:g}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--bin-dir', default='.', help='directory holding tickpack and markouts')
+    parser.add_argument('--seed', type=int, default=7)
+    args = parser.parse_args()
+    bin_dir = Path(args.bin_dir).resolve()
+    rng = np.random.default_rng(args.seed)
+    symbols = ['AAPL', 'MSFT', 'SPY']
+
+    quotes = synthetic_day(rng, symbols)
+    features = synthetic_features(rng, symbols)
+    fills = synthetic_fills(rng, symbols)
+    assert (np.diff(quotes['timestamp_ns'].astype(np.int64)) < 0).any(), "capture should have late events"
+
+    with tempfile.TemporaryDirectory() as work:
+        work = Path(work)
+        (work / 'archive').mkdir()
+        write_store(work / 'day.bin', TICK_RECORD_TYPE_MARKET, quotes)
+        write_store(work / 'features.bin', TICK_RECORD_TYPE_FEATURE, features)
+        subprocess.run([str(bin_dir / 'tickpack'), 'pack', str(work / 'day.bin'), str(work / 'archive' / '20190913.tpk')],
+                       check=True, stdout=subprocess.DEVNULL)
+        columns = ['TradeTime', 'Symbol', 'Quantity', 'Price', 'OrderID']
+        fills[columns].to_csv(work / 'check_fill.csv', index=False)
+        subprocess.run([str(bin_dir / 'markouts'), str(work / 'check'), '--archive', str(work / 'archive'),
+                        '--features', str(work / 'features.bin'),
+                        '--signal-edges', ','.join(f"{e:g}" for e in SIGNAL_EDGES),
+                        '--horizons-ms', ','.join(str(h) for h in HORIZONS_MS),
+                        '--csv', str(work / 'markouts.csv')], check=True, stdout=subprocess.DEVNULL)
+        actual = pd.read_csv(work / 'markouts.csv')
+
+    actual = actual.set_index(['symbol', 'signal_bucket', 'horizon_ms'])['markout_bps']
+    failures = 0
+    expected = expected_curves(quotes, features, fills)
+    for symbol, bucket, horizon, bps in expected:
+        got = actual.get((symbol, bucket_label(bucket), horizon))
+        if got is None or abs(got - bps) > 1e-5:
+            print(f"{symbol} {bucket_label(bucket)} {horizon}ms: markouts {got}, merge_asof {bps:.6f}")
+            failures += 1
+    print(f"{len(expected)} curve points checked, {failures} mismatches")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
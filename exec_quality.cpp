@@ -0,0 +1,542 @@
+// exec_quality: implementation shortfall, effective and realized spread and fee drag per symbol and
+// time-of-day bucket.
+//
+//   exec_quality <result prefix> [more prefixes ...] [--archive dir] [--horizon-ms 5000]
+//                [--bucket-minutes 30] [--max-order-age-s 86400] [--csv out.csv]
+//
+// A result prefix names one run's <prefix>_order.csv and <prefix>_fill.csv, from a backtest
+// (BACK_..._start_09-13-2019_end_09-13-2019) or vwap_replay --out; passing either file works too.
+// Several prefixes, in date order, are read as one stream.
+//
+// Fills are hash joined to their order on OrderID. Both files are in time order, so the order
+// stream is only read up to the time of the fill being joined, and an order leaves the table once
+// its FilledQty has been matched (or after --max-order-age-s without its fills). Memory is bounded
+// by the orders working at one time, not by the length of the run.
+//
+// Per fill, with sign s = +1 for buys and -1 for sells:
+//   slippage        s * (fill price - decision price) * shares
+//   fee             ExecutionCost
+//   shortfall       slippage + fee
+//   effective       2 * s * (fill price - mid at the fill) * shares
+//   realized        2 * s * (fill price - mid horizon after the fill) * shares
+// Each is reported in bps of the traded notional, price impact being effective - realized. The
+// decision price is the order's indicative Price. With --archive it is the mid prevailing at the
+// order's EntryTime instead, and the spreads use mids as-of the fill and fill + horizon from the
+// same tick archive; without an archive the spread columns are left empty. Mids are merged in
+// alongside the fills from an hour of time sorted archive quotes, so that window and markouts
+// waiting for their horizon are the only other state.
+
+#include "BacktestCsv.h"
+#include "TickArchive.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Sums for one symbol and bucket; the bps figures are ratios of these
+struct ExecStats {
+    uint64_t fills;
+    double shares;
+    double notional;            // decision price * shares
+    double slippage;
+    double fees;
+    double mid_notional;        // mid at the fill * shares, fills with a known mid
+    double effective;
+    double markout_notional;    // as mid_notional, fills whose horizon mid is known
+    double realized;
+
+    ExecStats() { memset(this, 0, sizeof(*this)); }
+
+    void Add(const ExecStats& other)
+    {
+        fills += other.fills;
+        shares += other.shares;
+        notional += other.notional;
+        slippage += other.slippage;
+        fees += other.fees;
+        mid_notional += other.mid_notional;
+        effective += other.effective;
+        markout_notional += other.markout_notional;
+        realized += other.realized;
+    }
+};
+
+static double Bps(double amount, double notional)
+{
+    return notional > 0.0 ? amount / notional * 1e4 : NAN;
+}
+
+// Symbols fit MarketEventRecord's 8 bytes, so they key the mid table as one integer
+static uint64_t SymbolKey(const char* symbol, size_t length)
+{
+    char padded[8] = { 0 };
+    memcpy(padded, symbol, std::min(length, sizeof(padded)));
+    uint64_t key;
+    memcpy(&key, padded, sizeof(key));
+    return key;
+}
+
+// Last mid per symbol as of a moving time. Quotes are pulled from the archive an hour at a time
+// and sorted, since captures can hold late events; markouts are queued with their horizon and
+// priced once every quote up to it has been applied.
+class AsOfMids {
+public:
+    struct Markout {
+        int64_t due_ns;
+        uint64_t symbol;
+        ExecStats* stats;
+        int sign;
+        double shares;
+        double price;
+        double mid_at_fill;
+    };
+
+    explicit AsOfMids(const TickArchive& archive)
+        : cursor_(archive), started_(false), exhausted_(false), window_end_ns_(0), next_(0)
+    {
+    }
+
+    // Applies all quotes at or before timestamp_ns. Times before the previous call are served
+    // from the current mids.
+    void AdvanceTo(int64_t timestamp_ns)
+    {
+        if (!started_) {
+            // Start a little early so the first lookups already see a quote
+            started_ = true;
+            window_end_ns_ = timestamp_ns - kLookbackNs;
+        }
+        for (;;) {
+            while (next_ < window_.size() && window_[next_].timestamp_ns <= timestamp_ns) {
+                const QuoteMid& quote = window_[next_++];
+                Settle(quote.timestamp_ns - 1);
+                mids_[quote.symbol] = quote.mid;
+            }
+            if (next_ < window_.size() || window_end_ns_ > timestamp_ns || exhausted_)
+                break;
+            LoadWindow();
+        }
+        Settle(timestamp_ns);
+    }
+
+    // 0 when the symbol has not been quoted yet
+    double Mid(uint64_t symbol) const
+    {
+        std::unordered_map<uint64_t, double>::const_iterator it = mids_.find(symbol);
+        return it == mids_.end() ? 0.0 : it->second;
+    }
+
+    void AddMarkout(const Markout& markout) { markouts_.push_back(markout); }
+
+private:
+    struct QuoteMid {
+        int64_t timestamp_ns;
+        uint64_t symbol;
+        double mid;
+
+        bool operator<(const QuoteMid& other) const { return timestamp_ns < other.timestamp_ns; }
+    };
+
+    static const int64_t kLookbackNs = 300LL * 1000000000LL;
+    static const int64_t kWindowNs = 3600LL * 1000000000LL;
+
+    // Quotes of the next window in time order; the cursor's range check picks up late events
+    // wherever the archive holds them. Quotes are also carried by trade events.
+    void LoadWindow()
+    {
+        int64_t start_ns = window_end_ns_;
+        window_end_ns_ = start_ns + kWindowNs;
+        window_.clear();
+        next_ = 0;
+        if (!cursor_.Seek(start_ns, window_end_ns_, std::vector<std::string>())) {
+            exhausted_ = true;
+            return;
+        }
+        while (const MarketEventRecord* event = cursor_.Next()) {
+            if (event->bid > 0.0 && event->ask > 0.0) {
+                QuoteMid quote = { event->timestamp_ns, SymbolKey(event->symbol, sizeof(event->symbol)),
+                                   (event->bid + event->ask) / 2.0 };
+                window_.push_back(quote);
+            }
+        }
+        std::stable_sort(window_.begin(), window_.end());
+    }
+
+    // Prices the markouts due at or before timestamp_ns; they were queued in fill time order
+    // with one horizon, so the due ones are at the front
+    void Settle(int64_t timestamp_ns)
+    {
+        while (!markouts_.empty() && markouts_.front().due_ns <= timestamp_ns) {
+            const Markout& markout = markouts_.front();
+            double mid = Mid(markout.symbol);
+            if (mid > 0.0) {
+                markout.stats->markout_notional += markout.mid_at_fill * markout.shares;
+                markout.stats->realized += 2.0 * markout.sign * (markout.price - mid) * markout.shares;
+            }
+            markouts_.pop_front();
+        }
+    }
+
+    TickArchiveCursor cursor_;
+    bool started_;
+    bool exhausted_;
+    int64_t window_end_ns_;
+    std::vector<QuoteMid> window_;
+    size_t next_;
+    std::unordered_map<uint64_t, double> mids_;
+    std::deque<Markout> markouts_;
+};
+
+struct WorkingOrder {
+    int64_t entry_ns;
+    double decision_price;
+    double unmatched_shares;
+};
+
+class ExecQuality {
+public:
+    ExecQuality(AsOfMids* mids, int64_t horizon_ns, int bucket_minutes, int64_t max_order_age_ns)
+        : mids_(mids), horizon_ns_(horizon_ns), bucket_minutes_(bucket_minutes), max_order_age_ns_(max_order_age_ns),
+          orders_(0), unfilled_orders_(0), expired_orders_(0), fills_(0), unmatched_fills_(0), bad_rows_(0),
+          max_working_(0), has_order_(false), order_ns_(0)
+    {
+    }
+
+    bool Open(const std::vector<std::string>& order_paths, const std::vector<std::string>& fill_paths, std::string* error)
+    {
+        if (!order_reader_.Open(order_paths)) {
+            *error = order_reader_.error().empty() ? "no orders in " + order_paths[0] : order_reader_.error();
+            return false;
+        }
+        if (!fill_reader_.Open(fill_paths)) {
+            *error = fill_reader_.error().empty() ? "no fills in " + fill_paths[0] : fill_reader_.error();
+            return false;
+        }
+        order_time_ = order_reader_.Column("EntryTime");
+        order_symbol_ = order_reader_.Column("Symbol");
+        order_price_ = order_reader_.Column("Price");
+        order_filled_ = order_reader_.Column("FilledQty");
+        order_id_ = order_reader_.Column("OrderId");
+        fill_time_ = fill_reader_.Column("TradeTime");
+        fill_symbol_ = fill_reader_.Column("Symbol");
+        fill_quantity_ = fill_reader_.Column("Quantity");
+        fill_price_ = fill_reader_.Column("Price");
+        fill_cost_ = fill_reader_.Column("ExecutionCost");
+        fill_order_id_ = fill_reader_.Column("OrderID");
+        if (order_time_ < 0 || order_symbol_ < 0 || order_price_ < 0 || order_filled_ < 0 || order_id_ < 0) {
+            *error = order_paths[0] + " is missing EntryTime, Symbol, Price, FilledQty or OrderId";
+            return false;
+        }
+        if (fill_time_ < 0 || fill_symbol_ < 0 || fill_quantity_ < 0 || fill_price_ < 0 || fill_cost_ < 0 ||
+            fill_order_id_ < 0) {
+            *error = fill_paths[0] + " is missing TradeTime, Symbol, Quantity, Price, ExecutionCost or OrderID";
+            return false;
+        }
+        ReadOrder();
+        return true;
+    }
+
+    // False if either stream stops on a read error, a missing file or a changed header
+    bool Run(std::string* error)
+    {
+        int64_t last_fill_ns = 0;
+        while (fill_reader_.Next()) {
+            int64_t fill_ns;
+            if (!ParseBacktestTime(fill_reader_.Get(fill_time_), &fill_ns)) {
+                ++bad_rows_;
+                continue;
+            }
+            last_fill_ns = std::max(last_fill_ns, fill_ns);
+
+            // Build side: every order entered up to this fill
+            while (has_order_ && order_ns_ <= fill_ns) {
+                AddOrder();
+                ReadOrder();
+            }
+            ExpireOrders(fill_ns);
+            Fill(fill_ns);
+        }
+        while (has_order_) {
+            AddOrder();
+            ReadOrder();
+        }
+        if (!order_reader_.error().empty() || !fill_reader_.error().empty()) {
+            *error = !order_reader_.error().empty() ? order_reader_.error() : fill_reader_.error();
+            return false;
+        }
+        expired_orders_ += working_.size();
+        if (mids_)
+            mids_->AdvanceTo(last_fill_ns + horizon_ns_);
+        return true;
+    }
+
+    // Table to stdout, one row per symbol plus the total; every symbol and bucket to csv if given
+    void Report(FILE* csv) const
+    {
+        std::map<std::string, ExecStats> per_symbol;
+        ExecStats total;
+        for (std::map<std::pair<std::string, int>, ExecStats>::const_iterator it = stats_.begin(); it != stats_.end(); ++it) {
+            per_symbol[it->first.first].Add(it->second);
+            total.Add(it->second);
+        }
+
+        printf("orders=%llu unfilled=%llu expired=%llu fills=%llu unmatched_fills=%llu bad_rows=%llu max_working=%zu\n",
+               (unsigned long long)orders_, (unsigned long long)unfilled_orders_, (unsigned long long)expired_orders_,
+               (unsigned long long)fills_, (unsigned long long)unmatched_fills_, (unsigned long long)bad_rows_,
+               max_working_);
+        printf("%-8s %8s %10s %14s %10s %8s %10s %13s %10s %9s %9s\n", "symbol", "fills", "shares", "notional",
+               "slip_bps", "fee_bps", "is_bps", "shortfall", "eff_bps", "real_bps", "imp_bps");
+        for (std::map<std::string, ExecStats>::const_iterator it = per_symbol.begin(); it != per_symbol.end(); ++it)
+            PrintRow(it->first.c_str(), it->second);
+        PrintRow("ALL", total);
+
+        if (!csv)
+            return;
+        fprintf(csv, "symbol,bucket,fills,shares,notional,slippage_bps,fee_bps,shortfall_bps,shortfall,"
+                     "effective_spread_bps,realized_spread_bps,price_impact_bps\n");
+        for (std::map<std::pair<std::string, int>, ExecStats>::const_iterator it = stats_.begin(); it != stats_.end(); ++it)
+            WriteCsvRow(csv, it->first.first, BucketLabel(it->first.second), it->second);
+        for (std::map<std::string, ExecStats>::const_iterator it = per_symbol.begin(); it != per_symbol.end(); ++it)
+            WriteCsvRow(csv, it->first, "ALL", it->second);
+        WriteCsvRow(csv, "ALL", "ALL", total);
+    }
+
+private:
+    void ReadOrder()
+    {
+        has_order_ = false;
+        while (order_reader_.Next()) {
+            if (ParseBacktestTime(order_reader_.Get(order_time_), &order_ns_)) {
+                has_order_ = true;
+                return;
+            }
+            ++bad_rows_;
+        }
+    }
+
+    void AddOrder()
+    {
+        ++orders_;
+        double filled = fabs(order_reader_.GetDouble(order_filled_));
+        if (filled == 0.0) {
+            ++unfilled_orders_;
+            return;
+        }
+        const char* symbol = order_reader_.Get(order_symbol_);
+        WorkingOrder order = { order_ns_, order_reader_.GetDouble(order_price_), filled };
+        if (mids_) {
+            mids_->AdvanceTo(order_ns_);
+            double arrival_mid = mids_->Mid(SymbolKey(symbol, strlen(symbol)));
+            if (arrival_mid > 0.0)
+                order.decision_price = arrival_mid;
+        }
+        uint64_t id = strtoull(order_reader_.Get(order_id_), NULL, 10);
+        working_[id] = order;
+        entry_order_.push_back(std::make_pair(order_ns_, id));
+        max_working_ = std::max(max_working_, working_.size());
+    }
+
+    // Orders whose fills never all arrived leave after max_order_age_ns
+    void ExpireOrders(int64_t now_ns)
+    {
+        while (!entry_order_.empty() && entry_order_.front().first < now_ns - max_order_age_ns_) {
+            std::unordered_map<uint64_t, WorkingOrder>::iterator it = working_.find(entry_order_.front().second);
+            if (it != working_.end() && it->second.entry_ns == entry_order_.front().first) {
+                working_.erase(it);
+                ++expired_orders_;
+            }
+            entry_order_.pop_front();
+        }
+        // Matched orders leave working_ as they complete; keep the queue from outgrowing it
+        if (entry_order_.size() > 2 * working_.size() + 1024) {
+            std::deque<std::pair<int64_t, uint64_t> > live;
+            for (size_t i = 0; i < entry_order_.size(); ++i) {
+                if (working_.count(entry_order_[i].second))
+                    live.push_back(entry_order_[i]);
+            }
+            entry_order_.swap(live);
+        }
+    }
+
+    // Probe side
+    void Fill(int64_t fill_ns)
+    {
+        uint64_t id = strtoull(fill_reader_.Get(fill_order_id_), NULL, 10);
+        std::unordered_map<uint64_t, WorkingOrder>::iterator it = working_.find(id);
+        if (it == working_.end()) {
+            ++unmatched_fills_;
+            return;
+        }
+        ++fills_;
+
+        double quantity = fill_reader_.GetDouble(fill_quantity_);
+        double shares = fabs(quantity);
+        int sign = quantity > 0.0 ? 1 : -1;
+        double price = fill_reader_.GetDouble(fill_price_);
+        const char* symbol = fill_reader_.Get(fill_symbol_);
+        ExecStats& stats = stats_[std::make_pair(std::string(symbol), Bucket(fill_ns))];
+        ++stats.fills;
+        stats.shares += shares;
+        stats.notional += it->second.decision_price * shares;
+        stats.slippage += sign * (price - it->second.decision_price) * shares;
+        stats.fees += fill_reader_.GetDouble(fill_cost_);
+
+        if (mids_) {
+            mids_->AdvanceTo(fill_ns);
+            uint64_t key = SymbolKey(symbol, strlen(symbol));
+            double mid = mids_->Mid(key);
+            if (mid > 0.0) {
+                stats.mid_notional += mid * shares;
+                stats.effective += 2.0 * sign * (price - mid) * shares;
+                AsOfMids::Markout markout = { fill_ns + horizon_ns_, key, &stats, sign, shares, price, mid };
+                mids_->AddMarkout(markout);
+            }
+        }
+
+        it->second.unmatched_shares -= shares;
+        if (it->second.unmatched_shares <= 0.0)
+            working_.erase(it);
+    }
+
+    // Minutes since UTC midnight, rounded down to the bucket
+    int Bucket(int64_t timestamp_ns) const
+    {
+        int minute = int((timestamp_ns / 60000000000LL) % 1440);
+        return minute - minute % bucket_minutes_;
+    }
+
+    static std::string BucketLabel(int minute)
+    {
+        char label[16];
+        snprintf(label, sizeof(label), "%02d:%02d", minute / 60, minute % 60);
+        return label;
+    }
+
+    static void PrintRow(const char* symbol, const ExecStats& s)
+    {
+        printf("%-8s %8llu %10.0f %14.2f %10.3f %8.3f %10.3f %13.2f %10.3f %9.3f %9.3f\n", symbol,
+               (unsigned long long)s.fills, s.shares, s.notional, Bps(s.slippage, s.notional), Bps(s.fees, s.notional),
+               Bps(s.slippage + s.fees, s.notional), s.slippage + s.fees, Bps(s.effective, s.mid_notional),
+               Bps(s.realized, s.markout_notional),
+               Bps(s.effective, s.mid_notional) - Bps(s.realized, s.markout_notional));
+    }
+
+    // Spread columns stay empty when no mid was known
+    static void WriteCsvRow(FILE* csv, const std::string& symbol, const std::string& bucket, const ExecStats& s)
+    {
+        fprintf(csv, "%s,%s,%llu,%.0f,%.6f,%.6f,%.6f,%.6f,%.6f,", symbol.c_str(), bucket.c_str(),
+                (unsigned long long)s.fills, s.shares, s.notional, Bps(s.slippage, s.notional), Bps(s.fees, s.notional),
+                Bps(s.slippage + s.fees, s.notional), s.slippage + s.fees);
+        double effective = Bps(s.effective, s.mid_notional);
+        double realized = Bps(s.realized, s.markout_notional);
+        if (isnan(effective))
+            fprintf(csv, ",,\n");
+        else if (isnan(realized))
+            fprintf(csv, "%.6f,,\n", effective);
+        else
+            fprintf(csv, "%.6f,%.6f,%.6f\n", effective, realized, effective - realized);
+    }
+
+    AsOfMids* mids_;
+    int64_t horizon_ns_;
+    int bucket_minutes_;
+    int64_t max_order_age_ns_;
+
+    BacktestCsvReader order_reader_;
+    BacktestCsvReader fill_reader_;
+    int order_time_, order_symbol_, order_price_, order_filled_, order_id_;
+    int fill_time_, fill_symbol_, fill_quantity_, fill_price_, fill_cost_, fill_order_id_;
+
+    std::unordered_map<uint64_t, WorkingOrder> working_;
+    std::deque<std::pair<int64_t, uint64_t> > entry_order_;     // (entry time, id) in arrival order
+    std::map<std::pair<std::string, int>, ExecStats> stats_;    // node based, markouts keep pointers
+
+    uint64_t orders_;
+    uint64_t unfilled_orders_;
+    uint64_t expired_orders_;
+    uint64_t fills_;
+    uint64_t unmatched_fills_;
+    uint64_t bad_rows_;
+    size_t max_working_;
+    bool has_order_;
+    int64_t order_ns_;
+};
+
+static int Usage()
+{
+    fprintf(stderr, "usage: exec_quality <result prefix> [more ...] [--archive dir] [--horizon-ms 5000]\n"
+                    "                    [--bucket-minutes 30] [--max-order-age-s 86400] [--csv out.csv]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> order_paths, fill_paths;
+    std::string archive_root, csv_path;
+    double horizon_ms = 5000.0;
+    int bucket_minutes = 30;
+    double max_order_age_s = 86400.0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--archive" && i + 1 < argc) {
+            archive_root = argv[++i];
+        } else if (arg == "--horizon-ms" && i + 1 < argc) {
+            horizon_ms = atof(argv[++i]);
+        } else if (arg == "--bucket-minutes" && i + 1 < argc) {
+            bucket_minutes = atoi(argv[++i]);
+        } else if (arg == "--max-order-age-s" && i + 1 < argc) {
+            max_order_age_s = atof(argv[++i]);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return Usage();
+        } else {
+            std::string prefix = BacktestResultPrefix(arg);
+            order_paths.push_back(prefix + "_order.csv");
+            fill_paths.push_back(prefix + "_fill.csv");
+        }
+    }
+    if (order_paths.empty() || bucket_minutes < 1 || bucket_minutes > 1440 || horizon_ms < 0.0)
+        return Usage();
+
+    TickArchive archive;
+    AsOfMids* mids = NULL;
+    if (!archive_root.empty()) {
+        if (!archive.Open(archive_root)) {
+            fprintf(stderr, "exec_quality: no <yyyymmdd>.tpk files in %s\n", archive_root.c_str());
+            return 1;
+        }
+        mids = new AsOfMids(archive);
+    }
+
+    ExecQuality quality(mids, int64_t(horizon_ms * 1e6), bucket_minutes, int64_t(max_order_age_s * 1e9));
+    std::string error;
+    if (!quality.Open(order_paths, fill_paths, &error)) {
+        fprintf(stderr, "exec_quality: %s\n", error.c_str());
+        return 1;
+    }
+    if (!quality.Run(&error)) {
+        fprintf(stderr, "exec_quality: %s\n", error.c_str());
+        return 1;
+    }
+
+    FILE* csv = NULL;
+    if (!csv_path.empty() && !(csv = fopen(csv_path.c_str(), "w"))) {
+        fprintf(stderr, "exec_quality: could not write %s\n", csv_path.c_str());
+        return 1;
+    }
+    quality.Report(csv);
+    if (csv)
+        fclose(csv);
+    delete mids;
+    return 0;
+}
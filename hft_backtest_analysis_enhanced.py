@@ -37,7 +37,9 @@ class EnhancedHFTBacktestAnalyzer:
         self.fill_df = None
         self.order_df = None
         self.pnl_df = None
+        self.fill_files = []
         self.results = {}
+        self.intervals = None
         self.load_data()
         
     def load_data(self):
@@ -51,6 +53,7 @@ class EnhancedHFTBacktestAnalyzer:
                     df = pd.read_csv(file_path)
                     df['TradeTime'] = pd.to_datetime(df['TradeTime'])
                     self.fill_df = df
+                    self.fill_files.append(file_path)
                     print(f"  [OK] Loaded FILL data: {filename} - {len(df)} trades")
                 elif 'order' in filename:
                     df = pd.read_csv(file_path)
@@ -222,6 +225,47 @@ class EnhancedHFTBacktestAnalyzer:
         
         return metrics, df
     
+    def calculate_confidence_intervals(self, resamples=10000, confidence=0.95):
+        """Stationary block-bootstrap intervals for the risk metrics, from pnl_bootstrap (make tools).
+
+        The tool resamples the same rows calculate_risk_metrics reads: the loaded PnL data, sorted by time.
+        Returns {metric: (lower, upper)} keyed like calculate_risk_metrics, or {} when the tool is not built.
+        Computed once per analyzer.
+        """
+        if self.intervals is not None:
+            return self.intervals
+        tool = Path(__file__).resolve().parent / 'pnl_bootstrap'
+        if self.pnl_df is None or len(self.pnl_df) < 2 or not tool.exists():
+            self.intervals = {}
+            return self.intervals
+        import subprocess
+        import tempfile
+        with tempfile.NamedTemporaryFile(suffix='.csv') as series, tempfile.NamedTemporaryFile(suffix='.csv') as out:
+            self.pnl_df.sort_values('Time')[['Time', 'Cumulative PnL']].to_csv(series.name, index=False)
+            subprocess.run([str(tool), series.name, '--resamples', str(resamples), '--confidence', str(confidence),
+                            '--csv', out.name], check=True, capture_output=True)
+            table = pd.read_csv(out.name).set_index('metric')
+        names = {'sharpe': 'Sharpe_Ratio', 'max_drawdown': 'Max_Drawdown', 'profit_factor': 'Profit_Factor',
+                 'win_rate_pct': 'Win_Rate', 'total_pnl': 'Net_PnL'}
+        self.intervals = {names[metric]: (row['lower'], row['upper']) for metric, row in table.iterrows()}
+        return self.intervals
+
+    def calculate_execution_quality(self):
+        """Shortfall, spread and fee drag per symbol from exec_quality (make tools), joining each fill file with
+        the order file next to it.
+
+        Returns a DataFrame with one row per symbol (bucket ALL), or None when the tool is not built.
+        """
+        tool = Path(__file__).resolve().parent / 'exec_quality'
+        if not self.fill_files or not tool.exists():
+            return None
+        import subprocess
+        import tempfile
+        with tempfile.NamedTemporaryFile(suffix='.csv') as out:
+            subprocess.run([str(tool)] + self.fill_files + ['--csv', out.name], check=True, capture_output=True)
+            table = pd.read_csv(out.name)
+        return table[table['bucket'] == 'ALL'].set_index('symbol')
+
     def analyze_fill_data(self):
         """Analyze fill data"""
         if self.fill_df is None:
@@ -519,6 +563,19 @@ class EnhancedHFTBacktestAnalyzer:
         pnl_results = self.analyze_pnl_data()
         risk_metrics, pnl_df_enhanced = self.calculate_risk_metrics()
         trade_pnl, positions, final_pnl = self.calculate_trade_pnl()
+        intervals = self.calculate_confidence_intervals()
+        execution = self.calculate_execution_quality()
+        execution_rows = ''
+        if execution is not None:
+            for symbol, row in execution.iterrows():
+                execution_rows += (f"<tr><td>{symbol}</td><td>{row['fills']:,.0f}</td><td>${row['notional']:,.2f}</td>"
+                                   f"<td>{row['slippage_bps']:.3f}</td><td>{row['fee_bps']:.3f}</td>"
+                                   f"<td>{row['shortfall_bps']:.3f}</td><td>${row['shortfall']:,.2f}</td></tr>")
+
+        def interval(key, fmt='{:.4f}'):
+            if key not in intervals:
+                return ''
+            return f"[{fmt.format(intervals[key][0])}, {fmt.format(intervals[key][1])}]"
         
         # Handle case when risk metrics are empty
         if not risk_metrics:
@@ -757,16 +814,16 @@ class EnhancedHFTBacktestAnalyzer:
         <div class="section">
             <h2>Risk Metrics</h2>
             <table>
-                <tr><th>Metric</th><th>Value</th></tr>
-                <tr><td>Sharpe Ratio</td><td>{risk_metrics.get('Sharpe_Ratio', 0):.4f}</td></tr>
-                <tr><td>Maximum Drawdown</td><td class="negative">${risk_metrics.get('Max_Drawdown', 0):,.2f}</td></tr>
-                <tr><td>Maximum Drawdown %</td><td class="negative">{risk_metrics.get('Max_Drawdown_Pct', 0):.2f}%</td></tr>
-                <tr><td>Average Drawdown</td><td class="negative">${risk_metrics.get('Avg_Drawdown', 0):,.2f}</td></tr>
-                <tr><td>Volatility (Annualized)</td><td>{risk_metrics.get('Volatility', 0):.4f}</td></tr>
-                <tr><td>Win Rate</td><td>{risk_metrics.get('Win_Rate', 0):.2f}%</td></tr>
-                <tr><td>Profit Factor</td><td>{risk_metrics.get('Profit_Factor', 0):.4f}</td></tr>
-                <tr><td>Winning Periods</td><td>{risk_metrics.get('Winning_Periods', 0):,}</td></tr>
-                <tr><td>Losing Periods</td><td>{risk_metrics.get('Losing_Periods', 0):,}</td></tr>
+                <tr><th>Metric</th><th>Value</th><th>95% Bootstrap CI</th></tr>
+                <tr><td>Sharpe Ratio</td><td>{risk_metrics.get('Sharpe_Ratio', 0):.4f}</td><td>{interval('Sharpe_Ratio')}</td></tr>
+                <tr><td>Maximum Drawdown</td><td class="negative">${risk_metrics.get('Max_Drawdown', 0):,.2f}</td><td>{interval('Max_Drawdown', '${:,.2f}')}</td></tr>
+                <tr><td>Maximum Drawdown %</td><td class="negative">{risk_metrics.get('Max_Drawdown_Pct', 0):.2f}%</td><td></td></tr>
+                <tr><td>Average Drawdown</td><td class="negative">${risk_metrics.get('Avg_Drawdown', 0):,.2f}</td><td></td></tr>
+                <tr><td>Volatility (Annualized)</td><td>{risk_metrics.get('Volatility', 0):.4f}</td><td></td></tr>
+                <tr><td>Win Rate</td><td>{risk_metrics.get('Win_Rate', 0):.2f}%</td><td>{interval('Win_Rate', '{:.2f}%')}</td></tr>
+                <tr><td>Profit Factor</td><td>{risk_metrics.get('Profit_Factor', 0):.4f}</td><td>{interval('Profit_Factor')}</td></tr>
+                <tr><td>Winning Periods</td><td>{risk_metrics.get('Winning_Periods', 0):,}</td><td></td></tr>
+                <tr><td>Losing Periods</td><td>{risk_metrics.get('Losing_Periods', 0):,}</td><td></td></tr>
             </table>
         </div>
         
@@ -791,6 +848,12 @@ class EnhancedHFTBacktestAnalyzer:
                 <tr><td>Min</td><td>${fill_results.get('price_stats', {}).get('min', 0):.2f}</td></tr>
                 <tr><td>Std Dev</td><td>${fill_results.get('price_stats', {}).get('std', 0):.2f}</td></tr>
             </table>
+
+            <h3>Execution Quality (bps of traded notional)</h3>
+            <table>
+                <tr><th>Symbol</th><th>Fills</th><th>Notional</th><th>Slippage</th><th>Fees</th><th>Shortfall</th><th>Shortfall ($)</th></tr>
+                {execution_rows or '<tr><td colspan="7">Build exec_quality (make tools) for this table</td></tr>'}
+            </table>
         </div>
         
         <div class="section">
@@ -857,6 +920,11 @@ class EnhancedHFTBacktestAnalyzer:
         print(f"Max Drawdown: ${risk_metrics.get('Max_Drawdown', 0):,.2f} ({risk_metrics.get('Max_Drawdown_Pct', 0):.2f}%)")
         print(f"Win Rate: {risk_metrics.get('Win_Rate', 0):.2f}%")
         print(f"Profit Factor: {risk_metrics.get('Profit_Factor', 0):.4f}")
+        intervals = self.calculate_confidence_intervals()
+        if intervals:
+            print("95% block-bootstrap intervals:")
+            for key in ('Sharpe_Ratio', 'Max_Drawdown', 'Win_Rate', 'Profit_Factor', 'Net_PnL'):
+                print(f"  {key}: [{intervals[key][0]:,.4f}, {intervals[key][1]:,.4f}]")
         
         # Create visualizations
         self.create_enhanced_visualizations()
@@ -0,0 +1,445 @@
+// markouts: post-trade markout curves, the mid at +10 ms ... +60 s after every fill, per symbol
+// and entry signal bucket.
+//
+//   markouts <result prefix> [more prefixes ...] --archive dir [--horizons-ms 0,10,100,...,60000]
+//            [--features a.bin [--features b.bin ...]] [--signal-edges 1,2,5,10] [--threads n]
+//            [--csv out.csv]
+//
+// A result prefix names a run's <prefix>_fill.csv (backtest or vwap_replay --out), as for
+// exec_quality. The markout of a fill at horizon h is s * (mid(t + h) - fill price) / fill price
+// in bps, s = +1 for buys and -1 for sells, so a positive curve means the market moved the
+// fill's way. Curves are share weighted; each point also has its standard error over fills.
+//
+// Fills are grouped by symbol and the symbols are spread over threads. Each thread pulls its
+// symbol's quotes out of the tick archive into sorted timestamp and mid arrays covering its fills
+// plus the longest horizon. The fills are sorted too, so every horizon keeps its own position in
+// the timestamp array and gallops forward from it (exponential steps, then a binary search within
+// the last step): mid(t) is the last quote at or before t, the same as pandas merge_asof with
+// direction='backward'. A horizon past the last quote of the capture is left out.
+//
+// The signal bucket is |deviation_bps| of the strategy's last feature record for the symbol at or
+// before the fill (export_features), joined the same way and split at --signal-edges. Without
+// --features every fill is in one bucket.
+
+#include "BacktestCsv.h"
+#include "TickArchive.h"
+#include "TickStore.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct MarkoutFill {
+    int64_t timestamp_ns;
+    double price;
+    double shares;
+    int sign;
+    int bucket;
+
+    bool operator<(const MarkoutFill& other) const { return timestamp_ns < other.timestamp_ns; }
+};
+
+// Time sorted values of one symbol: mids from the archive, or deviations from a feature export
+struct TimeSeries {
+    std::vector<int64_t> timestamps_ns;
+    std::vector<double> values;
+
+    void Add(int64_t timestamp_ns, double value)
+    {
+        timestamps_ns.push_back(timestamp_ns);
+        values.push_back(value);
+    }
+
+    // Captures can hold late events, so values arrive in file order; a stable sort keeps the
+    // last of several values at one timestamp last, as merge_asof does
+    void Sort()
+    {
+        if (std::is_sorted(timestamps_ns.begin(), timestamps_ns.end()))
+            return;
+        std::vector<std::pair<int64_t, double> > points(timestamps_ns.size());
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = std::make_pair(timestamps_ns[i], values[i]);
+        std::stable_sort(points.begin(), points.end(), EarlierPoint);
+        for (size_t i = 0; i < points.size(); ++i) {
+            timestamps_ns[i] = points[i].first;
+            values[i] = points[i].second;
+        }
+    }
+
+    static bool EarlierPoint(const std::pair<int64_t, double>& a, const std::pair<int64_t, double>& b)
+    {
+        return a.first < b.first;
+    }
+};
+
+// Number of timestamps at or before t, searching forward from from. Every timestamp before from
+// must be at or before t.
+static size_t GallopAsOf(const std::vector<int64_t>& timestamps_ns, size_t from, int64_t t)
+{
+    size_t n = timestamps_ns.size();
+    size_t lo = from, hi = from, step = 1;
+    while (hi < n && timestamps_ns[hi] <= t) {
+        lo = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    hi = std::min(hi, n);
+    return std::upper_bound(timestamps_ns.begin() + lo, timestamps_ns.begin() + hi, t) - timestamps_ns.begin();
+}
+
+// Share weighted markout sums of one symbol, bucket and horizon
+struct MarkoutStats {
+    uint64_t fills;
+    double shares;
+    double sum;        // shares * markout_bps
+    double sum_sq;     // shares * markout_bps^2
+
+    MarkoutStats() : fills(0), shares(0.0), sum(0.0), sum_sq(0.0) {}
+
+    void Add(double weight, double markout_bps)
+    {
+        ++fills;
+        shares += weight;
+        sum += weight * markout_bps;
+        sum_sq += weight * markout_bps * markout_bps;
+    }
+
+    void Add(const MarkoutStats& other)
+    {
+        fills += other.fills;
+        shares += other.shares;
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+    }
+
+    double mean() const { return shares > 0.0 ? sum / shares : NAN; }
+
+    double stderr_bps() const
+    {
+        if (fills < 2)
+            return NAN;
+        double m = mean();
+        return sqrt(std::max(0.0, sum_sq / shares - m * m) / double(fills));
+    }
+};
+
+class MarkoutEngine {
+public:
+    MarkoutEngine(const TickArchive& archive, const std::vector<int64_t>& horizons_ns, size_t buckets)
+        : archive_(archive), horizons_ns_(horizons_ns), buckets_(buckets), archive_events_(0)
+    {
+    }
+
+    // stats[bucket * horizons + horizon] for one symbol; fills must be sorted by time
+    void Run(const std::string& symbol, const std::vector<MarkoutFill>& fills, std::vector<MarkoutStats>* stats)
+    {
+        stats->assign(buckets_ * horizons_ns_.size(), MarkoutStats());
+        if (fills.empty())
+            return;
+
+        TimeSeries mids;
+        LoadMids(symbol, fills.front().timestamp_ns, fills.back().timestamp_ns + horizons_ns_.back(), &mids);
+        mids.Sort();
+        if (mids.timestamps_ns.empty())
+            return;
+        int64_t last_quote_ns = mids.timestamps_ns.back();
+
+        std::vector<size_t> positions(horizons_ns_.size(), 0);
+        for (size_t i = 0; i < fills.size(); ++i) {
+            const MarkoutFill& fill = fills[i];
+            MarkoutStats* row = &(*stats)[fill.bucket * horizons_ns_.size()];
+            for (size_t h = 0; h < horizons_ns_.size(); ++h) {
+                int64_t t = fill.timestamp_ns + horizons_ns_[h];
+                positions[h] = GallopAsOf(mids.timestamps_ns, positions[h], t);
+                if (positions[h] == 0 || t > last_quote_ns)
+                    continue;
+                double mid = mids.values[positions[h] - 1];
+                row[h].Add(fill.shares, fill.sign * (mid - fill.price) / fill.price * 1e4);
+            }
+        }
+    }
+
+    uint64_t archive_events() const { return archive_events_; }
+
+private:
+    // Quotes are also carried by trade events; either updates the mid
+    void LoadMids(const std::string& symbol, int64_t start_ns, int64_t end_ns, TimeSeries* mids)
+    {
+        TickArchiveCursor cursor(archive_);
+        cursor.Seek(start_ns - kLookbackNs, end_ns + 1, std::vector<std::string>(1, symbol));
+        while (const MarketEventRecord* event = cursor.Next()) {
+            ++archive_events_;
+            if (event->bid > 0.0 && event->ask > 0.0)
+                mids->Add(event->timestamp_ns, (event->bid + event->ask) / 2.0);
+        }
+    }
+
+    static const int64_t kLookbackNs = 300LL * 1000000000LL;
+
+    const TickArchive& archive_;
+    const std::vector<int64_t>& horizons_ns_;
+    size_t buckets_;
+    uint64_t archive_events_;
+};
+
+// Parses "a,b,c" into numbers; false on anything else
+static bool ParseList(const std::string& text, std::vector<double>* values)
+{
+    values->clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos)
+            comma = text.size();
+        std::string field = text.substr(start, comma - start);
+        char* end;
+        double value = strtod(field.c_str(), &end);
+        if (field.empty() || *end != '\0')
+            return false;
+        values->push_back(value);
+        start = comma + 1;
+    }
+    return !values->empty();
+}
+
+static std::string BucketLabel(const std::vector<double>& edges, size_t bucket)
+{
+    char label[64];
+    if (edges.empty())
+        return "all";
+    if (bucket == 0)
+        snprintf(label, sizeof(label), "<%g", edges[0]);
+    else if (bucket == edges.size())
+        snprintf(label, sizeof(label), ">=%g", edges.back());
+    else
+        snprintf(label, sizeof(label), "%g-%g", edges[bucket - 1], edges[bucket]);
+    return label;
+}
+
+// Deviation series per symbol from feature exports, sorted by time
+static bool LoadFeatures(const std::vector<std::string>& paths, std::map<std::string, TimeSeries>* features)
+{
+    for (size_t i = 0; i < paths.size(); ++i) {
+        TickStoreFile file;
+        if (!file.Open(paths[i]) || file.compressed() || file.header().record_type != TICK_RECORD_TYPE_FEATURE ||
+            file.header().record_size != sizeof(FeatureRecord)) {
+            fprintf(stderr, "markouts: %s is not a feature export\n", paths[i].c_str());
+            return false;
+        }
+        const FeatureRecord* records = file.records<FeatureRecord>();
+        for (size_t r = 0; r < file.record_count(); ++r) {
+            if (!records[r].vwap_ready)
+                continue;
+            std::string symbol(records[r].symbol, strnlen(records[r].symbol, sizeof(records[r].symbol)));
+            (*features)[symbol].Add(records[r].timestamp_ns, records[r].deviation_bps);
+        }
+    }
+    for (std::map<std::string, TimeSeries>::iterator it = features->begin(); it != features->end(); ++it)
+        it->second.Sort();
+    return true;
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: markouts <result prefix> [more ...] --archive dir [--horizons-ms 0,10,100,...,60000]\n"
+                    "                [--features a.bin ...] [--signal-edges 1,2,5,10] [--threads n] [--csv out.csv]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> fill_paths, feature_paths;
+    std::string archive_root, csv_path;
+    std::vector<double> horizons_ms, edges;
+    ParseList("0,10,100,500,1000,5000,10000,30000,60000", &horizons_ms);
+    ParseList("1,2,5,10", &edges);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--archive" && i + 1 < argc) {
+            archive_root = argv[++i];
+        } else if (arg == "--horizons-ms" && i + 1 < argc) {
+            if (!ParseList(argv[++i], &horizons_ms))
+                return Usage();
+        } else if (arg == "--features" && i + 1 < argc) {
+            feature_paths.push_back(argv[++i]);
+        } else if (arg == "--signal-edges" && i + 1 < argc) {
+            if (!ParseList(argv[++i], &edges))
+                return Usage();
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return Usage();
+        } else {
+            fill_paths.push_back(BacktestResultPrefix(arg) + "_fill.csv");
+        }
+    }
+    if (fill_paths.empty() || archive_root.empty())
+        return Usage();
+    std::sort(horizons_ms.begin(), horizons_ms.end());
+    std::sort(edges.begin(), edges.end());
+    if (horizons_ms.front() < 0.0)
+        return Usage();
+    std::vector<int64_t> horizons_ns;
+    for (size_t h = 0; h < horizons_ms.size(); ++h)
+        horizons_ns.push_back(int64_t(horizons_ms[h] * 1e6));
+
+    TickArchive archive;
+    if (!archive.Open(archive_root)) {
+        fprintf(stderr, "markouts: no <yyyymmdd>.tpk files in %s\n", archive_root.c_str());
+        return 1;
+    }
+
+    std::map<std::string, TimeSeries> features;
+    if (!LoadFeatures(feature_paths, &features))
+        return 1;
+    if (feature_paths.empty())
+        edges.clear();
+    size_t buckets = edges.size() + 1;
+
+    // Fills by symbol, each tagged with its signal bucket
+    timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    BacktestCsvReader reader;
+    if (!reader.Open(fill_paths)) {
+        fprintf(stderr, "markouts: %s\n", reader.error().empty() ? ("no fills in " + fill_paths[0]).c_str() : reader.error().c_str());
+        return 1;
+    }
+    int time_column = reader.Column("TradeTime"), symbol_column = reader.Column("Symbol");
+    int quantity_column = reader.Column("Quantity"), price_column = reader.Column("Price");
+    if (time_column < 0 || symbol_column < 0 || quantity_column < 0 || price_column < 0) {
+        fprintf(stderr, "markouts: %s is missing TradeTime, Symbol, Quantity or Price\n", fill_paths[0].c_str());
+        return 1;
+    }
+    std::map<std::string, std::vector<MarkoutFill> > fills;
+    uint64_t bad_rows = 0;
+    while (reader.Next()) {
+        MarkoutFill fill;
+        double quantity = reader.GetDouble(quantity_column);
+        fill.price = reader.GetDouble(price_column);
+        if (!ParseBacktestTime(reader.Get(time_column), &fill.timestamp_ns) || quantity == 0.0 || fill.price <= 0.0) {
+            ++bad_rows;
+            continue;
+        }
+        fill.shares = fabs(quantity);
+        fill.sign = quantity > 0.0 ? 1 : -1;
+        fill.bucket = 0;
+        fills[reader.Get(symbol_column)].push_back(fill);
+    }
+    if (!reader.error().empty()) {
+        fprintf(stderr, "markouts: %s\n", reader.error().c_str());
+        return 1;
+    }
+
+    // One task per symbol, taken off a shared counter
+    std::vector<std::string> symbols;
+    std::vector<std::vector<MarkoutFill>*> symbol_fills;
+    for (std::map<std::string, std::vector<MarkoutFill> >::iterator it = fills.begin(); it != fills.end(); ++it) {
+        symbols.push_back(it->first);
+        symbol_fills.push_back(&it->second);
+    }
+    std::vector<std::vector<MarkoutStats> > results(symbols.size());
+    std::atomic<size_t> next_symbol(0);
+    std::atomic<uint64_t> archive_events(0);
+    std::vector<std::thread> workers;
+    threads = unsigned(std::min<size_t>(threads, std::max<size_t>(symbols.size(), 1)));
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            MarkoutEngine engine(archive, horizons_ns, buckets);
+            for (size_t s = next_symbol++; s < symbols.size(); s = next_symbol++) {
+                std::vector<MarkoutFill>& sorted = *symbol_fills[s];
+                std::sort(sorted.begin(), sorted.end());
+                std::map<std::string, TimeSeries>::const_iterator signal = features.find(symbols[s]);
+                if (signal != features.end()) {
+                    size_t position = 0;
+                    for (size_t i = 0; i < sorted.size(); ++i) {
+                        position = GallopAsOf(signal->second.timestamps_ns, position, sorted[i].timestamp_ns);
+                        double deviation = position ? fabs(signal->second.values[position - 1]) : 0.0;
+                        sorted[i].bucket = int(std::upper_bound(edges.begin(), edges.end(), deviation) - edges.begin());
+                    }
+                }
+                engine.Run(symbols[s], sorted, &results[s]);
+            }
+            archive_events += engine.archive_events();
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+    timespec finished;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double seconds = double(finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+
+    uint64_t fill_count = 0;
+    for (size_t s = 0; s < symbols.size(); ++s)
+        fill_count += symbol_fills[s]->size();
+    printf("%llu fills, %zu symbols, %zu horizons, %llu archive events, %u threads: %.3fs (bad rows %llu)\n",
+           (unsigned long long)fill_count, symbols.size(), horizons_ns.size(), (unsigned long long)archive_events.load(),
+           threads, seconds, (unsigned long long)bad_rows);
+
+    // Curves per symbol over all buckets, then the total; mean markout in bps at each horizon
+    size_t horizons = horizons_ns.size();
+    std::vector<MarkoutStats> total(buckets * horizons);
+    printf("%-8s %-8s", "symbol", "bucket");
+    for (size_t h = 0; h < horizons; ++h)
+        printf(" %8gms", horizons_ms[h]);
+    printf("\n");
+    for (size_t s = 0; s <= symbols.size(); ++s) {
+        std::vector<MarkoutStats> curve(horizons);
+        for (size_t b = 0; b < buckets; ++b) {
+            for (size_t h = 0; h < horizons; ++h) {
+                if (s < symbols.size()) {
+                    curve[h].Add(results[s][b * horizons + h]);
+                    total[b * horizons + h].Add(results[s][b * horizons + h]);
+                } else {
+                    curve[h].Add(total[b * horizons + h]);
+                }
+            }
+        }
+        printf("%-8s %-8s", s < symbols.size() ? symbols[s].c_str() : "ALL", "all");
+        for (size_t h = 0; h < horizons; ++h)
+            printf(" %10.3f", curve[h].mean());
+        printf("\n");
+    }
+    if (buckets > 1) {
+        for (size_t b = 0; b < buckets; ++b) {
+            printf("%-8s %-8s", "ALL", BucketLabel(edges, b).c_str());
+            for (size_t h = 0; h < horizons; ++h)
+                printf(" %10.3f", total[b * horizons + h].mean());
+            printf("\n");
+        }
+    }
+
+    if (!csv_path.empty()) {
+        FILE* csv = fopen(csv_path.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "markouts: could not write %s\n", csv_path.c_str());
+            return 1;
+        }
+        fprintf(csv, "symbol,signal_bucket,horizon_ms,fills,shares,markout_bps,stderr_bps\n");
+        for (size_t s = 0; s <= symbols.size(); ++s) {
+            const std::vector<MarkoutStats>& stats = s < symbols.size() ? results[s] : total;
+            const char* symbol = s < symbols.size() ? symbols[s].c_str() : "ALL";
+            for (size_t b = 0; b < buckets; ++b) {
+                for (size_t h = 0; h < horizons; ++h) {
+                    const MarkoutStats& point = stats[b * horizons + h];
+                    fprintf(csv, "%s,%s,%g,%llu,%.0f,%.6f,%.6f\n", symbol, BucketLabel(edges, b).c_str(), horizons_ms[h],
+                            (unsigned long long)point.fills, point.shares, point.mean(), point.stderr_bps());
+                }
+            }
+        }
+        fclose(csv);
+    }
+    return 0;
+}
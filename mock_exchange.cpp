@@ -0,0 +1,588 @@
+// mock_exchange: loopback exchange for measuring the order path outside the Strategy Studio server.
+//
+//   mock_exchange serve <endpoint> [--archive dir --start t --end t [--symbols A,B]] [--advance n] [--busy-poll]
+//   mock_exchange bench <endpoint> [--rounds n] [--batch k] [--rate rounds_per_sec] [--symbol S]
+//
+// Endpoints are unix:/path or tcp:127.0.0.1:port. The server keeps an in-memory book per
+// symbol: the top of book comes from the tick archive, which is replayed n events per inbound
+// message, and client limit orders rest on it until the replayed quote crosses them. Market and
+// marketable limit orders fill in full at the touch. Without an archive every symbol trades
+// against a fixed 100.00 x 100.01 quote.
+//
+// bench sends rounds of k resting limit orders plus one market order in a single write, then
+// cancels the limit orders in a second write, and reports ack/fill/cancel round trips.
+
+#include "MockExchangeClient.h"
+#include "TickArchive.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct MockSession {
+    int fd;
+    std::vector<char> input;
+    std::vector<char> output;
+    bool want_write;    // output is waiting for EPOLLOUT after the socket buffer filled, reads are paused
+
+    MockSession() : fd(-1), want_write(false) {}
+};
+
+struct MockRestingOrder {
+    MockSession* session;
+    uint64_t client_order_id;
+    uint64_t exchange_order_id;
+    std::string symbol;
+    double price;
+    int leaves;
+    uint8_t side;
+};
+
+// Resting client orders on top of the replayed quote. Price levels keep time priority through multimap insertion order.
+struct MockBook {
+    double bid;
+    double ask;
+    std::multimap<double, uint64_t, std::greater<double> > bids;
+    std::multimap<double, uint64_t> asks;
+
+    MockBook() : bid(0.0), ask(0.0) {}
+};
+
+class MockExchange {
+public:
+    MockExchange() : epoll_fd_(-1), listen_fd_(-1), advance_(1), next_exchange_id_(1), replay_position_(0), messages_(0) {}
+
+    void set_advance(int advance) { advance_ = advance; }
+
+    // Loads the market events that drive the books
+    size_t LoadMarket(const TickArchive& archive, int64_t start_ns, int64_t end_ns, const std::vector<std::string>& symbols)
+    {
+        TickArchiveCursor cursor(archive);
+        cursor.Seek(start_ns, end_ns, symbols);
+        while (const MarketEventRecord* event = cursor.Next()) {
+            if (event->bid > 0.0 && event->ask > 0.0)
+                market_.push_back(*event);
+        }
+        // Seed every book with the first quote so orders can trade from the first message
+        for (size_t i = 0; i < market_.size(); ++i) {
+            MockBook& book = books_[SymbolOf(market_[i])];
+            if (book.bid == 0.0) {
+                book.bid = market_[i].bid;
+                book.ask = market_[i].ask;
+            }
+        }
+        return market_.size();
+    }
+
+    bool Listen(const std::string& endpoint)
+    {
+        struct sockaddr_storage address;
+        socklen_t length;
+        int family = MockSocketAddress(endpoint, &address, &length);
+        if (family < 0)
+            return false;
+        if (family == AF_UNIX)
+            unlink(reinterpret_cast<struct sockaddr_un*>(&address)->sun_path);
+
+        listen_fd_ = socket(family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (listen_fd_ < 0)
+            return false;
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), length) != 0 ||
+            listen(listen_fd_, 16) != 0)
+            return false;
+        family_ = family;
+
+        epoll_fd_ = epoll_create1(0);
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event) == 0;
+    }
+
+    // Serves until a signal stops it. Replies produced by one wakeup go out in one write per session;
+    // whatever the socket does not take waits for EPOLLOUT.
+    void Run(bool busy_poll, volatile sig_atomic_t* stop)
+    {
+        struct epoll_event events[64];
+        while (!*stop) {
+            int n = epoll_wait(epoll_fd_, events, 64, busy_poll ? 0 : 100);
+            for (int i = 0; i < n; ++i) {
+                MockSession* session = static_cast<MockSession*>(events[i].data.ptr);
+                if (!session) {
+                    Accept();
+                    continue;
+                }
+                if ((events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !Read(session))
+                    CloseSession(session);
+                else if ((events[i].events & EPOLLOUT) && !FlushSession(session))
+                    CloseSession(session);
+            }
+            for (size_t i = 0; i < sessions_.size();) {
+                MockSession* session = sessions_[i];
+                if (!session->want_write && !FlushSession(session))
+                    CloseSession(session);
+                else
+                    ++i;
+            }
+        }
+        printf("mock_exchange: %llu messages, %zu resting orders\n", (unsigned long long)messages_, resting_.size());
+    }
+
+private:
+    static std::string SymbolOf(const MarketEventRecord& event)
+    {
+        return std::string(event.symbol, strnlen(event.symbol, sizeof(event.symbol)));
+    }
+
+    void Accept()
+    {
+        int fd;
+        while ((fd = accept4(listen_fd_, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+            MockTuneSocket(fd, family_);
+            MockSession* session = new MockSession();
+            session->fd = fd;
+            sessions_.push_back(session);
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.ptr = session;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+
+    void CloseSession(MockSession* session)
+    {
+        for (std::unordered_map<uint64_t, MockRestingOrder>::iterator it = resting_.begin(); it != resting_.end();) {
+            if (it->second.session == session) {
+                RemoveFromBook(it->second);
+                it = resting_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session->fd, NULL);
+        ::close(session->fd);
+        sessions_.erase(std::find(sessions_.begin(), sessions_.end(), session));
+        delete session;
+    }
+
+    bool Read(MockSession* session)
+    {
+        char buffer[65536];
+        ssize_t n = ::read(session->fd, buffer, sizeof(buffer));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+            return false;
+        if (n < 0)
+            return true;
+        session->input.insert(session->input.end(), buffer, buffer + n);
+
+        size_t offset = 0;
+        while (session->input.size() - offset >= sizeof(MockMessageHeader)) {
+            MockMessageHeader header;
+            memcpy(&header, &session->input[offset], sizeof(header));
+            if (header.length < sizeof(header))
+                return false;
+            if (session->input.size() - offset < header.length)
+                break;
+            if (!Dispatch(session, header, &session->input[offset]))
+                return false;
+            offset += header.length;
+        }
+        session->input.erase(session->input.begin(), session->input.begin() + offset);
+        return true;
+    }
+
+    bool Dispatch(MockSession* session, const MockMessageHeader& header, const char* bytes)
+    {
+        ++messages_;
+        AdvanceMarket();
+        if (header.type == MOCK_MSG_NEW_ORDER && header.length == sizeof(MockNewOrder)) {
+            MockNewOrder message;
+            memcpy(&message, bytes, sizeof(message));
+            OnNewOrder(session, message);
+        } else if ((header.type == MOCK_MSG_CANCEL || header.type == MOCK_MSG_CANCEL_ALL) && header.length == sizeof(MockCancel)) {
+            MockCancel message;
+            memcpy(&message, bytes, sizeof(message));
+            if (header.type == MOCK_MSG_CANCEL)
+                OnCancel(session, message);
+            else
+                OnCancelAll(session, message);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    static uint64_t OrderKey(const MockSession* session, uint64_t client_order_id)
+    {
+        return (uint64_t(session->fd) << 48) ^ client_order_id;
+    }
+
+    MockBook* FindBook(const std::string& symbol)
+    {
+        std::map<std::string, MockBook>::iterator it = books_.find(symbol);
+        if (it != books_.end())
+            return &it->second;
+        if (!market_.empty())
+            return NULL;
+        MockBook& book = books_[symbol];
+        book.bid = 100.00;
+        book.ask = 100.01;
+        return &book;
+    }
+
+    void OnNewOrder(MockSession* session, const MockNewOrder& message)
+    {
+        std::string symbol(message.symbol, strnlen(message.symbol, sizeof(message.symbol)));
+        MockBook* book = FindBook(symbol);
+        if (message.quantity <= 0 || (message.side != MOCK_SIDE_BUY && message.side != MOCK_SIDE_SELL)) {
+            Reject(session, message.client_order_id, message.client_send_ns, MOCK_REJECT_BAD_QUANTITY);
+            return;
+        }
+        if (!book) {
+            Reject(session, message.client_order_id, message.client_send_ns, MOCK_REJECT_NO_MARKET);
+            return;
+        }
+
+        uint64_t exchange_id = next_exchange_id_++;
+        Report(session, MOCK_MSG_ACK, message.client_order_id, message.client_send_ns, exchange_id, 0.0, 0, message.quantity);
+
+        bool buy = message.side == MOCK_SIDE_BUY;
+        double touch = buy ? book->ask : book->bid;
+        bool marketable = message.order_type == MOCK_ORDER_TYPE_MARKET || (buy ? message.price >= touch : message.price <= touch);
+        if (marketable) {
+            Report(session, MOCK_MSG_FILL, message.client_order_id, message.client_send_ns, exchange_id, touch, message.quantity, 0);
+            return;
+        }
+
+        MockRestingOrder order;
+        order.session = session;
+        order.client_order_id = message.client_order_id;
+        order.exchange_order_id = exchange_id;
+        order.symbol = symbol;
+        order.price = message.price;
+        order.leaves = message.quantity;
+        order.side = message.side;
+        uint64_t key = OrderKey(session, message.client_order_id);
+        resting_[key] = order;
+        if (buy)
+            book->bids.insert(std::make_pair(order.price, key));
+        else
+            book->asks.insert(std::make_pair(order.price, key));
+    }
+
+    void OnCancel(MockSession* session, const MockCancel& message)
+    {
+        std::unordered_map<uint64_t, MockRestingOrder>::iterator it = resting_.find(OrderKey(session, message.client_order_id));
+        if (it == resting_.end()) {
+            Reject(session, message.client_order_id, message.client_send_ns, MOCK_REJECT_UNKNOWN_ORDER);
+            return;
+        }
+        CancelResting(it, message.client_send_ns);
+    }
+
+    void OnCancelAll(MockSession* session, const MockCancel& message)
+    {
+        std::string symbol(message.symbol, strnlen(message.symbol, sizeof(message.symbol)));
+        for (std::unordered_map<uint64_t, MockRestingOrder>::iterator it = resting_.begin(); it != resting_.end();) {
+            if (it->second.session == session && (symbol.empty() || it->second.symbol == symbol))
+                it = CancelResting(it, message.client_send_ns);
+            else
+                ++it;
+        }
+    }
+
+    std::unordered_map<uint64_t, MockRestingOrder>::iterator
+    CancelResting(std::unordered_map<uint64_t, MockRestingOrder>::iterator it, int64_t client_send_ns)
+    {
+        const MockRestingOrder& order = it->second;
+        Report(order.session, MOCK_MSG_CANCEL_ACK, order.client_order_id, client_send_ns, order.exchange_order_id, 0.0,
+               order.leaves, 0);
+        RemoveFromBook(order);
+        return resting_.erase(it);
+    }
+
+    void RemoveFromBook(const MockRestingOrder& order)
+    {
+        MockBook& book = books_[order.symbol];
+        uint64_t key = OrderKey(order.session, order.client_order_id);
+        if (order.side == MOCK_SIDE_BUY) {
+            typedef std::multimap<double, uint64_t, std::greater<double> >::iterator Iterator;
+            std::pair<Iterator, Iterator> range = book.bids.equal_range(order.price);
+            for (Iterator it = range.first; it != range.second; ++it) {
+                if (it->second == key) { book.bids.erase(it); break; }
+            }
+        } else {
+            typedef std::multimap<double, uint64_t>::iterator Iterator;
+            std::pair<Iterator, Iterator> range = book.asks.equal_range(order.price);
+            for (Iterator it = range.first; it != range.second; ++it) {
+                if (it->second == key) { book.asks.erase(it); break; }
+            }
+        }
+    }
+
+    // Steps the replayed market and fills resting orders the new quote crosses, at their limit price
+    void AdvanceMarket()
+    {
+        for (int i = 0; i < advance_ && !market_.empty(); ++i) {
+            const MarketEventRecord& event = market_[replay_position_];
+            replay_position_ = (replay_position_ + 1) % market_.size();
+            MockBook& book = books_[SymbolOf(event)];
+            book.bid = event.bid;
+            book.ask = event.ask;
+
+            while (!book.bids.empty() && book.bids.begin()->first >= book.ask)
+                FillResting(book.bids.begin()->second, &book.bids, book.bids.begin());
+            while (!book.asks.empty() && book.asks.begin()->first <= book.bid)
+                FillResting(book.asks.begin()->second, &book.asks, book.asks.begin());
+        }
+    }
+
+    template<typename Side>
+    void FillResting(uint64_t key, Side* side, typename Side::iterator level)
+    {
+        side->erase(level);
+        std::unordered_map<uint64_t, MockRestingOrder>::iterator it = resting_.find(key);
+        if (it == resting_.end())
+            return;
+        const MockRestingOrder& order = it->second;
+        // Passive fills are unsolicited, so there is no request time to echo
+        Report(order.session, MOCK_MSG_FILL, order.client_order_id, 0, order.exchange_order_id, order.price, order.leaves, 0);
+        resting_.erase(it);
+    }
+
+    void Reject(MockSession* session, uint64_t client_order_id, int64_t client_send_ns, MockRejectReason reason)
+    {
+        Report(session, MOCK_MSG_REJECT, client_order_id, client_send_ns, 0, 0.0, 0, 0, reason);
+    }
+
+    void Report(MockSession* session, MockMessageType type, uint64_t client_order_id, int64_t client_send_ns,
+                uint64_t exchange_order_id, double price, int quantity, int leaves,
+                MockRejectReason reason = MOCK_REJECT_NONE)
+    {
+        MockExecutionReport report;
+        InitMockMessage(report, type);
+        report.client_order_id = client_order_id;
+        report.client_send_ns = client_send_ns;
+        report.exchange_order_id = exchange_order_id;
+        report.price = price;
+        report.quantity = quantity;
+        report.leaves = leaves;
+        report.reject_reason = uint8_t(reason);
+        const char* bytes = reinterpret_cast<const char*>(&report);
+        session->output.insert(session->output.end(), bytes, bytes + sizeof(report));
+    }
+
+    // Writes as much output as the socket takes. The rest stays in session->output and the session
+    // waits for EPOLLOUT instead of reads, so a client that stops reading neither stalls the others
+    // nor grows its backlog. False on a write error.
+    bool FlushSession(MockSession* session)
+    {
+        size_t sent = 0;
+        while (sent < session->output.size()) {
+            ssize_t n = ::write(session->fd, &session->output[sent], session->output.size() - sent);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN)
+                    return false;
+                break;
+            }
+            sent += size_t(n);
+        }
+        session->output.erase(session->output.begin(), session->output.begin() + sent);
+
+        bool want_write = !session->output.empty();
+        if (want_write != session->want_write) {
+            struct epoll_event event;
+            event.events = want_write ? EPOLLOUT : EPOLLIN;
+            event.data.ptr = session;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, session->fd, &event);
+            session->want_write = want_write;
+        }
+        return true;
+    }
+
+private:
+    int epoll_fd_;
+    int listen_fd_;
+    int family_;
+    int advance_;
+    uint64_t next_exchange_id_;
+    std::vector<MarketEventRecord> market_;
+    size_t replay_position_;
+    std::map<std::string, MockBook> books_;
+    std::unordered_map<uint64_t, MockRestingOrder> resting_;
+    std::vector<MockSession*> sessions_;
+    uint64_t messages_;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void OnSignal(int)
+{
+    g_stop = 1;
+}
+
+static void PrintLatency(const char* name, const LatencyHistogram& histogram)
+{
+    printf("%-7s n=%llu mean=%.0fns p50<=%lldns p90<=%lldns p99<=%lldns p99.9<=%lldns max=%lldns\n", name,
+           (unsigned long long)histogram.count(), histogram.mean_ns(), (long long)histogram.Quantile(0.5),
+           (long long)histogram.Quantile(0.9), (long long)histogram.Quantile(0.99), (long long)histogram.Quantile(0.999),
+           (long long)histogram.max_ns());
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: mock_exchange serve <endpoint> [--archive dir --start t --end t [--symbols A,B]] [--advance n] [--busy-poll]\n"
+                    "       mock_exchange bench <endpoint> [--rounds n] [--batch k] [--rate rounds_per_sec] [--symbol S]\n");
+    return 2;
+}
+
+static int Serve(int argc, char** argv)
+{
+    std::string archive_root, start, end, symbols;
+    int advance = 1;
+    bool busy_poll = false;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--archive" && i + 1 < argc) archive_root = argv[++i];
+        else if (arg == "--start" && i + 1 < argc) start = argv[++i];
+        else if (arg == "--end" && i + 1 < argc) end = argv[++i];
+        else if (arg == "--symbols" && i + 1 < argc) symbols = argv[++i];
+        else if (arg == "--advance" && i + 1 < argc) advance = atoi(argv[++i]);
+        else if (arg == "--busy-poll") busy_poll = true;
+        else return Usage();
+    }
+
+    MockExchange exchange;
+    exchange.set_advance(advance);
+    if (!archive_root.empty()) {
+        TickArchive archive;
+        int64_t start_ns, end_ns;
+        if (!archive.Open(archive_root) || !TickArchive::ParseTime(start, &start_ns) || !TickArchive::ParseTime(end, &end_ns)) {
+            fprintf(stderr, "mock_exchange: --archive needs a tick archive and --start/--end times\n");
+            return 1;
+        }
+        std::vector<std::string> symbol_list;
+        for (size_t pos = 0; pos < symbols.size();) {
+            size_t comma = symbols.find(',', pos);
+            if (comma == std::string::npos)
+                comma = symbols.size();
+            symbol_list.push_back(symbols.substr(pos, comma - pos));
+            pos = comma + 1;
+        }
+        printf("mock_exchange: %zu market events loaded\n", exchange.LoadMarket(archive, start_ns, end_ns, symbol_list));
+    }
+
+    if (!exchange.Listen(argv[2])) {
+        fprintf(stderr, "mock_exchange: could not listen on %s\n", argv[2]);
+        return 1;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+    fflush(stdout);
+    exchange.Run(busy_poll, &g_stop);
+    return 0;
+}
+
+static int Bench(int argc, char** argv)
+{
+    int rounds = 10000, batch = 4;
+    double rate = 0.0;
+    std::string symbol = "SPY";
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--rounds" && i + 1 < argc) rounds = atoi(argv[++i]);
+        else if (arg == "--batch" && i + 1 < argc) batch = atoi(argv[++i]);
+        else if (arg == "--rate" && i + 1 < argc) rate = atof(argv[++i]);
+        else if (arg == "--symbol" && i + 1 < argc) symbol = argv[++i];
+        else return Usage();
+    }
+
+    MockExchangeClient client;
+    if (!client.Connect(argv[2])) {
+        fprintf(stderr, "mock_exchange: could not connect to %s\n", argv[2]);
+        return 1;
+    }
+    client.set_autoflush(false);
+
+    int rejects = 0;
+    int pending = 0;
+    std::function<void(const MockExecutionReport&)> handler = [&](const MockExecutionReport& report) {
+        if (report.header.type == MOCK_MSG_REJECT)
+            ++rejects;
+        if (report.client_send_ns != 0)
+            --pending;
+    };
+    TscClock& clock = TscClock::Instance();
+    int64_t interval_ns = rate > 0.0 ? int64_t(1e9 / rate) : 0;
+    int64_t started = clock.NowNanos();
+    std::vector<uint64_t> working(batch);
+
+    for (int round = 0; round < rounds; ++round) {
+        // One write: k passive limit orders far from the market plus one market order
+        for (int i = 0; i < batch; ++i)
+            working[i] = client.SendNewOrder(MockOrderParams(symbol, 100, 0.01, MOCK_SIDE_BUY, MOCK_ORDER_TYPE_LIMIT));
+        client.SendNewOrder(MockOrderParams(symbol, 100, 0.0, round % 2 ? MOCK_SIDE_SELL : MOCK_SIDE_BUY, MOCK_ORDER_TYPE_MARKET));
+        pending += batch + 2;
+        client.Flush();
+        while (pending > 0 && rejects == 0) {
+            if (client.Poll(1000, handler) < 0)
+                return 1;
+        }
+
+        // Second write cancels them
+        for (int i = 0; i < batch; ++i)
+            client.SendCancelOrder(working[i]);
+        pending += batch;
+        client.Flush();
+        while (pending > 0 && rejects == 0) {
+            if (client.Poll(1000, handler) < 0)
+                return 1;
+        }
+
+        if (rejects > 0) {
+            fprintf(stderr, "mock_exchange: orders for %s were rejected\n", symbol.c_str());
+            return 1;
+        }
+        if (interval_ns > 0) {
+            int64_t next = started + (round + 1) * interval_ns;
+            while (clock.NowNanos() < next)
+                ;
+        }
+    }
+
+    double seconds = (clock.NowNanos() - started) * 1e-9;
+    printf("%d rounds of %d messages in %.3fs (%.0f msgs/s)\n", rounds, 2 * batch + 1, seconds,
+           rounds * (2 * batch + 1) / seconds);
+    PrintLatency("ack", client.ack_latency());
+    PrintLatency("fill", client.fill_latency());
+    PrintLatency("cancel", client.cancel_latency());
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+        return Usage();
+    std::string command = argv[1];
+    if (command == "serve")
+        return Serve(argc, argv);
+    if (command == "bench")
+        return Bench(argc, argv);
+    return Usage();
+}
@@ -0,0 +1,189 @@
+"""
+Adaptive parameter search for vwap_replay: successive halving with TPE proposals
+
+Each bracket proposes a set of configurations, replays all of them on a short slice at the
+start of the range, keeps the best 1/eta by PnL and replays those on a slice eta times longer,
+until the survivors run on the full range. Losing regions are dropped after a fraction of the
+replay time a grid would spend on them.
+
+The first bracket samples uniformly from the search space. Later brackets draw from a
+Tree-structured Parzen Estimator fitted to the longest slice with enough results: observations
+are split into the best quarter and the rest, each dimension gets a kernel density for both
+groups, and the candidate with the highest good/bad density ratio is proposed. A third of
+every bracket stays uniformly random so the search keeps exploring.
+
+The search runs batches through a callable, evaluate(configs, start, end) -> [pnl or None], so
+it works on top of the sweep.py coordinator and its local or remote workers.
+
+Space syntax (one --space per parameter):
+    name=lo:hi            uniform float
+    name=lo:hi:log        log-uniform float
+    name=lo:hi:int        uniform integer
+    name=lo:hi:logint     log-uniform integer
+    name=a,b,c            choice
+"""
+
+import datetime
+import math
+import random
+
+TIME_FORMAT = '%Y%m%d %H:%M:%S'
+
+
+class Dimension:
+    def __init__(self, spec):
+        self.name, _, definition = spec.partition('=')
+        if ',' in definition or ':' not in definition:
+            self.choices = definition.split(',')
+            return
+        self.choices = None
+        parts = definition.split(':')
+        self.lo, self.hi = float(parts[0]), float(parts[1])
+        kind = parts[2] if len(parts) > 2 else ''
+        self.log = kind in ('log', 'logint')
+        self.integer = kind in ('int', 'logint')
+        if self.lo >= self.hi or (self.log and self.lo <= 0):
+            raise ValueError(f'bad range in {spec}')
+
+    # Continuous dimensions are sampled and modelled in [0, 1]
+    def to_unit(self, value):
+        value = float(value)
+        if self.log:
+            return (math.log(value) - math.log(self.lo)) / (math.log(self.hi) - math.log(self.lo))
+        return (value - self.lo) / (self.hi - self.lo)
+
+    def from_unit(self, unit):
+        unit = min(1.0, max(0.0, unit))
+        if self.log:
+            value = math.exp(math.log(self.lo) + unit * (math.log(self.hi) - math.log(self.lo)))
+        else:
+            value = self.lo + unit * (self.hi - self.lo)
+        return str(int(round(value))) if self.integer else f'{value:.6g}'
+
+    def sample(self, rng):
+        if self.choices:
+            return rng.choice(self.choices)
+        return self.from_unit(rng.random())
+
+
+class ParzenEstimator:
+    """Per-dimension kernel density over a group of observed configurations"""
+
+    def __init__(self, dimension, values):
+        self.dimension = dimension
+        if dimension.choices:
+            # Add-one smoothed frequencies
+            self.weights = {choice: 1.0 for choice in dimension.choices}
+            for value in values:
+                self.weights[value] += 1.0
+            total = sum(self.weights.values())
+            self.weights = {choice: weight / total for choice, weight in self.weights.items()}
+            return
+        self.points = [dimension.to_unit(value) for value in values]
+        # Scott's rule with a floor, so a tight cluster still leaves room to move
+        n = len(self.points)
+        mean = sum(self.points) / n
+        spread = math.sqrt(sum((p - mean) ** 2 for p in self.points) / n)
+        self.bandwidth = max(spread * n ** -0.2, 0.05)
+
+    def sample(self, rng):
+        if self.dimension.choices:
+            return rng.choices(list(self.weights), weights=list(self.weights.values()))[0]
+        return self.dimension.from_unit(rng.gauss(rng.choice(self.points), self.bandwidth))
+
+    def log_density(self, value):
+        if self.dimension.choices:
+            return math.log(self.weights[value])
+        x = self.dimension.to_unit(value)
+        density = sum(math.exp(-0.5 * ((x - p) / self.bandwidth) ** 2) for p in self.points)
+        density /= len(self.points) * self.bandwidth * math.sqrt(2.0 * math.pi)
+        # Mix in the uniform prior so no region ever has zero density
+        return math.log(density * len(self.points) / (len(self.points) + 1) + 1.0 / (len(self.points) + 1))
+
+
+class SearchSpace:
+    def __init__(self, specs, seed=None):
+        self.dimensions = [Dimension(spec) for spec in specs]
+        self.rng = random.Random(seed)
+
+    @property
+    def names(self):
+        return [d.name for d in self.dimensions]
+
+    def random_config(self):
+        return {d.name: d.sample(self.rng) for d in self.dimensions}
+
+    def propose(self, count, observations, seen, gamma=0.25, candidates=24, random_fraction=1.0 / 3):
+        """count new configs; observations is [(config, pnl)] on one slice, seen the keys already tried"""
+        proposals = []
+        model = None
+        if len(observations) >= len(self.dimensions) + 2:
+            ranked = sorted(observations, key=lambda item: item[1], reverse=True)
+            n_good = max(1, int(math.ceil(gamma * len(ranked))))
+            good = [config for config, _ in ranked[:n_good]]
+            bad = [config for config, _ in ranked[n_good:]] or good
+            model = [(ParzenEstimator(d, [c[d.name] for c in good]), ParzenEstimator(d, [c[d.name] for c in bad]))
+                     for d in self.dimensions]
+
+        attempts = 0
+        while len(proposals) < count and attempts < count * 100:
+            attempts += 1
+            if model is None or self.rng.random() < random_fraction:
+                config = self.random_config()
+            else:
+                best, best_score = None, -math.inf
+                for _ in range(candidates):
+                    candidate = {d.name: l.sample(self.rng) for d, (l, _) in zip(self.dimensions, model)}
+                    score = sum(l.log_density(candidate[d.name]) - g.log_density(candidate[d.name])
+                                for d, (l, g) in zip(self.dimensions, model))
+                    if score > best_score and config_key(candidate) not in seen:
+                        best, best_score = candidate, score
+                if best is None:
+                    continue
+                config = best
+            key = config_key(config)
+            if key not in seen:
+                seen.add(key)
+                proposals.append(config)
+        return proposals
+
+
+def config_key(config):
+    return tuple(sorted(config.items()))
+
+
+def slice_end(start, end, fraction):
+    """End of the first fraction of [start, end), in vwap_replay's time format"""
+    first = datetime.datetime.strptime(start if ' ' in start else start + ' 00:00:00', TIME_FORMAT)
+    last = datetime.datetime.strptime(end if ' ' in end else end + ' 00:00:00', TIME_FORMAT)
+    if fraction >= 1.0:
+        return end
+    return (first + (last - first) * fraction).strftime(TIME_FORMAT)
+
+
+def successive_halving(space, evaluate, start, end, brackets=3, configs=27, eta=3, rungs=3, log=print):
+    """Runs the search and returns [(config, pnl)] on the full range, best first"""
+    fractions = [float(eta) ** -(rungs - 1 - r) for r in range(rungs)]
+    observations = [[] for _ in range(rungs)]     # per rung: (config, pnl)
+    seen = set()
+    finalists = []
+    for bracket in range(brackets):
+        # Model the longest slice that has enough results to split into good and bad groups
+        history = next((o for o in reversed(observations) if len(o) >= len(space.dimensions) + 2), [])
+        survivors = space.propose(configs, history, seen)
+        for rung, fraction in enumerate(fractions):
+            if not survivors:
+                break
+            rung_end = slice_end(start, end, fraction)
+            pnls = evaluate(survivors, start, rung_end)
+            scored = [(config, pnl) for config, pnl in zip(survivors, pnls) if pnl is not None]
+            observations[rung].extend(scored)
+            scored.sort(key=lambda item: item[1], reverse=True)
+            log(f"[search] bracket {bracket} rung {rung}: {len(survivors)} configs to {rung_end}, "
+                f"best pnl={scored[0][1] if scored else 'n/a'}")
+            if rung == rungs - 1:
+                finalists.extend(scored)
+            else:
+                survivors = [config for config, _ in scored[:max(1, len(scored) // eta)]]
+    finalists.sort(key=lambda item: item[1], reverse=True)
+    return finalists
@@ -0,0 +1,310 @@
+// pnl_bootstrap: stationary block-bootstrap confidence intervals for backtest PnL metrics.
+//
+//   pnl_bootstrap <pnl.csv> [more.csv ...] [--resamples n] [--block mean_len] [--confidence 0.95]
+//                 [--threads n] [--seed s] [--csv out.csv]
+//
+// Reads Strategy Studio PnL files (Name,Time,Cumulative PnL) and derives the same interval series
+// hft_backtest_analysis_enhanced.py does: the PnL change per row, and the return as that change
+// over the previous |cumulative PnL|. Every run's cumulative PnL starts again from zero, so each
+// file is turned into its own series, its first row without a change like the report's, and the
+// series are joined in the order given. The point estimates match the report for one file: Sharpe is mean/std of returns * sqrt(252), max drawdown
+// is the deepest fall of cumulative PnL from its running max, win rate counts rows with a
+// positive change among those with a nonzero one, and profit factor is gains over losses.
+//
+// Each resample is a stationary bootstrap (Politis & Romano): blocks start at uniform rows and
+// have geometric lengths with the given mean, wrapping at the end, so serial correlation in the
+// PnL survives resampling. Resample i draws from its own generator seeded by (seed, i), so the
+// intervals are identical for any thread count. Threads take resamples off a shared counter;
+// the moment and profit sums run over four independent accumulator lanes the compiler
+// vectorizes, and the drawdown is a running-max scan.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum BootstrapMetric {
+    METRIC_SHARPE,
+    METRIC_MAX_DRAWDOWN,
+    METRIC_PROFIT_FACTOR,
+    METRIC_WIN_RATE,
+    METRIC_TOTAL_PNL,
+    METRIC_COUNT
+};
+
+static const char* kMetricNames[METRIC_COUNT] = { "sharpe", "max_drawdown", "profit_factor", "win_rate_pct", "total_pnl" };
+
+// xoshiro256** seeded through splitmix64
+class BootstrapRng {
+public:
+    BootstrapRng(uint64_t seed, uint64_t stream)
+    {
+        uint64_t x = seed ^ (stream * 0x9E3779B97F4A7C15ULL);
+        for (int i = 0; i < 4; ++i) {
+            x += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            s_[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t Next()
+    {
+        uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+        uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = Rotl(s_[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, 1)
+    double Uniform() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    size_t Below(size_t n) { return size_t((unsigned __int128)Next() * n >> 64); }
+
+private:
+    static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    uint64_t s_[4];
+};
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Appends the returns and changes of one file's cumulative PnL column. Row 0 has no change and
+// a zero return, as in the analysis script. False if the file cannot be read.
+static bool LoadIntervals(const char* path, std::vector<double>* returns, std::vector<double>* changes)
+{
+    FILE* in = fopen(path, "r");
+    if (!in)
+        return false;
+    char line[512];
+    bool header = true, first = true;
+    double previous = 0.0;
+    while (fgets(line, sizeof(line), in)) {
+        if (header) {
+            header = false;
+            continue;
+        }
+        const char* last_comma = strrchr(line, ',');
+        if (!last_comma)
+            continue;
+        double cumulative = atof(last_comma + 1);
+        double change = first ? 0.0 : cumulative - previous;
+        changes->push_back(change);
+        returns->push_back(!first && previous != 0.0 ? change / fabs(previous) : 0.0);
+        previous = cumulative;
+        first = false;
+    }
+    fclose(in);
+    return true;
+}
+
+// Metrics of the n rows of returns/changes, into out[METRIC_COUNT]
+static void ComputeMetrics(const double* returns, const double* changes, size_t n, double* out)
+{
+    const int kLanes = 4;
+    double sum[kLanes] = {}, sum_sq[kLanes] = {}, gains[kLanes] = {}, losses[kLanes] = {};
+    double wins[kLanes] = {}, decided[kLanes] = {};
+    size_t full = n - n % kLanes;
+    for (size_t i = 0; i < full; i += kLanes) {
+        for (int lane = 0; lane < kLanes; ++lane) {
+            double r = returns[i + lane];
+            double c = changes[i + lane];
+            sum[lane] += r;
+            sum_sq[lane] += r * r;
+            gains[lane] += c > 0.0 ? c : 0.0;
+            losses[lane] += c < 0.0 ? -c : 0.0;
+            wins[lane] += c > 0.0 ? 1.0 : 0.0;
+            decided[lane] += c != 0.0 ? 1.0 : 0.0;
+        }
+    }
+    for (size_t i = full; i < n; ++i) {
+        double r = returns[i];
+        double c = changes[i];
+        sum[0] += r;
+        sum_sq[0] += r * r;
+        gains[0] += c > 0.0 ? c : 0.0;
+        losses[0] += c < 0.0 ? -c : 0.0;
+        wins[0] += c > 0.0 ? 1.0 : 0.0;
+        decided[0] += c != 0.0 ? 1.0 : 0.0;
+    }
+    for (int lane = 1; lane < kLanes; ++lane) {
+        sum[0] += sum[lane];
+        sum_sq[0] += sum_sq[lane];
+        gains[0] += gains[lane];
+        losses[0] += losses[lane];
+        wins[0] += wins[lane];
+        decided[0] += decided[lane];
+    }
+
+    double mean = sum[0] / n;
+    double variance = n > 1 ? (sum_sq[0] - n * mean * mean) / (n - 1) : 0.0;
+    double std = variance > 0.0 ? sqrt(variance) : 0.0;
+    out[METRIC_SHARPE] = std > 0.0 ? mean / std * sqrt(252.0) : 0.0;
+    out[METRIC_PROFIT_FACTOR] = losses[0] > 0.0 ? gains[0] / losses[0] : 0.0;
+    out[METRIC_WIN_RATE] = decided[0] > 0.0 ? wins[0] / decided[0] * 100.0 : 0.0;
+    out[METRIC_TOTAL_PNL] = gains[0] - losses[0];
+
+    // Measured from the starting level, so a resample that falls from its first row counts the fall
+    double path = 0.0, peak = 0.0, drawdown = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        path += changes[i];
+        peak = std::max(peak, path);
+        drawdown = std::min(drawdown, path - peak);
+    }
+    out[METRIC_MAX_DRAWDOWN] = drawdown;
+}
+
+// One stationary bootstrap resample of the n rows into returns_out/changes_out
+static void Resample(const std::vector<double>& returns, const std::vector<double>& changes, double mean_block,
+                     BootstrapRng* rng, double* returns_out, double* changes_out)
+{
+    size_t n = returns.size();
+    double restart = 1.0 / mean_block;
+    size_t row = rng->Below(n);
+    for (size_t i = 0; i < n; ++i) {
+        returns_out[i] = returns[row];
+        changes_out[i] = changes[row];
+        row = rng->Uniform() < restart ? rng->Below(n) : (row + 1 == n ? 0 : row + 1);
+    }
+}
+
+static double Percentile(const std::vector<double>& sorted, double q)
+{
+    double position = q * (sorted.size() - 1);
+    size_t below = size_t(position);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (position - below) * (sorted[above] - sorted[below]);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: pnl_bootstrap <pnl.csv> [more.csv ...] [--resamples n] [--block mean_len] [--confidence 0.95]\n"
+                    "                     [--threads n] [--seed s] [--csv out.csv]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const char*> paths;
+    size_t resamples = 10000;
+    double mean_block = 0.0;
+    double confidence = 0.95;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = 1;
+    std::string csv_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--resamples" && i + 1 < argc) {
+            resamples = size_t(std::max(1, atoi(argv[++i])));
+        } else if (arg == "--block" && i + 1 < argc) {
+            mean_block = atof(argv[++i]);
+        } else if (arg == "--confidence" && i + 1 < argc) {
+            confidence = atof(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return Usage();
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty() || confidence <= 0.0 || confidence >= 1.0)
+        return Usage();
+
+    std::vector<double> returns, changes;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!LoadIntervals(paths[i], &returns, &changes)) {
+            fprintf(stderr, "pnl_bootstrap: could not read %s\n", paths[i]);
+            return 1;
+        }
+    }
+    if (changes.size() < 2) {
+        fprintf(stderr, "pnl_bootstrap: need at least two PnL rows\n");
+        return 1;
+    }
+
+    size_t n = changes.size();
+    if (mean_block <= 0.0)
+        mean_block = std::max(1.0, cbrt(double(n)));
+
+    double estimate[METRIC_COUNT];
+    ComputeMetrics(&returns[0], &changes[0], n, estimate);
+
+    double started = Seconds();
+    std::vector<double> samples(resamples * METRIC_COUNT);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    threads = unsigned(std::min<size_t>(threads, resamples));
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            std::vector<double> returns_out(n), changes_out(n);
+            for (size_t i; (i = next.fetch_add(1)) < resamples;) {
+                BootstrapRng rng(seed, i);
+                Resample(returns, changes, mean_block, &rng, &returns_out[0], &changes_out[0]);
+                ComputeMetrics(&returns_out[0], &changes_out[0], n, &samples[i * METRIC_COUNT]);
+            }
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    double finished = Seconds();
+
+    FILE* csv = NULL;
+    if (!csv_path.empty()) {
+        csv = fopen(csv_path.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "pnl_bootstrap: could not open %s\n", csv_path.c_str());
+            return 1;
+        }
+        fprintf(csv, "metric,estimate,mean,std_error,lower,upper,confidence\n");
+    }
+
+    printf("%zu intervals, %zu resamples, mean block %.1f, %zu threads: %.3fs\n", n, resamples, mean_block,
+           workers.size(), finished - started);
+    printf("%-14s %12s %12s %12s %12s %12s\n", "metric", "estimate", "boot_mean", "std_error", "lower", "upper");
+    double alpha = (1.0 - confidence) / 2.0;
+    std::vector<double> values(resamples);
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+        double sum = 0.0, sum_sq = 0.0;
+        for (size_t i = 0; i < resamples; ++i) {
+            values[i] = samples[i * METRIC_COUNT + m];
+            sum += values[i];
+            sum_sq += values[i] * values[i];
+        }
+        std::sort(values.begin(), values.end());
+        double mean = sum / resamples;
+        double std_error = resamples > 1 ? sqrt(std::max(0.0, (sum_sq - resamples * mean * mean) / (resamples - 1))) : 0.0;
+        double lower = Percentile(values, alpha);
+        double upper = Percentile(values, 1.0 - alpha);
+        printf("%-14s %12.4f %12.4f %12.4f %12.4f %12.4f\n", kMetricNames[m], estimate[m], mean, std_error, lower, upper);
+        if (csv)
+            fprintf(csv, "%s,%.10g,%.10g,%.10g,%.10g,%.10g,%g\n", kMetricNames[m], estimate[m], mean, std_error, lower,
+                    upper, confidence);
+    }
+    if (csv)
+        fclose(csv);
+    return 0;
+}
@@ -0,0 +1,275 @@
+"""
+Reconcile a Strategy Studio backtest against the offline replay
+
+Aligns the orders of a server run (BACK_*_order.csv, filled by FILL_SIMULATOR) with the orders
+vwap_replay wrote for the same capture and parameters (<prefix>_order.csv). Orders are matched
+on symbol, side and quantity within a time tolerance, and the report covers match rates, entry
+time skew, fill price differences and the divergences that look systematic.
+
+Both inputs are read row by row in time order and only orders inside the tolerance window are
+held in memory, so multi-day runs (several files per side, in date order) stream through in
+constant memory.
+
+Usage:
+    python reconcile.py --server BACK_..._order.csv [...] --replay replay_order.csv [...]
+                        [--tolerance-ms 1000] [--mismatches mismatches.csv]
+"""
+
+import argparse
+import csv
+import heapq
+import math
+import sys
+from collections import defaultdict, deque
+from datetime import datetime
+
+MONTHS = {m: i + 1 for i, m in enumerate(
+    ['Jan', 'Feb', 'Mar', 'Apr', 'May', 'Jun', 'Jul', 'Aug', 'Sep', 'Oct', 'Nov', 'Dec'])}
+
+
+def parse_time(text):
+    """Strategy Studio's '2019-Sep-13 13:30:01.012805' as seconds since the epoch (UTC)"""
+    date, clock = text.split(' ')
+    year, month, day = date.split('-')
+    hours, minutes, seconds = clock.split(':')
+    base = datetime(int(year), MONTHS[month], int(day)).toordinal() - 719163
+    return base * 86400.0 + int(hours) * 3600 + int(minutes) * 60 + float(seconds)
+
+
+def read_orders(paths, source):
+    """Yields one dict per order from a chain of order CSVs, in file order"""
+    for path in paths:
+        with open(path, newline='') as f:
+            for row in csv.DictReader(f):
+                yield {
+                    'source': source,
+                    'time': parse_time(row['EntryTime']),
+                    'entry_time': row['EntryTime'],
+                    'symbol': row['Symbol'],
+                    'side': row['Side'],
+                    'quantity': abs(int(float(row['Quantity']))),
+                    'filled': abs(int(float(row['FilledQty'] or 0))),
+                    'price': float(row['AvgFillPrice'] or 0.0),
+                    'state': row['State'],
+                    'order_id': row['OrderId'],
+                }
+
+
+class RunningStats:
+    """Count, mean, standard deviation, extremes and log2 magnitude buckets without keeping samples"""
+
+    def __init__(self):
+        self.count = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+        self.min = math.inf
+        self.max = -math.inf
+        self.buckets = defaultdict(int)   # signed power of two bound -> count
+
+    def add(self, value):
+        self.count += 1
+        delta = value - self.mean
+        self.mean += delta / self.count
+        self.m2 += delta * (value - self.mean)
+        self.min = min(self.min, value)
+        self.max = max(self.max, value)
+        # Bucket by the power of two at or above the magnitude, keeping the sign
+        bound = 0.0 if value == 0 else math.copysign(2.0 ** math.ceil(math.log2(abs(value))), value)
+        self.buckets[bound] += 1
+
+    @property
+    def std(self):
+        return math.sqrt(self.m2 / (self.count - 1)) if self.count > 1 else 0.0
+
+    def quantile(self, q):
+        """Bucket bound holding the q quantile, within a factor of two"""
+        if self.count == 0:
+            return 0.0
+        target = q * (self.count - 1) + 1
+        seen = 0
+        for bound in sorted(self.buckets):
+            seen += self.buckets[bound]
+            if seen >= target:
+                return bound
+        return self.max
+
+    def describe(self, scale=1.0, unit=''):
+        if self.count == 0:
+            return 'n=0'
+        return (f"n={self.count} mean={self.mean * scale:.3f}{unit} std={self.std * scale:.3f}{unit} "
+                f"min={self.min * scale:.3f}{unit} max={self.max * scale:.3f}{unit}")
+
+
+class Reconciler:
+    def __init__(self, tolerance, mismatch_writer=None):
+        self.tolerance = tolerance
+        self.pending = {'server': defaultdict(deque), 'replay': defaultdict(deque)}
+        self.mismatch_writer = mismatch_writer
+        self.matched = defaultdict(int)
+        self.unmatched = {'server': defaultdict(int), 'replay': defaultdict(int)}
+        self.unmatched_minutes = {'server': defaultdict(int), 'replay': defaultdict(int)}
+        self.state_mismatches = defaultdict(int)
+        self.skew = RunningStats()
+        self.skew_by_symbol = defaultdict(RunningStats)
+        self.slippage = RunningStats()
+        self.slippage_by_symbol = defaultdict(RunningStats)
+        self.price_differences = defaultdict(int)
+
+    @staticmethod
+    def key(order):
+        return (order['symbol'], order['side'], order['quantity'])
+
+    def add(self, order):
+        """Matches an order against the other side's pending orders, oldest first"""
+        self.expire(order['time'])
+        other = 'replay' if order['source'] == 'server' else 'server'
+        queue = self.pending[other][self.key(order)]
+        if queue:
+            self.match(order, queue.popleft())
+        else:
+            self.pending[order['source']][self.key(order)].append(order)
+
+    def expire(self, now):
+        for source in ('server', 'replay'):
+            for key, queue in self.pending[source].items():
+                while queue and queue[0]['time'] < now - self.tolerance:
+                    self.report_unmatched(queue.popleft())
+
+    def finish(self):
+        self.expire(math.inf)
+
+    def match(self, first, second):
+        server, replay = (first, second) if first['source'] == 'server' else (second, first)
+        symbol = server['symbol']
+        self.matched[symbol] += 1
+        skew = replay['time'] - server['time']
+        self.skew.add(skew)
+        self.skew_by_symbol[symbol].add(skew)
+
+        if server['state'] != replay['state'] or server['filled'] != replay['filled']:
+            self.state_mismatches[(server['state'], replay['state'])] += 1
+            self.write_mismatch('state', server, replay)
+        elif server['filled'] > 0:
+            # Positive when the replay filled worse than the server: paid more on buys, received less on sells
+            sign = 1.0 if server['side'] == 'BUY' else -1.0
+            slippage = sign * (replay['price'] - server['price'])
+            self.slippage.add(slippage)
+            self.slippage_by_symbol[symbol].add(slippage)
+            if abs(slippage) > 1e-9:
+                self.price_differences[symbol] += 1
+                self.write_mismatch('price', server, replay)
+
+    def report_unmatched(self, order):
+        self.unmatched[order['source']][order['symbol']] += 1
+        self.unmatched_minutes[order['source']][order['entry_time'][:17]] += 1
+        if order['source'] == 'server':
+            self.write_mismatch('server_only', order, None)
+        else:
+            self.write_mismatch('replay_only', None, order)
+
+    def write_mismatch(self, kind, server, replay):
+        if self.mismatch_writer is None:
+            return
+        row = [kind]
+        for order in (server, replay):
+            row += [order['entry_time'], order['symbol'], order['side'], order['quantity'], order['state'],
+                    order['price'], order['order_id']] if order else [''] * 7
+        self.mismatch_writer.writerow(row)
+
+    def print_report(self):
+        symbols = sorted(set(self.matched) | set(self.unmatched['server']) | set(self.unmatched['replay']))
+        total_matched = sum(self.matched.values())
+        total_server = total_matched + sum(self.unmatched['server'].values())
+        total_replay = total_matched + sum(self.unmatched['replay'].values())
+
+        print("=" * 80)
+        print("RECONCILIATION: SERVER vs REPLAY")
+        print("=" * 80)
+        print(f"Server orders: {total_server}  Replay orders: {total_replay}  Matched: {total_matched} "
+              f"(tolerance {self.tolerance * 1000:.0f}ms)")
+        print(f"Server match rate: {total_matched / total_server:.2%}" if total_server else "Server match rate: n/a")
+        print(f"Replay match rate: {total_matched / total_replay:.2%}" if total_replay else "Replay match rate: n/a")
+
+        print("\nPer symbol:")
+        print(f"  {'Symbol':<8} {'Matched':>8} {'SrvOnly':>8} {'RepOnly':>8} {'PriceDiff':>9} "
+              f"{'Skew mean':>12} {'Slip mean':>10}")
+        for symbol in symbols:
+            print(f"  {symbol:<8} {self.matched[symbol]:>8} {self.unmatched['server'][symbol]:>8} "
+                  f"{self.unmatched['replay'][symbol]:>8} {self.price_differences[symbol]:>9} "
+                  f"{self.skew_by_symbol[symbol].mean * 1000:>10.3f}ms {self.slippage_by_symbol[symbol].mean:>10.5f}")
+
+        print("\nEntry time skew (replay - server):")
+        print(f"  {self.skew.describe(1000.0, 'ms')}")
+        print(f"  p50<={self.skew.quantile(0.5) * 1000:.3f}ms p99<={self.skew.quantile(0.99) * 1000:.3f}ms")
+        print("Fill price difference per share (positive = replay filled worse):")
+        print(f"  {self.slippage.describe()}")
+        if self.state_mismatches:
+            print("State mismatches (server -> replay):")
+            for (server_state, replay_state), count in sorted(self.state_mismatches.items()):
+                print(f"  {server_state} -> {replay_state}: {count}")
+
+        self.print_divergences(symbols)
+
+    def print_divergences(self, symbols):
+        print("\nSystematic divergences:")
+        findings = []
+        if self.skew.count > 1 and abs(self.skew.mean) > 3 * self.skew.std / math.sqrt(self.skew.count):
+            findings.append(f"replay orders are consistently {'late' if self.skew.mean > 0 else 'early'} "
+                            f"by {abs(self.skew.mean) * 1000:.3f}ms on average")
+        for symbol in symbols:
+            stats = self.slippage_by_symbol[symbol]
+            if stats.count > 1 and abs(stats.mean) > 3 * stats.std / math.sqrt(stats.count) and abs(stats.mean) > 1e-9:
+                findings.append(f"{symbol}: replay fills {'worse' if stats.mean > 0 else 'better'} by "
+                                f"{abs(stats.mean):.5f}/share on average over {stats.count} fills")
+            for source in ('server', 'replay'):
+                count = self.unmatched[source][symbol]
+                total = self.matched[symbol] + count
+                if total and count / total > 0.05:
+                    findings.append(f"{symbol}: {count / total:.1%} of {source} orders have no counterpart")
+        for source in ('server', 'replay'):
+            minutes = self.unmatched_minutes[source]
+            if minutes:
+                worst = heapq.nlargest(3, minutes.items(), key=lambda item: item[1])
+                findings.append(f"{source}-only orders cluster in: " +
+                                ", ".join(f"{minute} ({count})" for minute, count in worst))
+        if not findings:
+            findings.append("none: matches, timing and prices agree within noise")
+        for finding in findings:
+            print(f"  - {finding}")
+
+
+def merge_by_time(*streams):
+    """Merges streams that are each in time order"""
+    return heapq.merge(*streams, key=lambda order: order['time'])
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Reconcile server backtest orders with offline replay orders')
+    parser.add_argument('--server', nargs='+', required=True, help='BACK_*_order.csv files, in date order')
+    parser.add_argument('--replay', nargs='+', required=True, help='replay *_order.csv files, in date order')
+    parser.add_argument('--tolerance-ms', type=float, default=1000.0,
+                        help='largest entry time difference still matched (default 1000)')
+    parser.add_argument('--mismatches', help='write every unmatched or differing order to this CSV')
+    args = parser.parse_args()
+
+    mismatch_file = None
+    writer = None
+    if args.mismatches:
+        mismatch_file = open(args.mismatches, 'w', newline='')
+        writer = csv.writer(mismatch_file)
+        columns = ['EntryTime', 'Symbol', 'Side', 'Quantity', 'State', 'AvgFillPrice', 'OrderId']
+        writer.writerow(['Kind'] + ['Server' + c for c in columns] + ['Replay' + c for c in columns])
+
+    reconciler = Reconciler(args.tolerance_ms / 1000.0, writer)
+    for order in merge_by_time(read_orders(args.server, 'server'), read_orders(args.replay, 'replay')):
+        reconciler.add(order)
+    reconciler.finish()
+    reconciler.print_report()
+
+    if mismatch_file:
+        mismatch_file.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
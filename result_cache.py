@@ -0,0 +1,223 @@
+"""
+Content-addressed cache of vwap_replay results
+
+A replay result is fully determined by the capture it reads, the effective parameters and the
+binary that computed it, so its key is the SHA-256 of:
+    - the content hashes of the archive day files the time range touches, and of their
+      tick_validate anomaly indexes (<yyyymmdd>.anomalies) where present
+    - the time range and symbol list
+    - the parameters as vwap_replay itself prints them (--print-params), so defaults, spelling
+      like "2" vs "2.0" and argument order all map to the same key
+    - the GNU build ID the linker embeds in vwap_replay (VWAP.so/OFI.so carry one too)
+
+Entries are JSON files under <root>/<key[:2]>/<key>.json, where root is $VWAP_RESULT_CACHE or
+.result_cache/ next to this script. File hashes are remembered by path, size and mtime, so a
+capture is only read again after it changes.
+
+Usage:
+    python result_cache.py replay archive/ "20190913 13:30:00" "20190913 20:00:00" --set entry_threshold_bps=2
+    python result_cache.py key archive/ 20190913 20190914 --set max_inventory=10
+"""
+
+import argparse
+import datetime
+import hashlib
+import json
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+DEFAULT_ROOT = Path(os.environ.get('VWAP_RESULT_CACHE', Path(__file__).resolve().parent / '.result_cache'))
+DEFAULT_REPLAY = str(Path(__file__).resolve().parent / 'vwap_replay')
+
+
+def elf_build_id(path):
+    """Hex GNU build ID of an ELF64 little-endian file, or None"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF' or data[4] != 2 or data[5] != 1:
+        return None
+    phoff, = struct.unpack_from('<Q', data, 0x20)
+    phentsize, phnum = struct.unpack_from('<HH', data, 0x36)
+    for i in range(phnum):
+        p_type, _, p_offset, _, _, p_filesz = struct.unpack_from('<IIQQQQ', data, phoff + i * phentsize)
+        if p_type != 4:              # PT_NOTE
+            continue
+        offset, end = p_offset, p_offset + p_filesz
+        while offset + 12 <= end:
+            namesz, descsz, note_type = struct.unpack_from('<III', data, offset)
+            name_start = offset + 12
+            desc_start = name_start + ((namesz + 3) & ~3)
+            if note_type == 3 and data[name_start:name_start + namesz] == b'GNU\x00':    # NT_GNU_BUILD_ID
+                return data[desc_start:desc_start + descsz].hex()
+            offset = desc_start + ((descsz + 3) & ~3)
+    return None
+
+
+def build_identity(path):
+    """Build ID, falling back to a hash of the whole binary when it was linked without one"""
+    build_id = elf_build_id(path)
+    if build_id:
+        return build_id
+    with open(path, 'rb') as f:
+        return 'sha256:' + hashlib.sha256(f.read()).hexdigest()
+
+
+def parse_day(text):
+    """'yyyymmdd[ hh:mm:ss[.f]]' -> (date string, True if the time is exactly midnight)"""
+    day, _, clock = text.partition(' ')
+    midnight = not clock or all(c in '0:.' for c in clock)
+    return day, midnight
+
+
+def days_in_range(archive, start, end):
+    """Day files a [start, end) replay reads, the same ones TickArchiveCursor visits"""
+    first, _ = parse_day(start)
+    last, end_at_midnight = parse_day(end)
+    days = []
+    for path in sorted(Path(archive).glob('[0-9]' * 8 + '.tpk')):
+        day = path.stem
+        if first <= day and (day < last or (day == last and not end_at_midnight)):
+            days.append(path)
+    return days
+
+
+def capture_files(archive, start, end):
+    """Day files of the range plus the anomaly indexes vwap_replay loads alongside them"""
+    files = []
+    for path in days_in_range(archive, start, end):
+        files.append(path)
+        anomalies = path.with_suffix('.anomalies')
+        if anomalies.exists():
+            files.append(anomalies)
+    return files
+
+
+class ResultCache:
+    def __init__(self, root=DEFAULT_ROOT):
+        self.root = Path(root)
+        self.root.mkdir(parents=True, exist_ok=True)
+        self.file_hashes_path = self.root / 'file_hashes.json'
+        try:
+            self.file_hashes = json.loads(self.file_hashes_path.read_text())
+        except (OSError, ValueError):
+            self.file_hashes = {}
+
+    def file_hash(self, path):
+        path = Path(path).resolve()
+        stat = path.stat()
+        known = self.file_hashes.get(str(path))
+        if known and known['size'] == stat.st_size and known['mtime_ns'] == stat.st_mtime_ns:
+            return known['sha256']
+        digest = hashlib.sha256()
+        with open(path, 'rb') as f:
+            for chunk in iter(lambda: f.read(1 << 20), b''):
+                digest.update(chunk)
+        self.file_hashes[str(path)] = {'size': stat.st_size, 'mtime_ns': stat.st_mtime_ns, 'sha256': digest.hexdigest()}
+        self.write_atomic(self.file_hashes_path, json.dumps(self.file_hashes))
+        return digest.hexdigest()
+
+    def replay_key(self, replay, archive, start, end, symbols, params):
+        """Key of a vwap_replay run; params maps names to values as given to --set"""
+        args = [replay, str(archive), start, end] + set_args(params) + ['--print-params']
+        printed = subprocess.run(args, capture_output=True, text=True, check=True).stdout
+        identity = {
+            'capture': {path.name: self.file_hash(path) for path in capture_files(archive, start, end)},
+            'range': [start, end],
+            'symbols': sorted(symbols or []),
+            'params': sorted(printed.split()),
+            'build': build_identity(replay),
+        }
+        return hashlib.sha256(json.dumps(identity, sort_keys=True).encode()).hexdigest()
+
+    def entry_path(self, key):
+        return self.root / key[:2] / f'{key}.json'
+
+    def get(self, key):
+        try:
+            return json.loads(self.entry_path(key).read_text())
+        except (OSError, ValueError):
+            return None
+
+    def put(self, key, value):
+        path = self.entry_path(key)
+        path.parent.mkdir(exist_ok=True)
+        self.write_atomic(path, json.dumps(value))
+
+    @staticmethod
+    def write_atomic(path, text):
+        """Concurrent workers may write the same entry; rename keeps readers from seeing a partial file"""
+        fd, temp = tempfile.mkstemp(dir=path.parent, prefix='.tmp')
+        with os.fdopen(fd, 'w') as f:
+            f.write(text)
+        os.replace(temp, path)
+
+
+def set_args(params):
+    args = []
+    for name, value in sorted(params.items()):
+        args += ['--set', f'{name}={value}']
+    return args
+
+
+def parse_replay_summary(output):
+    """Totals line of vwap_replay: events=... trades=... orders=... pnl=..."""
+    match = re.search(r'events=(\d+) trades=(\d+) orders=(\d+) pnl=(-?[\d.]+)', output)
+    if not match:
+        return None
+    return {'trades': int(match.group(2)), 'orders': int(match.group(3)), 'pnl': float(match.group(4))}
+
+
+def run_replay(replay, archive, start, end, symbols, params, cache=None):
+    """Runs vwap_replay unless the cache has the result. Returns {'ok', 'cached', 'summary', 'output', 'error'}."""
+    key = cache.replay_key(replay, archive, start, end, symbols, params) if cache else None
+    if key:
+        hit = cache.get(key)
+        if hit:
+            return dict(hit, cached=True)
+
+    args = [replay, str(archive), start, end] + (['--symbols', ','.join(symbols)] if symbols else []) + set_args(params)
+    completed = subprocess.run(args, capture_output=True, text=True)
+    summary = parse_replay_summary(completed.stdout)
+    result = {'ok': completed.returncode == 0 and summary is not None, 'cached': False, 'summary': summary,
+              'output': completed.stdout,
+              'error': completed.stderr.strip()[-200:] or f'exit code {completed.returncode}'}
+    if key and result['ok']:
+        cache.put(key, dict(result, key=key, created=datetime.datetime.utcnow().isoformat()))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Memoized vwap_replay runs')
+    parser.add_argument('command', choices=['replay', 'key'])
+    parser.add_argument('archive')
+    parser.add_argument('start')
+    parser.add_argument('end')
+    parser.add_argument('--symbols', help='comma separated symbols, default all')
+    parser.add_argument('--set', action='append', default=[], help='name=value (repeatable)')
+    parser.add_argument('--replay', default=DEFAULT_REPLAY)
+    parser.add_argument('--cache', default=str(DEFAULT_ROOT))
+    args = parser.parse_args()
+
+    params = dict(assignment.split('=', 1) for assignment in args.set)
+    symbols = args.symbols.split(',') if args.symbols else []
+    cache = ResultCache(args.cache)
+    if args.command == 'key':
+        print(cache.replay_key(args.replay, args.archive, args.start, args.end, symbols, params))
+        return 0
+
+    result = run_replay(args.replay, args.archive, args.start, args.end, symbols, params, cache)
+    if not result['ok']:
+        print(result['error'], file=sys.stderr)
+        return 1
+    sys.stdout.write(result['output'])
+    print(f"cached={'yes' if result['cached'] else 'no'}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
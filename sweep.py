@@ -0,0 +1,418 @@
+"""
+Parameter sweep coordinator for vwap_replay
+
+A coordinator holds the grid of replay jobs and hands them to worker processes over a
+newline-delimited JSON protocol on TCP. Workers pull a job whenever they are idle, so fast
+workers take more of the grid. Once the queue is empty, an idle worker steals a duplicate of
+the longest-running job if it has run longer than the median replay of its batch, and the first
+result to arrive wins. Each job gets at most one duplicate, and nothing is stolen until a few
+jobs of the batch have been replayed. A job whose worker disconnects or exceeds --job-timeout
+goes back on the queue, and a job that fails more than --retries times is recorded as failed.
+
+Workers run vwap_replay against their own node's copy of the tick archive. The replay maps
+the compressed day files read-only, so all workers on a node share one copy in the page
+cache. Results are appended to Results/sweeps/<name>.csv as they arrive.
+
+Each worker looks a job up in its node's result cache (result_cache.py) before running it, so
+re-running a sweep, or growing its grid by one value, only replays the points whose capture,
+parameters or vwap_replay build changed. Cache hits are recorded with status "cached".
+
+Usage:
+    # Everything on this machine, 4 workers
+    python sweep.py run --name thresholds --workers 4 --archive archive/ \\
+        --start "20190913 13:30:00" --end "20190913 20:00:00" \\
+        --grid entry_threshold_bps=0.5,1,2,4 --grid max_inventory=5,10
+
+    # Same sweep across hosts: one coordinator, workers started on every node
+    python sweep.py coordinator --name thresholds --listen 0.0.0.0:9200 --start ... --end ... --grid ...
+    python sweep.py worker --connect coordinator-host:9200 --archive /data/archive --workers 8
+
+    # Adaptive search instead of a grid (param_search.py), on the same workers
+    python sweep.py search --name tuned --workers 4 --archive archive/ --start ... --end ... \\
+        --space entry_threshold_bps=0.25:8:log --space max_inventory=1:20:int --space position_size=1,2
+"""
+
+import argparse
+import csv
+import itertools
+import json
+import os
+import socket
+import socketserver
+import subprocess
+import sys
+import threading
+import time
+from pathlib import Path
+
+from param_search import SearchSpace, successive_halving
+from result_cache import DEFAULT_REPLAY, DEFAULT_ROOT, ResultCache, run_replay
+
+RESULTS_DIR = Path(__file__).resolve().parent / 'Results' / 'sweeps'
+RESULT_COLUMNS = ['job', 'start', 'end', 'status', 'attempts', 'worker', 'seconds', 'pnl', 'orders', 'trades', 'error']
+# Replays of a batch that must have finished before its median marks a straggler
+STEAL_MIN_DURATIONS = 3
+
+
+def send_message(stream, message):
+    stream.write((json.dumps(message) + '\n').encode())
+    stream.flush()
+
+
+def read_message(stream):
+    line = stream.readline()
+    if not line:
+        return None
+    return json.loads(line)
+
+
+def parse_grid(specs):
+    """['a=1,2', 'b=3'] -> [{'a': '1', 'b': '3'}, {'a': '2', 'b': '3'}]"""
+    names, values = [], []
+    for spec in specs:
+        name, _, listed = spec.partition('=')
+        names.append(name)
+        values.append(listed.split(','))
+    return [dict(zip(names, combination)) for combination in itertools.product(*values)]
+
+
+class Job:
+    def __init__(self, job_id, batch, params, start, end):
+        self.job_id = job_id
+        self.batch = batch
+        self.params = params
+        self.start = start
+        self.end = end
+        self.status = None
+        self.summary = None
+        self.attempts = 0
+        self.failures = 0
+        self.running = {}            # worker name -> start time
+        self.done = False
+
+
+class SweepState:
+    """Job queue shared by the connection handler threads.
+
+    Jobs arrive in batches through submit(). idle is set whenever every submitted job has a
+    result, and finished once close() says no more batches are coming, which releases the workers.
+    """
+
+    def __init__(self, name, param_names, symbols, retries, job_timeout):
+        self.name = name
+        self.jobs = []
+        self.symbols = symbols
+        self.retries = retries
+        self.job_timeout = job_timeout
+        self.queue = []
+        self.remaining = 0
+        self.lock = threading.Lock()
+        self.idle = threading.Event()
+        self.idle.set()
+        self.finished = threading.Event()
+        self.batches = 0
+        self.durations = {}          # batch -> seconds of its replays, cache hits left out
+
+        RESULTS_DIR.mkdir(parents=True, exist_ok=True)
+        self.results_path = RESULTS_DIR / f'{name}.csv'
+        self.param_names = sorted(param_names)
+        self.results_file = open(self.results_path, 'w', newline='')
+        self.writer = csv.writer(self.results_file)
+        self.writer.writerow(self.param_names + RESULT_COLUMNS)
+
+    def submit(self, batch, start, end):
+        """Queues one job per params dict over [start, end) and returns the jobs"""
+        with self.lock:
+            batch_id = self.batches
+            self.batches += 1
+            jobs = [Job(len(self.jobs) + i, batch_id, params, start, end) for i, params in enumerate(batch)]
+            self.jobs.extend(jobs)
+            self.queue.extend(jobs)
+            self.remaining += len(jobs)
+            if self.remaining:
+                self.idle.clear()
+            return jobs
+
+    def run_batch(self, batch, start, end):
+        jobs = self.submit(batch, start, end)
+        self.idle.wait()
+        return jobs
+
+    def close(self):
+        self.results_file.close()
+        self.finished.set()
+
+    def next_job(self, worker):
+        """A queued job, a stolen duplicate of a straggler, or None when nothing is left to hand out"""
+        with self.lock:
+            self.requeue_timed_out()
+            while self.queue:
+                job = self.queue.pop(0)
+                if not job.done:
+                    return self.start(job, worker)
+            now = time.time()
+            candidates = [job for job in self.jobs if not job.done and len(job.running) == 1 and worker not in job.running]
+            if candidates:
+                # Steal the job that has been running longest, if it is slower than a typical job of
+                # its batch; batches differ in range, so one batch's jobs say nothing about another's
+                job = max(candidates, key=lambda j: now - min(j.running.values()))
+                durations = sorted(self.durations.get(job.batch, []))
+                if len(durations) >= STEAL_MIN_DURATIONS and now - min(job.running.values()) > durations[len(durations) // 2]:
+                    return self.start(job, worker)
+            return None
+
+    def start(self, job, worker):
+        job.attempts += 1
+        job.running[worker] = time.time()
+        return {'type': 'job', 'job': job.job_id, 'params': job.params, 'start': job.start, 'end': job.end,
+                'symbols': self.symbols}
+
+    def requeue_timed_out(self):
+        if not self.job_timeout:
+            return
+        now = time.time()
+        for job in self.jobs:
+            for worker, started in list(job.running.items()):
+                if now - started > self.job_timeout:
+                    del job.running[worker]
+                    self.fail(job, worker, f'timed out after {self.job_timeout}s')
+
+    def result(self, worker, message):
+        with self.lock:
+            job = self.jobs[message['job']]
+            started = job.running.pop(worker, None)
+            if job.done or started is None:
+                return
+            if message['ok']:
+                job.done = True
+                seconds = time.time() - started
+                summary = message['summary']
+                job.summary = summary
+                status = 'cached' if message.get('cached') else 'ok'
+                if status == 'ok':
+                    self.durations.setdefault(job.batch, []).append(seconds)
+                self.record(job, status, worker, seconds, summary['pnl'], summary['orders'], summary['trades'], '')
+            else:
+                self.fail(job, worker, message.get('error', ''))
+
+    def lost(self, worker):
+        """Worker disconnected: its running jobs count as failed attempts"""
+        with self.lock:
+            for job in self.jobs:
+                if worker in job.running:
+                    del job.running[worker]
+                    self.fail(job, worker, 'worker disconnected')
+
+    def fail(self, job, worker, error):
+        if job.done:
+            return
+        job.failures += 1
+        if job.failures > self.retries:
+            job.done = True
+            self.record(job, 'failed', worker, 0.0, '', '', '', error)
+        elif not job.running and job not in self.queue:
+            self.queue.append(job)
+        print(f"[sweep] job {job.job_id} failed on {worker}: {error}", file=sys.stderr)
+
+    def record(self, job, status, worker, seconds, pnl, orders, trades, error):
+        job.status = status
+        row = [job.params.get(name, '') for name in self.param_names]
+        self.writer.writerow(row + [job.job_id, job.start, job.end, status, job.attempts, worker, f'{seconds:.3f}',
+                                    pnl, orders, trades, error])
+        self.results_file.flush()
+        self.remaining -= 1
+        print(f"[sweep] job {job.job_id} {status} ({len(self.jobs) - self.remaining}/{len(self.jobs)}) "
+              f"{job.params} pnl={pnl}")
+        if self.remaining == 0:
+            self.idle.set()
+
+
+class CoordinatorHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        state = self.server.state
+        hello = read_message(self.rfile)
+        if not hello or hello.get('type') != 'hello':
+            return
+        worker = f"{hello['worker']}@{self.client_address[0]}:{self.client_address[1]}"
+        try:
+            while True:
+                message = read_message(self.rfile)
+                if message is None:
+                    break
+                if message['type'] == 'result':
+                    state.result(worker, message)
+                elif message['type'] == 'request':
+                    if state.finished.is_set():
+                        send_message(self.wfile, {'type': 'done'})
+                        break
+                    job = state.next_job(worker)
+                    send_message(self.wfile, job or {'type': 'wait', 'seconds': 0.5})
+        except (ConnectionError, ValueError):
+            pass
+        finally:
+            state.lost(worker)
+
+
+class Coordinator(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+    def __init__(self, address, state):
+        super().__init__(address, CoordinatorHandler)
+        self.state = state
+
+
+def run_worker(address, archive, replay, name, cache_root):
+    """Pulls jobs until the coordinator says done. Returns when the sweep is finished or the coordinator is gone."""
+    host, port = address
+    for _ in range(50):
+        try:
+            connection = socket.create_connection((host, port))
+            break
+        except ConnectionRefusedError:
+            time.sleep(0.1)
+    else:
+        print(f"[worker {name}] could not connect to {host}:{port}", file=sys.stderr)
+        return 1
+    stream = connection.makefile('rwb')
+    cache = ResultCache(cache_root) if cache_root else None
+    send_message(stream, {'type': 'hello', 'worker': name})
+    while True:
+        send_message(stream, {'type': 'request'})
+        message = read_message(stream)
+        if message is None or message['type'] == 'done':
+            return 0
+        if message['type'] == 'wait':
+            time.sleep(message['seconds'])
+            continue
+
+        result = {'type': 'result', 'job': message['job']}
+        try:
+            replayed = run_replay(replay, archive, message['start'], message['end'], message['symbols'],
+                                  message['params'], cache)
+            result.update(ok=replayed['ok'], cached=replayed['cached'], summary=replayed['summary'],
+                          error=replayed['error'])
+        except (OSError, subprocess.CalledProcessError) as e:
+            result.update(ok=False, error=str(e))
+        send_message(stream, result)
+
+
+def spawn_workers(address, archive, replay, count, cache_root):
+    script = str(Path(__file__).resolve())
+    host, port = address
+    cache_args = ['--cache', cache_root] if cache_root else ['--no-cache']
+    return [subprocess.Popen([sys.executable, script, 'worker', '--connect', f'{host}:{port}', '--archive', archive,
+                              '--replay', replay, '--name', f'{socket.gethostname()}-{i}'] + cache_args)
+            for i in range(count)]
+
+
+def parse_address(text):
+    host, _, port = text.rpartition(':')
+    return host or '127.0.0.1', int(port)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Distribute vwap_replay parameter sweeps across worker processes')
+    commands = parser.add_subparsers(dest='command', required=True)
+
+    def add_sweep_args(p):
+        p.add_argument('--name', required=True, help='results go to Results/sweeps/<name>.csv')
+        p.add_argument('--start', required=True, help='replay start, "yyyymmdd[ hh:mm:ss]"')
+        p.add_argument('--end', required=True, help='replay end, "yyyymmdd[ hh:mm:ss]"')
+        p.add_argument('--symbols', help='comma separated symbols, default all')
+        p.add_argument('--retries', type=int, default=2, help='failed attempts allowed per job (default 2)')
+        p.add_argument('--job-timeout', type=float, default=0.0, help='seconds before a running job is reassigned')
+
+    def add_cache_args(p):
+        p.add_argument('--cache', default=str(DEFAULT_ROOT), help="this node's result cache directory")
+        p.add_argument('--no-cache', action='store_true', help='always run vwap_replay')
+
+    run = commands.add_parser('run', help='coordinator plus local workers')
+    add_sweep_args(run)
+    run.add_argument('--grid', action='append', default=[], help='name=v1,v2,... (repeatable)')
+    run.add_argument('--workers', type=int, default=os.cpu_count())
+    run.add_argument('--archive', required=True)
+    run.add_argument('--replay', default=DEFAULT_REPLAY)
+    run.add_argument('--listen', default='127.0.0.1:0')
+    add_cache_args(run)
+
+    coordinator = commands.add_parser('coordinator', help='serve a sweep to remote workers')
+    add_sweep_args(coordinator)
+    coordinator.add_argument('--grid', action='append', default=[], help='name=v1,v2,... (repeatable)')
+    coordinator.add_argument('--listen', default='0.0.0.0:9200')
+
+    search = commands.add_parser('search', help='successive halving with TPE proposals (see param_search.py)')
+    add_sweep_args(search)
+    search.add_argument('--space', action='append', default=[], help='name=lo:hi[:log|int|logint] or name=a,b,c')
+    search.add_argument('--brackets', type=int, default=3, help='propose/halve rounds (default 3)')
+    search.add_argument('--configs', type=int, default=27, help='configs proposed per bracket (default 27)')
+    search.add_argument('--eta', type=int, default=3, help='keep 1/eta per rung, slices grow by eta (default 3)')
+    search.add_argument('--rungs', type=int, default=3, help='slice lengths per bracket, the last is the full range')
+    search.add_argument('--seed', type=int, help='proposal RNG seed')
+    search.add_argument('--workers', type=int, default=os.cpu_count(), help='local workers, 0 for remote only')
+    search.add_argument('--archive', help='tick archive for local workers')
+    search.add_argument('--replay', default=DEFAULT_REPLAY)
+    search.add_argument('--listen', default='127.0.0.1:0')
+    add_cache_args(search)
+
+    worker = commands.add_parser('worker', help='pull jobs from a coordinator')
+    worker.add_argument('--connect', required=True, help='coordinator host:port')
+    worker.add_argument('--archive', required=True, help="this node's tick archive directory")
+    worker.add_argument('--replay', default=DEFAULT_REPLAY)
+    worker.add_argument('--workers', type=int, default=1, help='worker processes to start on this node')
+    worker.add_argument('--name', default=socket.gethostname())
+    add_cache_args(worker)
+
+    args = parser.parse_args()
+
+    cache_root = None if getattr(args, 'no_cache', True) else args.cache
+    if args.command == 'worker':
+        if args.workers == 1:
+            return run_worker(parse_address(args.connect), args.archive, args.replay, args.name, cache_root)
+        processes = spawn_workers(parse_address(args.connect), args.archive, args.replay, args.workers, cache_root)
+        return max(process.wait() for process in processes)
+
+    if args.command == 'search':
+        space = SearchSpace(args.space, args.seed)
+        param_names = space.names
+        if args.workers and not args.archive:
+            parser.error('--archive is required for local workers')
+    else:
+        grid = parse_grid(args.grid)
+        param_names = {key for params in grid for key in params}
+
+    symbols = args.symbols.split(',') if args.symbols else []
+    state = SweepState(args.name, param_names, symbols, args.retries, args.job_timeout)
+    server = Coordinator(parse_address(args.listen), state)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    address = server.server_address
+    print(f"[sweep] coordinator on {address[0]}:{address[1]}")
+
+    processes = []
+    if args.command != 'coordinator' and args.workers:
+        processes = spawn_workers(address, args.archive, args.replay, args.workers, cache_root)
+
+    if args.command == 'search':
+        def evaluate(configs, start, end):
+            jobs = state.run_batch(configs, start, end)
+            return [job.summary['pnl'] if job.summary else None for job in jobs]
+
+        finalists = successive_halving(space, evaluate, args.start, args.end, args.brackets, args.configs,
+                                       args.eta, args.rungs)
+        print(f"[search] {len(state.jobs)} replays, best on the full range:")
+        for config, pnl in finalists[:5]:
+            print(f"  pnl={pnl} {config}")
+    else:
+        print(f"[sweep] {len(grid)} jobs")
+        state.run_batch(grid, args.start, args.end)
+
+    state.close()
+    for process in processes:
+        process.wait()
+    server.shutdown()
+    print(f"[sweep] results in {state.results_path}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,166 @@
+"""
+Tick store loader
+Maps binary tick store files written by the strategies (see TickStore.h) as numpy
+structured arrays without copying, so notebooks can work on exactly what the strategy saw.
+"""
+
+import numpy as np
+from pathlib import Path
+
+TICK_STORE_MAGIC = b'SSTICK1'
+TICK_STORE_VERSION = 1
+
+TICK_RECORD_TYPE_FEATURE = 1
+TICK_RECORD_TYPE_MARKET = 2
+TICK_RECORD_TYPE_ANOMALY = 3
+TICK_RECORD_TYPE_DEPTH = 4
+
+TICK_STORE_FLAG_COMPRESSED = 1
+
+TICK_EVENT_TYPE_TRADE = 1
+TICK_EVENT_TYPE_QUOTE = 2
+
+HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('record_type', '<u4'),
+    ('record_size', '<u4'),
+    ('flags', '<u4'),
+    ('created_ns', '<i8'),
+])
+
+# Keep in sync with FeatureRecord in TickStore.h
+FEATURE_DTYPE = np.dtype([
+    ('timestamp_ns', '<i8'),
+    ('symbol', 'S8'),
+    ('event_type', 'u1'),
+    ('vwap_ready', 'u1'),
+    ('reserved', '<u2'),
+    ('trade_size', '<i4'),
+    ('trade_price', '<f8'),
+    ('bid', '<f8'),
+    ('ask', '<f8'),
+    ('bid_size', '<i4'),
+    ('ask_size', '<i4'),
+    ('mid', '<f8'),
+    ('spread', '<f8'),
+    ('vwap', '<f8'),
+    ('deviation_bps', '<f8'),
+    ('ofi', '<f8'),
+    ('position', '<i4'),
+    ('window_trades', '<i4'),
+    ('window_volume', '<i8'),
+])
+
+# Keep in sync with MarketEventRecord in TickStore.h
+MARKET_DTYPE = np.dtype([
+    ('timestamp_ns', '<i8'),
+    ('symbol', 'S8'),
+    ('event_type', 'u1'),
+    ('reserved', 'u1', (3,)),
+    ('trade_size', '<i4'),
+    ('trade_price', '<f8'),
+    ('bid', '<f8'),
+    ('ask', '<f8'),
+    ('bid_size', '<i4'),
+    ('ask_size', '<i4'),
+])
+
+# Keep in sync with AnomalyRecord and TickAnomalyKind in TickStore.h
+ANOMALY_DTYPE = np.dtype([
+    ('start_ns', '<i8'),
+    ('end_ns', '<i8'),
+    ('symbol', 'S8'),
+    ('kind', '<u4'),
+    ('events', '<u4'),
+])
+
+ANOMALY_KINDS = {1: 'crossed', 2: 'locked', 3: 'zero_price', 4: 'stale_quote', 5: 'constant_size',
+                 6: 'time_regression', 7: 'gap', 8: 'duplicate'}
+
+# Keep in sync with DepthDeltaRecord, TickDepthSide and TickDepthAction in TickStore.h
+DEPTH_DTYPE = np.dtype([
+    ('timestamp_ns', '<i8'),
+    ('symbol', 'S8'),
+    ('price', '<f8'),
+    ('size', '<i4'),
+    ('side', 'u1'),
+    ('level', 'u1'),
+    ('action', 'u1'),
+    ('flags', 'u1'),
+])
+
+DEPTH_SIDES = {0: 'bid', 1: 'ask'}
+DEPTH_ACTIONS = {1: 'add', 2: 'modify', 3: 'delete'}
+
+RECORD_DTYPES = {
+    TICK_RECORD_TYPE_FEATURE: FEATURE_DTYPE,
+    TICK_RECORD_TYPE_MARKET: MARKET_DTYPE,
+    TICK_RECORD_TYPE_ANOMALY: ANOMALY_DTYPE,
+    TICK_RECORD_TYPE_DEPTH: DEPTH_DTYPE,
+}
+
+
+def read_header(path):
+    """Read and validate the header of a tick store file"""
+    header = np.fromfile(path, dtype=HEADER_DTYPE, count=1)
+    if len(header) != 1 or header['magic'][0] != TICK_STORE_MAGIC:
+        raise ValueError(f"{path} is not a tick store file")
+    header = header[0]
+    if header['version'] != TICK_STORE_VERSION:
+        raise ValueError(f"{path}: unsupported tick store version {header['version']}")
+    record_type = int(header['record_type'])
+    if record_type not in RECORD_DTYPES:
+        raise ValueError(f"{path}: unknown record type {record_type}")
+    if header['record_size'] != RECORD_DTYPES[record_type].itemsize:
+        raise ValueError(f"{path}: record size {header['record_size']} does not match "
+                         f"{RECORD_DTYPES[record_type].itemsize}, rebuild the loader")
+    return header
+
+
+def open_store(path):
+    """
+    Memory-map a tick store file as a read-only structured array (zero copy)
+
+    Args:
+        path: Path to a .bin file written by TickStoreWriter
+
+    Returns:
+        numpy.memmap with one element per record
+    """
+    header = read_header(path)
+    if header['flags'] & TICK_STORE_FLAG_COMPRESSED:
+        raise ValueError(f"{path} is compressed, run 'tickpack unpack' first")
+    dtype = RECORD_DTYPES[int(header['record_type'])]
+    payload = Path(path).stat().st_size - HEADER_DTYPE.itemsize
+    count = payload // dtype.itemsize  # a trailing partial record means the writer is still running
+    if count == 0:
+        return np.zeros(0, dtype=dtype)
+    return np.memmap(path, dtype=dtype, mode='r', offset=HEADER_DTYPE.itemsize, shape=(count,))
+
+
+def to_dataframe(records):
+    """Convert records to a pandas DataFrame with decoded symbols and timestamps (copies)"""
+    import pandas as pd
+    names = [name for name in records.dtype.names if name != 'reserved']
+    df = pd.DataFrame({name: np.asarray(records[name]) for name in names})
+    df['symbol'] = df['symbol'].str.decode('ascii')
+    if records.dtype == ANOMALY_DTYPE:
+        df['kind'] = df['kind'].map(ANOMALY_KINDS)
+        df['start'] = pd.to_datetime(df['start_ns'], unit='ns')
+        df['end'] = pd.to_datetime(df['end_ns'], unit='ns')
+        return df
+    if records.dtype == DEPTH_DTYPE:
+        df['side'] = df['side'].map(DEPTH_SIDES)
+        df['action'] = df['action'].map(DEPTH_ACTIONS)
+    df['timestamp'] = pd.to_datetime(df['timestamp_ns'], unit='ns')
+    return df
+
+
+if __name__ == "__main__":
+    import sys
+    for file_path in sys.argv[1:]:
+        records = open_store(file_path)
+        print(f"{file_path}: {len(records)} records")
+        if len(records):
+            print(to_dataframe(records[:5]).to_string())
@@ -0,0 +1,366 @@
+// tick_validate: data-quality checks over tick captures, writing an anomaly index per file.
+//
+//   tick_validate <archive_dir | day.tpk | capture.bin> [...] [--stale-s 60] [--gap-s 60]
+//                 [--constant-size-events 1000] [--threads n]
+//
+// Every input file gets <name>.anomalies next to it (for an archive, <root>/<yyyymmdd>.anomalies,
+// which vwap_replay picks up; see TickAnomalies.h). Files are validated in parallel, one thread
+// per file. Checks, per symbol and in file order:
+//   crossed / locked   bid > ask, bid == ask (both sides positive)
+//   zero_price         a quote side at or below zero, or a trade with no price or size
+//   time_regression    timestamp earlier than the previous event in the file
+//   duplicate          byte-identical to the symbol's previous event
+//   stale_quote        the same bid/ask for longer than --stale-s across at least two events
+//   constant_size      --constant-size-events quote updates in a row that move a price but leave
+//                      both top sizes unchanged, like the constant 500 lots in book_updates captures
+//   gap                no event for the symbol for longer than --gap-s
+// Consecutive anomalous events of one symbol and kind become one AnomalyRecord, so a book that
+// stays crossed for a minute is one record, not thousands.
+
+#include "TickAnomalies.h"
+#include "TickArchive.h"
+#include "TickCompression.h"
+#include "TickStore.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct ValidateLimits {
+    int64_t stale_ns;
+    int64_t gap_ns;
+    uint32_t constant_size_events;
+};
+
+// Open run of one kind for one symbol
+struct AnomalyRun {
+    int64_t start_ns;
+    int64_t end_ns;
+    uint32_t events;
+
+    AnomalyRun() : start_ns(0), end_ns(0), events(0) {}
+};
+
+class CaptureValidator {
+public:
+    explicit CaptureValidator(const ValidateLimits& limits) : limits_(limits), events_(0), last_ns_(INT64_MIN)
+    {
+        memset(runs_by_kind_, 0, sizeof(runs_by_kind_));
+        memset(events_by_kind_, 0, sizeof(events_by_kind_));
+    }
+
+    void Add(const MarketEventRecord& event)
+    {
+        ++events_;
+        uint64_t key;
+        memcpy(&key, event.symbol, sizeof(key));
+        SymbolState& state = symbols_[key];
+        bool first = state.events++ == 0;
+        if (first)
+            memcpy(state.symbol, event.symbol, sizeof(state.symbol));
+
+        bool quote = event.event_type == TICK_EVENT_TYPE_QUOTE;
+        bool two_sided = event.bid > 0.0 && event.ask > 0.0;
+        bool zero = quote ? (event.bid <= 0.0 || event.ask <= 0.0)
+                          : (event.event_type == TICK_EVENT_TYPE_TRADE && (event.trade_price <= 0.0 || event.trade_size <= 0));
+        Mark(state, TICK_ANOMALY_CROSSED, two_sided && event.bid > event.ask, event.timestamp_ns);
+        Mark(state, TICK_ANOMALY_LOCKED, two_sided && event.bid == event.ask, event.timestamp_ns);
+        Mark(state, TICK_ANOMALY_ZERO_PRICE, zero, event.timestamp_ns);
+        Mark(state, TICK_ANOMALY_TIME_REGRESSION, event.timestamp_ns < last_ns_, event.timestamp_ns);
+        Mark(state, TICK_ANOMALY_DUPLICATE, !first && memcmp(&event, &state.last, sizeof(event)) == 0, event.timestamp_ns);
+        last_ns_ = event.timestamp_ns;
+
+        if (!first && event.timestamp_ns - state.last.timestamp_ns > limits_.gap_ns) {
+            AnomalyRun gap;
+            gap.start_ns = state.last.timestamp_ns;
+            gap.end_ns = event.timestamp_ns;
+            Emit(state, TICK_ANOMALY_GAP, gap);
+        }
+
+        if (two_sided)
+            TrackQuote(state, event);
+        state.last = event;
+    }
+
+    // Closes the open runs and returns the records sorted by start time
+    void Finish(std::vector<AnomalyRecord>* records)
+    {
+        for (std::unordered_map<uint64_t, SymbolState>::iterator it = symbols_.begin(); it != symbols_.end(); ++it) {
+            SymbolState& state = it->second;
+            for (int kind = 0; kind < TICK_ANOMALY_KIND_COUNT; ++kind) {
+                if (state.runs[kind].events)
+                    Emit(state, kind, state.runs[kind]);
+            }
+            CloseStaleRun(state);
+            CloseSizeRun(state);
+        }
+        std::stable_sort(records_.begin(), records_.end(), StartsBefore);
+        records->swap(records_);
+    }
+
+    uint64_t events() const { return events_; }
+    uint64_t runs(int kind) const { return runs_by_kind_[kind]; }
+    uint64_t events(int kind) const { return events_by_kind_[kind]; }
+
+private:
+    struct SymbolState {
+        char symbol[8];
+        uint64_t events;
+        MarketEventRecord last;
+        AnomalyRun runs[TICK_ANOMALY_KIND_COUNT];     // event level kinds
+        // Current quote and how long it has stood
+        double bid, ask;
+        AnomalyRun quote;
+        // Price moves with unchanged sizes
+        int32_t bid_size, ask_size;
+        AnomalyRun sizes;
+
+        SymbolState() : events(0), bid(0.0), ask(0.0), bid_size(0), ask_size(0) {}
+    };
+
+    // Runs cover the earliest to the latest flagged timestamp. Late events land back among events
+    // already seen, so a time regression run only holds events of one timestamp; spanning several
+    // would cover the in-order events between them.
+    void Mark(SymbolState& state, int kind, bool flagged, int64_t timestamp_ns)
+    {
+        AnomalyRun& run = state.runs[kind];
+        if (flagged) {
+            if (kind == TICK_ANOMALY_TIME_REGRESSION && run.events && timestamp_ns != run.end_ns) {
+                Emit(state, kind, run);
+                run = AnomalyRun();
+            }
+            if (run.events++ == 0)
+                run.start_ns = run.end_ns = timestamp_ns;
+            run.start_ns = std::min(run.start_ns, timestamp_ns);
+            run.end_ns = std::max(run.end_ns, timestamp_ns);
+        } else if (run.events) {
+            Emit(state, kind, run);
+            run = AnomalyRun();
+        }
+    }
+
+    void TrackQuote(SymbolState& state, const MarketEventRecord& event)
+    {
+        bool moved = event.bid != state.bid || event.ask != state.ask;
+        if (moved) {
+            CloseStaleRun(state);
+            state.bid = event.bid;
+            state.ask = event.ask;
+            state.quote.start_ns = event.timestamp_ns;
+        }
+        state.quote.end_ns = event.timestamp_ns;
+        ++state.quote.events;
+
+        if (event.event_type != TICK_EVENT_TYPE_QUOTE)
+            return;
+        bool same_sizes = event.bid_size == state.bid_size && event.ask_size == state.ask_size;
+        if (moved && same_sizes) {
+            if (state.sizes.events++ == 0)
+                state.sizes.start_ns = event.timestamp_ns;
+            state.sizes.end_ns = event.timestamp_ns;
+        } else if (!same_sizes) {
+            CloseSizeRun(state);
+            state.bid_size = event.bid_size;
+            state.ask_size = event.ask_size;
+        }
+    }
+
+    void CloseStaleRun(SymbolState& state)
+    {
+        if (state.quote.events >= 2 && state.quote.end_ns - state.quote.start_ns > limits_.stale_ns)
+            Emit(state, TICK_ANOMALY_STALE_QUOTE, state.quote);
+        state.quote = AnomalyRun();
+    }
+
+    void CloseSizeRun(SymbolState& state)
+    {
+        if (state.sizes.events >= limits_.constant_size_events)
+            Emit(state, TICK_ANOMALY_CONSTANT_SIZE, state.sizes);
+        state.sizes = AnomalyRun();
+    }
+
+    void Emit(const SymbolState& state, int kind, const AnomalyRun& run)
+    {
+        AnomalyRecord record;
+        memset(&record, 0, sizeof(record));
+        record.start_ns = run.start_ns;
+        record.end_ns = run.end_ns;
+        memcpy(record.symbol, state.symbol, sizeof(record.symbol));
+        record.kind = uint32_t(kind);
+        record.events = run.events;
+        records_.push_back(record);
+        ++runs_by_kind_[kind];
+        events_by_kind_[kind] += run.events;
+    }
+
+    static bool StartsBefore(const AnomalyRecord& a, const AnomalyRecord& b) { return a.start_ns < b.start_ns; }
+
+    ValidateLimits limits_;
+    std::unordered_map<uint64_t, SymbolState> symbols_;
+    std::vector<AnomalyRecord> records_;
+    uint64_t events_;
+    int64_t last_ns_;
+    uint64_t runs_by_kind_[TICK_ANOMALY_KIND_COUNT];
+    uint64_t events_by_kind_[TICK_ANOMALY_KIND_COUNT];
+};
+
+// Feeds one capture through the validator; compressed days block by block, flat files in place
+static bool ValidateFile(const std::string& path, CaptureValidator* validator, std::string* error)
+{
+    TickStoreFile probe;
+    if (!probe.Open(path) || probe.header().record_type != TICK_RECORD_TYPE_MARKET) {
+        *error = "not a market data tick store";
+        return false;
+    }
+    if (!probe.compressed()) {
+        if (probe.header().record_size != sizeof(MarketEventRecord)) {
+            *error = "record size mismatch";
+            return false;
+        }
+        const MarketEventRecord* records = probe.records<MarketEventRecord>();
+        for (size_t i = 0; i < probe.record_count(); ++i)
+            validator->Add(records[i]);
+        return true;
+    }
+    probe.Close();
+
+    CompressedTickReader reader;
+    if (!reader.Open(path)) {
+        *error = "corrupt compressed tick store";
+        return false;
+    }
+    std::vector<MarketEventRecord> block;
+    for (size_t b = 0; b < reader.block_count(); ++b) {
+        block.resize(reader.block(b).records);
+        size_t n = reader.DecodeBlock(b, block.empty() ? NULL : &block[0]);
+        for (size_t i = 0; i < n; ++i)
+            validator->Add(block[i]);
+    }
+    return true;
+}
+
+// "<dir>/20190913.tpk" -> "<dir>/20190913.anomalies"
+static std::string IndexPath(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return path + ".anomalies";
+    return path.substr(0, dot) + ".anomalies";
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: tick_validate <archive_dir | day.tpk | capture.bin> [...] [--stale-s 60] [--gap-s 60]\n"
+                    "                     [--constant-size-events 1000] [--threads n]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    ValidateLimits limits = { 60LL * 1000000000LL, 60LL * 1000000000LL, 1000 };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stale-s" && i + 1 < argc) {
+            limits.stale_ns = int64_t(atof(argv[++i]) * 1e9);
+        } else if (arg == "--gap-s" && i + 1 < argc) {
+            limits.gap_ns = int64_t(atof(argv[++i]) * 1e9);
+        } else if (arg == "--constant-size-events" && i + 1 < argc) {
+            limits.constant_size_events = uint32_t(std::max(1, atoi(argv[++i])));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return Usage();
+        } else {
+            TickArchive archive;
+            if (archive.Open(arg) && !archive.dates().empty()) {
+                for (size_t d = 0; d < archive.dates().size(); ++d)
+                    paths.push_back(archive.DayPath(archive.dates()[d]));
+            } else {
+                paths.push_back(arg);
+            }
+        }
+    }
+    if (paths.empty())
+        return Usage();
+
+    timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    std::vector<std::string> reports(paths.size());
+    std::vector<uint64_t> totals(2 * TICK_ANOMALY_KIND_COUNT + 1, 0);
+    std::atomic<size_t> next_file(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> workers;
+    threads = unsigned(std::min<size_t>(threads, paths.size()));
+    std::vector<std::vector<uint64_t> > counts(paths.size(), std::vector<uint64_t>(totals.size(), 0));
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            for (size_t f = next_file++; f < paths.size(); f = next_file++) {
+                CaptureValidator validator(limits);
+                std::string error;
+                std::vector<AnomalyRecord> records;
+                if (!ValidateFile(paths[f], &validator, &error)) {
+                    reports[f] = paths[f] + ": " + error + "\n";
+                    failed = true;
+                    continue;
+                }
+                validator.Finish(&records);
+                std::string index = IndexPath(paths[f]);
+                timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+                if (!WriteAnomalyFile(index, records, int64_t(now.tv_sec) * 1000000000LL + now.tv_nsec)) {
+                    reports[f] = paths[f] + ": could not write " + index + "\n";
+                    failed = true;
+                    continue;
+                }
+
+                char line[256];
+                snprintf(line, sizeof(line), "%s: events=%llu records=%zu -> %s\n", paths[f].c_str(),
+                         (unsigned long long)validator.events(), records.size(), index.c_str());
+                reports[f] = line;
+                counts[f][0] = validator.events();
+                for (int kind = 1; kind < TICK_ANOMALY_KIND_COUNT; ++kind) {
+                    counts[f][1 + 2 * kind] = validator.runs(kind);
+                    counts[f][2 + 2 * kind] = validator.events(kind);
+                    if (validator.runs(kind)) {
+                        snprintf(line, sizeof(line), "    %-16s runs=%llu events=%llu\n", TickAnomalyKindName(kind),
+                                 (unsigned long long)validator.runs(kind), (unsigned long long)validator.events(kind));
+                        reports[f] += line;
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+    timespec finished;
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double seconds = double(finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) / 1e9;
+
+    for (size_t f = 0; f < paths.size(); ++f) {
+        fputs(reports[f].c_str(), stdout);
+        for (size_t c = 0; c < totals.size(); ++c)
+            totals[c] += counts[f][c];
+    }
+    if (paths.size() > 1) {
+        for (int kind = 1; kind < TICK_ANOMALY_KIND_COUNT; ++kind) {
+            if (totals[1 + 2 * kind])
+                printf("total %-16s runs=%llu events=%llu\n", TickAnomalyKindName(kind),
+                       (unsigned long long)totals[1 + 2 * kind], (unsigned long long)totals[2 + 2 * kind]);
+        }
+    }
+    printf("%zu files, %llu events, %u threads: %.3fs (%.1f M events/s)\n", paths.size(), (unsigned long long)totals[0],
+           threads, seconds, seconds > 0.0 ? totals[0] / seconds / 1e6 : 0.0);
+    return failed ? 1 : 0;
+}
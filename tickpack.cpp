@@ -0,0 +1,148 @@
+// tickpack: convert tick store files to and from the compressed format and benchmark decoding.
+//
+//   tickpack pack <in.bin> <out.tpk> [price_scale] [block_records]
+//   tickpack unpack <in.tpk> <out.bin>
+//   tickpack bench <in.tpk> [passes]
+
+#include "TickCompression.h"
+#include "FeatureExport.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int Pack(const char* in_path, const char* out_path, double price_scale, size_t block_records)
+{
+    TickStoreFile in;
+    if (!in.Open(in_path) || in.compressed()) {
+        fprintf(stderr, "tickpack: %s is not an uncompressed tick store file\n", in_path);
+        return 1;
+    }
+
+    CompressedTickWriter writer;
+    if (!writer.Open(out_path, price_scale, block_records)) {
+        fprintf(stderr, "tickpack: could not open %s\n", out_path);
+        return 1;
+    }
+
+    const TickStoreHeader& header = in.header();
+    size_t count = in.record_count();
+    bool ok = true;
+    if (header.record_type == TICK_RECORD_TYPE_FEATURE && header.record_size == sizeof(FeatureRecord)) {
+        const FeatureRecord* records = in.records<FeatureRecord>();
+        for (size_t i = 0; i < count && ok; ++i)
+            ok = writer.Append(ToMarketEvent(records[i]));
+    } else if (header.record_type == TICK_RECORD_TYPE_MARKET && header.record_size == sizeof(MarketEventRecord)) {
+        const MarketEventRecord* records = in.records<MarketEventRecord>();
+        for (size_t i = 0; i < count && ok; ++i)
+            ok = writer.Append(records[i]);
+    } else {
+        fprintf(stderr, "tickpack: unsupported record type %u\n", header.record_type);
+        return 1;
+    }
+
+    if (!writer.Close() || !ok) {
+        fprintf(stderr, "tickpack: failed writing %s (write error, too many symbols or a residual wider than %d bits)\n",
+                out_path, int(TICK_COMPRESSED_MAX_WIDTH));
+        return 1;
+    }
+
+    size_t raw_bytes = sizeof(TickStoreHeader) + count * sizeof(MarketEventRecord);
+    printf("%zu records, %zu -> %llu bytes (%.2fx vs MarketEventRecord), max price error %g\n",
+           count, raw_bytes, (unsigned long long)writer.bytes_written(),
+           double(raw_bytes) / double(writer.bytes_written()), writer.max_price_error());
+    return 0;
+}
+
+static int Unpack(const char* in_path, const char* out_path)
+{
+    CompressedTickReader reader;
+    if (!reader.Open(in_path)) {
+        fprintf(stderr, "tickpack: %s is not a compressed tick store file\n", in_path);
+        return 1;
+    }
+
+    TickStoreWriter writer;
+    if (!writer.Open(out_path, TICK_RECORD_TYPE_MARKET, sizeof(MarketEventRecord))) {
+        fprintf(stderr, "tickpack: could not open %s\n", out_path);
+        return 1;
+    }
+
+    std::vector<MarketEventRecord> block;
+    for (size_t b = 0; b < reader.block_count(); ++b) {
+        block.resize(reader.block(b).records);
+        size_t n = reader.DecodeBlock(b, &block[0]);
+        for (size_t i = 0; i < n; ++i)
+            writer.Append(block[i]);
+    }
+    writer.Close();
+    if (writer.write_errors()) {
+        fprintf(stderr, "tickpack: write errors on %s\n", out_path);
+        return 1;
+    }
+    printf("%llu records\n", (unsigned long long)writer.records_written());
+    return 0;
+}
+
+static int Bench(const char* in_path, int passes)
+{
+    CompressedTickReader reader;
+    if (!reader.Open(in_path, MADV_WILLNEED)) {
+        fprintf(stderr, "tickpack: %s is not a compressed tick store file\n", in_path);
+        return 1;
+    }
+
+    std::vector<MarketEventRecord> block;
+    int64_t checksum = 0;
+    double start = Seconds();
+    for (int pass = 0; pass < passes; ++pass) {
+        for (size_t b = 0; b < reader.block_count(); ++b) {
+            block.resize(reader.block(b).records);
+            size_t n = reader.DecodeBlock(b, &block[0]);
+            checksum += block[n - 1].timestamp_ns;
+        }
+    }
+    double elapsed = Seconds() - start;
+
+    double records = double(reader.record_count()) * passes;
+    double raw_bytes = records * sizeof(MarketEventRecord);
+    double packed_bytes = double(reader.file_size()) * passes;
+    printf("decoded %.0f records in %.3fs: %.1f M records/s, %.2f GB/s of raw records, %.2f GB/s of compressed input (checksum %lld)\n",
+           records, elapsed, records / elapsed / 1e6, raw_bytes / elapsed / 1e9, packed_bytes / elapsed / 1e9,
+           (long long)checksum);
+    printf("a raw replay needs sequential reads above %.2f GB/s to keep up with this decoder\n",
+           raw_bytes / elapsed / 1e9);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "pack") == 0) {
+        double price_scale = (argc > 4) ? atof(argv[4]) : 10000.0;
+        long block_records = (argc > 5) ? atol(argv[5]) : 1024;
+        if (block_records <= 0) {
+            fprintf(stderr, "tickpack: block_records must be at least 1\n");
+            return 2;
+        }
+        return Pack(argv[2], argv[3], price_scale, size_t(block_records));
+    }
+    if (argc == 4 && strcmp(argv[1], "unpack") == 0)
+        return Unpack(argv[2], argv[3]);
+    if (argc >= 3 && strcmp(argv[1], "bench") == 0)
+        return Bench(argv[2], (argc > 3) ? atoi(argv[3]) : 10);
+
+    fprintf(stderr,
+            "usage: tickpack pack <in.bin> <out.tpk> [price_scale] [block_records]\n"
+            "       tickpack unpack <in.tpk> <out.bin>\n"
+            "       tickpack bench <in.tpk> [passes]\n");
+    return 2;
+}
@@ -0,0 +1,219 @@
+// vwap_counterfactual: threshold sweeps over a VWAPStrategy feature export, without market data.
+//
+//   vwap_counterfactual <features.bin> [--thresholds lo:hi:step] [--inventories 5,10] [--sizes 1,2]
+//                       [--threads n] [--top k] [--out results.csv]
+//
+// The export already records mid, VWAP and deviation for every trade, so a threshold,
+// inventory or size change only needs the entry/exit logic re-run. The trades are read once
+// into compact records and every combination of the given grids runs as a shadow variant
+// (VWAPShadow.h): fills are instant at the exported touch and PnL is marked to the last mid.
+// Variants are cut into tiles small enough for their state to stay in L1/L2, and threads take
+// tiles off a shared counter, each streaming every trade through its tile.
+
+#include "TickStore.h"
+#include "VWAPShadow.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One exported trade reduced to what the decision logic reads
+struct CounterfactualEvent {
+    double deviation_bps;
+    double bid;
+    double ask;
+    uint32_t slot;
+    uint32_t reserved;
+};
+
+struct CounterfactualResult {
+    double entry_threshold_bps;
+    int max_inventory;
+    int position_size;
+    double pnl;
+    int64_t trades;
+    int64_t volume;
+
+    bool operator<(const CounterfactualResult& other) const { return pnl > other.pnl; }
+};
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static std::vector<double> ParseList(const std::string& list)
+{
+    std::vector<double> values;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+            comma = list.size();
+        values.push_back(atof(list.substr(start, comma - start).c_str()));
+        start = comma + 1;
+    }
+    return values;
+}
+
+// Trades the live strategy would have acted on: VWAP ready and a two sided quote
+static size_t LoadEvents(const TickStoreFile& file, std::vector<CounterfactualEvent>* events)
+{
+    std::map<std::string, uint32_t> slots;
+    const FeatureRecord* records = file.records<FeatureRecord>();
+    for (size_t i = 0; i < file.record_count(); ++i) {
+        const FeatureRecord& record = records[i];
+        if (record.event_type != TICK_EVENT_TYPE_TRADE || !record.vwap_ready || record.bid <= 0.0 || record.ask <= 0.0)
+            continue;
+        std::string symbol(record.symbol, strnlen(record.symbol, sizeof(record.symbol)));
+        std::map<std::string, uint32_t>::iterator it = slots.find(symbol);
+        if (it == slots.end())
+            it = slots.insert(std::make_pair(symbol, uint32_t(slots.size()))).first;
+        CounterfactualEvent event = { record.deviation_bps, record.bid, record.ask, it->second, 0 };
+        events->push_back(event);
+    }
+    return slots.size();
+}
+
+static void RunVariants(const std::vector<CounterfactualEvent>& events, size_t slot_count,
+                        CounterfactualResult* results, size_t count)
+{
+    VWAPShadowBook book;
+    for (size_t i = 0; i < count; ++i)
+        book.AddVariant(results[i].entry_threshold_bps, results[i].max_inventory, results[i].position_size);
+    for (size_t slot = 0; slot < slot_count; ++slot)
+        book.AddSlot();
+
+    for (size_t i = 0; i < events.size(); ++i)
+        book.Update(events[i].slot, events[i].deviation_bps, events[i].bid, events[i].ask);
+
+    for (size_t i = 0; i < count; ++i) {
+        results[i].pnl = book.pnl(i);
+        results[i].trades = book.trades(i);
+        results[i].volume = book.traded_volume(i);
+    }
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: vwap_counterfactual <features.bin> [--thresholds lo:hi:step] [--inventories 5,10] [--sizes 1,2]\n"
+                    "                           [--threads n] [--top k] [--out results.csv]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        return Usage();
+
+    double lo = 0.1, hi = 10.0, step = 0.1;
+    std::vector<double> inventories(1, 5.0), sizes(1, 1.0);
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t top = 10;
+    std::string out_path;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--thresholds" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%lf:%lf:%lf", &lo, &hi, &step) != 3)
+                return Usage();
+        } else if (arg == "--inventories" && i + 1 < argc) {
+            inventories = ParseList(argv[++i]);
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes = ParseList(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--top" && i + 1 < argc) {
+            top = size_t(atoi(argv[++i]));
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            return Usage();
+        }
+    }
+
+    // Thresholds below 0 are not valid shadow variants, see VWAPShadowBook::AddVariant
+    if (!(lo >= 0.0) || !(hi >= lo) || !(step > 0.0) || (hi - lo) / step > 1e6) {
+        fprintf(stderr, "vwap_counterfactual: --thresholds needs 0 <= lo <= hi and step > 0, at most 1e6 steps\n");
+        return 2;
+    }
+    if (inventories.empty() || sizes.empty()) {
+        fprintf(stderr, "vwap_counterfactual: --inventories and --sizes need at least one value\n");
+        return 2;
+    }
+
+    TickStoreFile file;
+    if (!file.Open(argv[1]) || file.compressed() || file.header().record_type != TICK_RECORD_TYPE_FEATURE ||
+        file.header().record_size != sizeof(FeatureRecord)) {
+        fprintf(stderr, "vwap_counterfactual: %s is not a feature export\n", argv[1]);
+        return 1;
+    }
+
+    double started = Seconds();
+    std::vector<CounterfactualEvent> events;
+    size_t slot_count = LoadEvents(file, &events);
+    double loaded = Seconds();
+
+    std::vector<CounterfactualResult> results;
+    int steps = int((hi - lo) / step + 1e-9);
+    for (int t = 0; t <= steps; ++t) {
+        for (size_t v = 0; v < inventories.size(); ++v) {
+            for (size_t s = 0; s < sizes.size(); ++s) {
+                CounterfactualResult result = { lo + t * step, int(inventories[v]), int(sizes[s]), 0.0, 0, 0 };
+                results.push_back(result);
+            }
+        }
+    }
+
+    const size_t kTileVariants = 256;
+    size_t tiles = (results.size() + kTileVariants - 1) / kTileVariants;
+    threads = unsigned(std::min<size_t>(threads, tiles));
+    std::atomic<size_t> next_tile(0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            for (size_t tile; (tile = next_tile.fetch_add(1)) < tiles;) {
+                size_t begin = tile * kTileVariants;
+                RunVariants(events, slot_count, &results[begin], std::min(kTileVariants, results.size() - begin));
+            }
+        }));
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    double finished = Seconds();
+
+    std::sort(results.begin(), results.end());
+    if (!out_path.empty()) {
+        FILE* out = fopen(out_path.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "vwap_counterfactual: could not open %s\n", out_path.c_str());
+            return 1;
+        }
+        fprintf(out, "entry_threshold_bps,max_inventory,position_size,pnl,trades,volume\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const CounterfactualResult& r = results[i];
+            fprintf(out, "%g,%d,%d,%.4f,%lld,%lld\n", r.entry_threshold_bps, r.max_inventory, r.position_size, r.pnl,
+                    (long long)r.trades, (long long)r.volume);
+        }
+        fclose(out);
+    }
+
+    printf("%zu trades, %zu symbols, %zu variants on %zu threads: load %.3fs, sweep %.3fs (%.0fM variant-events/s)\n",
+           events.size(), slot_count, results.size(), workers.size(), loaded - started, finished - loaded,
+           double(events.size()) * results.size() / (finished - loaded) / 1e6);
+    for (size_t i = 0; i < std::min(top, results.size()); ++i) {
+        const CounterfactualResult& r = results[i];
+        printf("threshold=%g max_inventory=%d position_size=%d pnl=%.2f trades=%lld volume=%lld\n",
+               r.entry_threshold_bps, r.max_inventory, r.position_size, r.pnl, (long long)r.trades, (long long)r.volume);
+    }
+    return 0;
+}
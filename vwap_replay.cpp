@@ -0,0 +1,894 @@
+// vwap_replay: offline replay of VWAPStrategy's trading logic over a tick archive.
+//
+//   vwap_replay <archive_dir> <start> <end> [--symbols AAPL,MSFT] [--set name=value ...] [--out prefix]
+//               [--speed x [--spin-us n] | --threads n] [--record out.bin] [--print-params]
+//
+// start/end are UTC "yyyymmdd[ hh:mm:ss[.ffffff]]". Params use the strategy's names
+// (vwap_window_seconds, vwap_max_horizon_seconds, entry_threshold_bps, max_inventory,
+// position_size, symbol_params_file, symbol_params) plus execution_cost_per_share, skip_anomalies and reorder_hold_us.
+// Market orders fill immediately at the
+// touch of the event that triggered them. With --out the orders and fills are written as
+// <prefix>_order.csv and <prefix>_fill.csv in the Strategy Studio backtest layout.
+//
+// By default events are replayed as fast as they decode. --speed 1 paces them at the original
+// event times (--speed 10 at ten times real time) and reports wakeup jitter, callback time and
+// how far the replay fell behind market time. --print-params prints the effective params and
+// exits without replaying. Built with make PROFILE=1, the trade and quote paths of OnEvent are
+// profiled (CallbackProfiler.h) and the per-callback report is printed after the summary.
+//
+// --threads n shards the symbols over n threads (VWAPShardedReplay) with the same results, orders
+// and fills as one thread. The VWAP window is shared across symbols, as in the strategy, so it
+// runs on a serial merge barrier between the parallel decode and per-symbol phases.
+//
+// When tick_validate has written <yyyymmdd>.anomalies next to the replayed days, events inside
+// flagged intervals are counted, and those of the kinds in skip_anomalies (e.g. "crossed,zero_price"
+// or "all") are dropped before they reach the strategy logic.
+//
+// reorder_hold_us puts events through a TickReorderBuffer before the strategy logic, so trades and
+// quotes are handled in exchange timestamp order even when the capture interleaves them out of
+// order; the out-of-order count and the latency the hold adds are printed after the summary.
+//
+// --record out.bin passes every event, in arrival order, through the MarketRecorder that the
+// strategy's record_market_data mode uses, and prints what Record costs per event and how many
+// events were dropped. The file holds the replayed events as a flat tick store.
+
+#ifdef CALLBACK_PROFILE
+    #define CALLBACK_PROFILER_DEFINE_ALLOCATOR
+#endif
+#include "CallbackProfiler.h"
+#include "MarketRecorder.h"
+#include "ReplayPacer.h"
+#include "TickAnomalies.h"
+#include "TickArchive.h"
+#include "TickReorderBuffer.h"
+#include "VWAPSignal.h"
+#include "VWAPSignalGraph.h"
+#include "VWAPSymbolParams.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct VWAPReplayParams {
+    int vwap_window_seconds;
+    int vwap_max_horizon_seconds;
+    double entry_threshold_bps;
+    int max_inventory;
+    int position_size;
+    double execution_cost_per_share;
+    VWAPSymbolParamTable symbol_params_file;    // Layered under symbol_params, as in VWAPStrategy
+    VWAPSymbolParamTable symbol_params;
+    uint32_t skip_anomalies;                    // Mask of TickAnomalyKinds whose events are dropped
+    int reorder_hold_us;                        // Max hold of the reorder stage, 0 for none
+    std::string error;
+
+    VWAPReplayParams()
+        : vwap_window_seconds(300), vwap_max_horizon_seconds(1800), entry_threshold_bps(0.1),
+          max_inventory(5), position_size(1), execution_cost_per_share(0.0), skip_anomalies(0),
+          reorder_hold_us(0)
+    {
+    }
+
+    bool Set(const std::string& name, const std::string& value)
+    {
+        if (name == "vwap_window_seconds") vwap_window_seconds = atoi(value.c_str());
+        else if (name == "vwap_max_horizon_seconds") vwap_max_horizon_seconds = atoi(value.c_str());
+        else if (name == "entry_threshold_bps") entry_threshold_bps = atof(value.c_str());
+        else if (name == "max_inventory") max_inventory = atoi(value.c_str());
+        else if (name == "position_size") position_size = atoi(value.c_str());
+        else if (name == "execution_cost_per_share") execution_cost_per_share = atof(value.c_str());
+        else if (name == "symbol_params_file") return symbol_params_file.LoadFile(value, &error);
+        else if (name == "symbol_params") return symbol_params.Parse(value, &error);
+        else if (name == "reorder_hold_us") reorder_hold_us = atoi(value.c_str());
+        else if (name == "skip_anomalies") {
+            if (!ParseTickAnomalyKinds(value, &skip_anomalies)) {
+                error = "invalid skip_anomalies " + value;
+                return false;
+            }
+        } else {
+            error = "unknown param " + name;
+            return false;
+        }
+        if (vwap_window_seconds <= 0 || vwap_max_horizon_seconds <= 0) {
+            error = "invalid " + name + " " + value + ", expected a positive number of seconds";
+            return false;
+        }
+        return true;
+    }
+
+    VWAPSymbolParams Resolve(const std::string& symbol) const
+    {
+        VWAPSymbolParams defaults = { entry_threshold_bps, max_inventory, position_size };
+        return symbol_params.Resolve(symbol, symbol_params_file.Resolve(symbol, defaults));
+    }
+
+    // Every param with its effective value, one name=value per line in a fixed order, so callers can key results on it
+    void Print(FILE* out) const
+    {
+        fprintf(out, "vwap_window_seconds=%d\n", vwap_window_seconds);
+        fprintf(out, "vwap_max_horizon_seconds=%d\n", vwap_max_horizon_seconds);
+        fprintf(out, "entry_threshold_bps=%.17g\n", entry_threshold_bps);
+        fprintf(out, "max_inventory=%d\n", max_inventory);
+        fprintf(out, "position_size=%d\n", position_size);
+        fprintf(out, "execution_cost_per_share=%.17g\n", execution_cost_per_share);
+        // The file's contents rather than its path, merged with the overrides
+        VWAPSymbolParamTable merged = symbol_params_file;
+        merged.Apply(symbol_params);
+        fprintf(out, "symbol_params=%s\n", merged.ToString().c_str());
+        fprintf(out, "skip_anomalies=%s\n", FormatTickAnomalyKinds(skip_anomalies).c_str());
+        fprintf(out, "reorder_hold_us=%d\n", reorder_hold_us);
+    }
+};
+
+struct VWAPReplayPosition {
+    int position;
+    double cash;
+    double execution_cost;
+    VWAPSymbolParams params;
+    VWAPSignalGraph signal;          // mid, deviation and decision, evaluated when a trade needs them
+    TickAnomalyIndex::Cursor flagged;
+    TickAnomalyIndex::Cursor skipped;
+
+    explicit VWAPReplayPosition(const VWAPSymbolParams& symbol_params)
+        : position(0), cash(0.0), execution_cost(0.0), params(symbol_params)
+    {
+        signal.SetParams(params);
+    }
+
+    // Per-symbol half of OnTrade, run once the shared window has taken the event: tracks the top of
+    // book and, on a trade with the window ready, moves the position. window_pv and window_volume
+    // are the window's running sums after the event. Returns the shares traded at *price.
+    int OnEvent(const MarketEventRecord& event, bool window_ready, double window_pv, int64_t window_volume,
+                double cost_per_share, double* price)
+    {
+        bool valid_quote = event.bid > 0.0 && event.ask > 0.0;
+        if (valid_quote)
+            signal.SetQuote(event.bid, event.ask);
+        if (event.event_type != TICK_EVENT_TYPE_TRADE)
+            return 0;
+        signal.SetWindow(window_ready, window_pv, window_volume);
+        if (!signal.window_ready() || !valid_quote)
+            return 0;
+
+        signal.SetPosition(position);
+        int trade_size = signal.decision().desired_position - position;
+        if (trade_size != 0) {
+            *price = (trade_size > 0) ? event.ask : event.bid;
+            position += trade_size;
+            cash -= trade_size * *price;
+            execution_cost += abs(trade_size) * cost_per_share;
+        }
+        return trade_size;
+    }
+};
+
+class VWAPReplay {
+public:
+    explicit VWAPReplay(const VWAPReplayParams& params)
+        : params_(params), window_(params.vwap_window_seconds, params.vwap_max_horizon_seconds),
+          events_(0), trades_(0), orders_(0), next_order_id_(1), orders_file_(NULL), fills_file_(NULL),
+          flagged_index_(NULL), skipped_index_(NULL), flagged_events_(0), skipped_events_(0),
+          reorder_(int64_t(params.reorder_hold_us) * 1000)
+    {
+        on_trade_profile_ = profiler_.Register("OnTrade");
+        on_quote_profile_ = profiler_.Register("OnQuote");
+    }
+
+    ~VWAPReplay()
+    {
+        if (orders_file_) fclose(orders_file_);
+        if (fills_file_) fclose(fills_file_);
+    }
+
+    bool OpenOutput(const std::string& prefix)
+    {
+        orders_file_ = fopen((prefix + "_order.csv").c_str(), "w");
+        fills_file_ = fopen((prefix + "_fill.csv").c_str(), "w");
+        if (!orders_file_ || !fills_file_)
+            return false;
+        fprintf(orders_file_, "StrategyName,EntryTime,LastModTime,State,LastUpdateType,Symbol,Side,Type,TIF,Price,Quantity,"
+                              "DisplayQuantity,FilledQty,Remains,AvgFillPrice,ExecutionCost,Account,Trader,Broker,"
+                              "MarketCenter,OrderId,Tag,Reason,Closure\n");
+        fprintf(fills_file_, "StrategyName,TradeTime,Symbol,Quantity,Price,ExecutionCost,LiquidityAction,LiquidityCode,"
+                             "RawLiquidity,Account,Trader,MarketCenter,OrderID,ExecID,TransactionType\n");
+        return true;
+    }
+
+    // Anomaly indexes of the replayed days: every kind, for counting, and the skip_anomalies kinds
+    void SetAnomalies(const TickAnomalyIndex* flagged, const TickAnomalyIndex* skipped)
+    {
+        flagged_index_ = flagged;
+        skipped_index_ = skipped;
+    }
+
+    // An event as it arrives from the capture, through the reorder stage when reorder_hold_us is set
+    void OnArrival(const MarketEventRecord& event)
+    {
+        if (!reordering()) {
+            OnEvent(event);
+            return;
+        }
+        reorder_.Push(event);
+        MarketEventRecord released;
+        while (reorder_.Pop(&released))
+            OnEvent(released);
+    }
+
+    // End of the capture: releases whatever the reorder stage still holds
+    void Finish()
+    {
+        reorder_.Flush();
+        MarketEventRecord released;
+        while (reorder_.Pop(&released))
+            OnEvent(released);
+    }
+
+    bool reordering() const { return params_.reorder_hold_us > 0; }
+    TickReorderBuffer& reorder() { return reorder_; }
+
+    // Mirrors VWAPStrategy::OnTrade, which shares one VWAP window across all instruments
+    void OnEvent(const MarketEventRecord& event)
+    {
+        if (event.event_type == TICK_EVENT_TYPE_TRADE) {
+            PROFILE_CALLBACK(profiler_, on_trade_profile_);
+            HandleEvent(event);
+        } else {
+            PROFILE_CALLBACK(profiler_, on_quote_profile_);
+            HandleEvent(event);
+        }
+    }
+
+    const CallbackProfiler& profiler() const { return profiler_; }
+    const VWAPReplayParams& params() const { return params_; }
+
+    void PrintSummary() const
+    {
+        double total = 0.0;
+        uint64_t evaluations[VWAP_NODE_COUNT] = { 0 };
+        for (std::map<std::string, VWAPReplayPosition>::const_iterator it = positions_.begin(); it != positions_.end(); ++it) {
+            const VWAPReplayPosition& state = it->second;
+            for (int node = 0; node < VWAP_NODE_COUNT; ++node)
+                evaluations[node] += state.signal.evaluations(node);
+            double pnl = state.cash + state.position * state.signal.mid() - state.execution_cost;
+            total += pnl;
+            printf("%-8s position=%d pnl=%.2f execution_cost=%.4f\n", it->first.c_str(), state.position, pnl, state.execution_cost);
+        }
+        printf("events=%llu trades=%llu orders=%llu pnl=%.2f\n",
+               (unsigned long long)events_, (unsigned long long)trades_, (unsigned long long)orders_, total);
+        printf("signal graph evaluations:");
+        for (int node = 0; node < VWAP_NODE_COUNT; ++node)
+            printf(" %s=%llu", VWAPSignalNodeName(node), (unsigned long long)evaluations[node]);
+        printf("\n");
+        if (flagged_index_ && flagged_index_->files() > 0) {
+            printf("anomalies files=%zu records=%zu flagged_events=%llu skipped_events=%llu\n", flagged_index_->files(),
+                   flagged_index_->records(), (unsigned long long)flagged_events_, (unsigned long long)skipped_events_);
+        }
+    }
+
+    // The steps of OnEvent that touch state shared across symbols, for VWAPShardedReplay to run on
+    // its merge barrier in event order
+
+    VWAPReplayPosition& Position(const std::string& symbol)
+    {
+        std::map<std::string, VWAPReplayPosition>::iterator it = positions_.find(symbol);
+        if (it == positions_.end()) {
+            it = positions_.insert(std::make_pair(symbol, VWAPReplayPosition(params_.Resolve(symbol)))).first;
+            if (flagged_index_) {
+                it->second.flagged = flagged_index_->CursorFor(symbol);
+                it->second.skipped = skipped_index_->CursorFor(symbol);
+            }
+        }
+        return it->second;
+    }
+
+    // Counts the event, and true if skip_anomalies drops it
+    bool CountEvent(VWAPReplayPosition& state, int64_t timestamp_ns)
+    {
+        ++events_;
+        if (TickAnomalyIndex::Find(&state.flagged, timestamp_ns))
+            ++flagged_events_;
+        if (TickAnomalyIndex::Find(&state.skipped, timestamp_ns)) {
+            ++skipped_events_;
+            return true;
+        }
+        return false;
+    }
+
+    // Feeds a trade to the shared window; true if the window is ready to trade on
+    bool AddTrade(const MarketEventRecord& event)
+    {
+        ++trades_;
+        window_.Add(event.timestamp_ns, event.trade_price, event.trade_size);
+        window_.Advance(event.timestamp_ns);
+        return window_.Ready();
+    }
+
+    const VWAPWindow& window() const { return window_; }
+
+    // Numbers the order and writes it with its fill
+    void WriteOrder(int64_t timestamp_ns, const std::string& symbol, int trade_size, double price)
+    {
+        double cost = abs(trade_size) * params_.execution_cost_per_share;
+        ++orders_;
+
+        unsigned long long order_id = next_order_id_++;
+        if (orders_file_) {
+            std::string time = FormatTime(timestamp_ns);
+            fprintf(orders_file_, "REPLAY,%s,%s,FILLED,FILL,%s,%s,MARKET,DAY,%f,%d,0,%d,0,%f,%f,,,REPLAY,,%llu,,,\n",
+                    time.c_str(), time.c_str(), symbol.c_str(), trade_size > 0 ? "BUY" : "SELL", price, trade_size,
+                    trade_size, price, cost, order_id);
+            fprintf(fills_file_, "REPLAY,%s,%s,%d,%f,%f,REMOVED,0,,,,,%llu,,FILL\n",
+                    time.c_str(), symbol.c_str(), trade_size, price, cost, order_id);
+        }
+    }
+
+private:
+    void HandleEvent(const MarketEventRecord& event)
+    {
+        std::string symbol(event.symbol, strnlen(event.symbol, sizeof(event.symbol)));
+        VWAPReplayPosition& state = Position(symbol);
+        if (CountEvent(state, event.timestamp_ns))
+            return;
+        bool window_ready = event.event_type == TICK_EVENT_TYPE_TRADE && AddTrade(event);
+        double price;
+        int trade_size = state.OnEvent(event, window_ready, window_.cumulative_pv(), window_.cumulative_volume(),
+                                       params_.execution_cost_per_share, &price);
+        if (trade_size != 0)
+            WriteOrder(event.timestamp_ns, symbol, trade_size, price);
+    }
+
+    // Strategy Studio's "2019-Sep-13 13:30:01.012805"
+    static std::string FormatTime(int64_t timestamp_ns)
+    {
+        time_t seconds = time_t(timestamp_ns / 1000000000LL);
+        struct tm parts;
+        gmtime_r(&seconds, &parts);
+        char buffer[64];
+        size_t n = strftime(buffer, sizeof(buffer), "%Y-%b-%d %H:%M:%S", &parts);
+        snprintf(buffer + n, sizeof(buffer) - n, ".%06lld", (long long)(timestamp_ns % 1000000000LL) / 1000);
+        return buffer;
+    }
+
+private:
+    VWAPReplayParams params_;
+    VWAPWindow window_;
+    std::map<std::string, VWAPReplayPosition> positions_;
+    uint64_t events_;
+    uint64_t trades_;
+    uint64_t orders_;
+    unsigned long long next_order_id_;
+    FILE* orders_file_;
+    FILE* fills_file_;
+    CallbackProfiler profiler_;
+    size_t on_trade_profile_;
+    size_t on_quote_profile_;
+    const TickAnomalyIndex* flagged_index_;
+    const TickAnomalyIndex* skipped_index_;
+    uint64_t flagged_events_;
+    uint64_t skipped_events_;
+    TickReorderBuffer reorder_;
+};
+
+static double Seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Runs work(thread) on threads threads, the calling thread being thread 0
+template <typename Work>
+static void ParallelFor(unsigned threads, const Work& work)
+{
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.push_back(std::thread(work, t));
+    work(0);
+    for (size_t t = 0; t < workers.size(); ++t)
+        workers[t].join();
+}
+
+// Replays an archive range on several threads with results bit-identical to feeding the same
+// events to VWAPReplay::OnEvent on one thread. The range is walked like TickArchiveCursor does, in
+// batches of blocks, and each batch goes through three phases:
+//   decode    blocks are decompressed in parallel, each thread with its own reader
+//   barrier   one thread walks the events in archive order and runs everything shared across
+//             symbols: the range and symbol filters, anomaly lookups and the VWAP window, which
+//             VWAPStrategy shares across all instruments. Each event is stamped with the window
+//             state it saw and queued on its symbol's shard.
+//   symbols   each thread runs the per-symbol logic of its shard's instruments in event order
+// Orders are then numbered and written in event order, so the CSVs match as well. The reorder stage
+// runs on the barrier too; events it holds past the end of a batch are handled in a later one.
+class VWAPShardedReplay {
+public:
+    VWAPShardedReplay(const TickArchive& archive, VWAPReplay* replay, unsigned threads)
+        : archive_(archive), replay_(replay), threads_(threads), shards_(threads), fills_(threads),
+          next_sequence_(0), blocks_decoded_(0), blocks_skipped_(0)
+    {
+        memset(phase_seconds_, 0, sizeof(phase_seconds_));
+    }
+
+    void Run(int64_t start_ns, int64_t end_ns, const std::vector<std::string>& symbols)
+    {
+        start_ns_ = start_ns;
+        end_ns_ = end_ns;
+        symbols_ = symbols;
+        const std::vector<std::string>& dates = archive_.dates();
+        bool seek = true;
+        bool done = false;
+        for (size_t day = std::lower_bound(dates.begin(), dates.end(), TickArchive::DateOf(start_ns)) - dates.begin();
+             day < dates.size() && !done; ++day) {
+            // One reader per thread, since DecodeBlock keeps its scratch columns in the reader
+            readers_.clear();
+            for (unsigned t = 0; t < threads_; ++t) {
+                readers_.push_back(std::unique_ptr<CompressedTickReader>(new CompressedTickReader()));
+                if (!readers_.back()->Open(archive_.DayPath(dates[day])))
+                    break;
+            }
+            if (readers_.size() < threads_)
+                continue;
+            const CompressedTickReader& reader = *readers_[0];
+            uint64_t mask[TICK_COMPRESSED_MAX_SYMBOLS / 64] = { 0 };
+            for (size_t i = 0; i < symbols_.size(); ++i) {
+                int id = reader.FindSymbol(symbols_[i]);
+                if (id >= 0)
+                    mask[id >> 6] |= uint64_t(1) << (id & 63);
+            }
+
+            size_t block = seek ? reader.SeekBlock(start_ns) : 0;
+            seek = false;
+            while (block < reader.block_count() && !done) {
+                // Same block selection as TickArchiveCursor::DecodeNextBlock
+                batch_.clear();
+                size_t records = 0;
+                while (block < reader.block_count() && batch_.size() < kBlocksPerThread * threads_) {
+                    if (reader.earliest_from(block) >= end_ns) {
+                        done = true;
+                        break;
+                    }
+                    const CompressedBlockIndex& entry = reader.block(block);
+                    bool in_range = entry.max_timestamp_ns >= start_ns && entry.min_timestamp_ns < end_ns;
+                    BatchBlock item = { block++, records, in_range && (symbols_.empty() || Selected(entry, mask)) };
+                    batch_.push_back(item);
+                    if (item.decode)
+                        records += entry.records;
+                }
+                events_.resize(records);
+                double started = Seconds();
+                Decode();
+                double decoded = Seconds();
+                Barrier();
+                double merged = Seconds();
+                RunShards();
+                double finished = Seconds();
+                WriteOrders();
+                phase_seconds_[0] += decoded - started;
+                phase_seconds_[1] += merged - decoded;
+                phase_seconds_[2] += finished - merged;
+            }
+        }
+        if (replay_->reordering()) {
+            replay_->reorder().Flush();
+            Release();
+            RunShards();
+            WriteOrders();
+        }
+    }
+
+    uint64_t blocks_decoded() const { return blocks_decoded_; }
+    uint64_t blocks_skipped() const { return blocks_skipped_; }
+
+    void PrintPhases() const
+    {
+        printf("sharded over %u threads: decode=%.3fs barrier=%.3fs symbols=%.3fs\n", threads_, phase_seconds_[0],
+               phase_seconds_[1], phase_seconds_[2]);
+    }
+
+private:
+    static const size_t kBlocksPerThread = 64;
+
+    struct BatchBlock {
+        size_t index;
+        size_t offset;               // of its first event in events_
+        bool decode;                 // false if the symbol bitmap rules it out
+    };
+
+    struct Slot {
+        char key[8];                 // MarketEventRecord::symbol
+        std::string symbol;
+        VWAPReplayPosition* state;   // owned by the replay; map nodes do not move
+        unsigned shard;
+    };
+
+    // An event with the shared state it saw, queued for its symbol's shard
+    struct Step {
+        const MarketEventRecord* event;
+        uint32_t sequence;           // position in the batch's event order
+        uint32_t slot;
+        bool window_ready;
+        double window_pv;
+        int64_t window_volume;
+    };
+
+    struct Fill {
+        const MarketEventRecord* event;
+        uint32_t sequence;
+        uint32_t slot;
+        int trade_size;
+        double price;
+    };
+
+    static bool EventOrder(const Fill& a, const Fill& b) { return a.sequence < b.sequence; }
+
+    static bool Selected(const CompressedBlockIndex& entry, const uint64_t* mask)
+    {
+        for (int i = 0; i < TICK_COMPRESSED_MAX_SYMBOLS / 64; ++i) {
+            if (entry.symbol_bitmap[i] & mask[i])
+                return true;
+        }
+        return false;
+    }
+
+    void Decode()
+    {
+        std::atomic<size_t> next(0);
+        ParallelFor(threads_, [&](unsigned thread) {
+            for (size_t i = next++; i < batch_.size(); i = next++) {
+                if (batch_[i].decode)
+                    readers_[thread]->DecodeBlock(batch_[i].index, &events_[batch_[i].offset]);
+            }
+        });
+    }
+
+    // Serial pass in archive order over the events inside the range
+    void Barrier()
+    {
+        for (size_t b = 0; b < batch_.size(); ++b) {
+            if (!batch_[b].decode) {
+                ++blocks_skipped_;
+                continue;
+            }
+            ++blocks_decoded_;
+            size_t end = batch_[b].offset + readers_[0]->block(batch_[b].index).records;
+            for (size_t i = batch_[b].offset; i < end; ++i) {
+                const MarketEventRecord& event = events_[i];
+                if (event.timestamp_ns < start_ns_ || event.timestamp_ns >= end_ns_ ||
+                    (!symbols_.empty() && !SymbolSelected(event)))
+                    continue;
+                if (!replay_->reordering()) {
+                    Admit(event);
+                } else {
+                    replay_->reorder().Push(event);
+                    Release();
+                }
+            }
+        }
+    }
+
+    // Copies the events the reorder stage releases, since they can outlive the batch they came in
+    void Release()
+    {
+        MarketEventRecord released;
+        while (replay_->reorder().Pop(&released)) {
+            released_.push_back(released);
+            Admit(released_.back());
+        }
+    }
+
+    void Admit(const MarketEventRecord& event)
+    {
+        uint32_t slot = SlotFor(event);
+        if (replay_->CountEvent(*slots_[slot].state, event.timestamp_ns))
+            return;
+        Step step = { &event, next_sequence_++, slot, false, 0.0, 0 };
+        step.window_ready = event.event_type == TICK_EVENT_TYPE_TRADE && replay_->AddTrade(event);
+        step.window_pv = replay_->window().cumulative_pv();
+        step.window_volume = replay_->window().cumulative_volume();
+        shards_[slots_[slot].shard].push_back(step);
+    }
+
+    void RunShards()
+    {
+        double cost_per_share = replay_->params().execution_cost_per_share;
+        ParallelFor(threads_, [&](unsigned shard) {
+            const std::vector<Step>& steps = shards_[shard];
+            for (size_t i = 0; i < steps.size(); ++i) {
+                const Step& step = steps[i];
+                double price;
+                int trade_size = slots_[step.slot].state->OnEvent(*step.event, step.window_ready, step.window_pv,
+                                                                  step.window_volume, cost_per_share, &price);
+                if (trade_size != 0) {
+                    Fill fill = { step.event, step.sequence, step.slot, trade_size, price };
+                    fills_[shard].push_back(fill);
+                }
+            }
+            shards_[shard].clear();
+        });
+    }
+
+    void WriteOrders()
+    {
+        std::vector<Fill> fills;
+        for (unsigned shard = 0; shard < threads_; ++shard) {
+            fills.insert(fills.end(), fills_[shard].begin(), fills_[shard].end());
+            fills_[shard].clear();
+        }
+        std::sort(fills.begin(), fills.end(), EventOrder);
+        for (size_t i = 0; i < fills.size(); ++i) {
+            replay_->WriteOrder(fills[i].event->timestamp_ns, slots_[fills[i].slot].symbol,
+                                fills[i].trade_size, fills[i].price);
+        }
+        released_.clear();
+        next_sequence_ = 0;
+    }
+
+    // Symbols get shards round robin in order of first appearance
+    uint32_t SlotFor(const MarketEventRecord& event)
+    {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (memcmp(slots_[i].key, event.symbol, sizeof(event.symbol)) == 0)
+                return uint32_t(i);
+        }
+        Slot slot;
+        memcpy(slot.key, event.symbol, sizeof(slot.key));
+        slot.symbol.assign(event.symbol, strnlen(event.symbol, sizeof(event.symbol)));
+        slot.state = &replay_->Position(slot.symbol);
+        slot.shard = unsigned(slots_.size() % threads_);
+        slots_.push_back(slot);
+        return uint32_t(slots_.size() - 1);
+    }
+
+    bool SymbolSelected(const MarketEventRecord& event) const
+    {
+        for (size_t i = 0; i < symbols_.size(); ++i) {
+            if (strncmp(event.symbol, symbols_[i].c_str(), sizeof(event.symbol)) == 0)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    const TickArchive& archive_;
+    VWAPReplay* replay_;
+    unsigned threads_;
+    int64_t start_ns_;
+    int64_t end_ns_;
+    std::vector<std::string> symbols_;
+    std::vector<std::unique_ptr<CompressedTickReader> > readers_;
+    std::vector<BatchBlock> batch_;
+    std::vector<MarketEventRecord> events_;
+    std::vector<Slot> slots_;
+    std::vector<std::vector<Step> > shards_;
+    std::vector<std::vector<Fill> > fills_;
+    std::deque<MarketEventRecord> released_;     // reorder stage output of the batch; deque keeps Step pointers valid
+    uint32_t next_sequence_;
+    uint64_t blocks_decoded_;
+    uint64_t blocks_skipped_;
+    double phase_seconds_[3];
+};
+
+static std::vector<std::string> SplitSymbols(const std::string& list)
+{
+    std::vector<std::string> symbols;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+            comma = list.size();
+        if (comma > start)
+            symbols.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return symbols;
+}
+
+static void PrintLatency(const char* name, const LatencyHistogram& histogram)
+{
+    printf("%-9s n=%llu mean=%.0fns p50<=%lldns p99<=%lldns p99.9<=%lldns max=%lldns\n", name,
+           (unsigned long long)histogram.count(), histogram.mean_ns(), (long long)histogram.Quantile(0.5),
+           (long long)histogram.Quantile(0.99), (long long)histogram.Quantile(0.999), (long long)histogram.max_ns());
+}
+
+static void PrintPacing(const ReplayPacer& pacer)
+{
+    printf("paced at %gx: events=%llu late=%llu overruns=%llu max_backlog=%.3fms\n", pacer.speed(),
+           (unsigned long long)pacer.events(), (unsigned long long)pacer.late_events(),
+           (unsigned long long)pacer.overruns(), pacer.max_backlog_ns() / 1e6);
+    PrintLatency("jitter", pacer.jitter());
+    PrintLatency("backlog", pacer.backlog());
+    PrintLatency("callback", pacer.callback());
+}
+
+static void PrintReorder(const TickReorderBuffer& reorder)
+{
+    printf("reordered with hold %lldus: events=%llu out_of_order=%llu (%.3f%%) late=%llu max_held=%zu\n",
+           (long long)(reorder.max_hold_ns() / 1000), (unsigned long long)reorder.events(),
+           (unsigned long long)reorder.out_of_order(), reorder.events() ? 100.0 * reorder.out_of_order() / reorder.events() : 0.0,
+           (unsigned long long)reorder.late(), reorder.max_held());
+    PrintLatency("added", reorder.added_latency());
+}
+
+// What record_market_data adds to a callback, timed around each call
+static inline void RecordArrival(MarketRecorder* recorder, const MarketEventRecord& event, uint64_t* record_ticks)
+{
+    uint64_t before = TscClock::Ticks();
+    recorder->Record(event);
+    *record_ticks += TscClock::Ticks() - before;
+}
+
+static void PrintRecording(const std::string& path, const MarketRecorder& recorder, uint64_t record_ticks)
+{
+    uint64_t events = recorder.recorded() + recorder.dropped();
+    printf("recorded to %s: events=%llu written=%llu dropped=%llu write_errors=%llu record=%.1fns/event\n", path.c_str(),
+           (unsigned long long)events, (unsigned long long)recorder.written(), (unsigned long long)recorder.dropped(),
+           (unsigned long long)recorder.write_errors(),
+           events ? double(TscClock::Instance().TicksToNanos(record_ticks)) / events : 0.0);
+}
+
+static int Usage()
+{
+    fprintf(stderr, "usage: vwap_replay <archive_dir> <start> <end> [--symbols A,B] [--set name=value ...] [--out prefix]\n"
+                    "                   [--speed x [--spin-us n] | --threads n] [--record out.bin] [--print-params]\n");
+    return 2;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+        return Usage();
+
+    int64_t start_ns, end_ns;
+    if (!TickArchive::ParseTime(argv[2], &start_ns) || !TickArchive::ParseTime(argv[3], &end_ns)) {
+        fprintf(stderr, "vwap_replay: times must look like yyyymmdd[ hh:mm:ss]\n");
+        return 2;
+    }
+
+    VWAPReplayParams params;
+    std::vector<std::string> symbols;
+    std::string out_prefix;
+    std::string record_path;
+    double speed = 0.0;
+    int spin_us = 100;
+    unsigned threads = 1;
+    bool print_params = false;
+    for (int i = 4; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--symbols" && i + 1 < argc) {
+            symbols = SplitSymbols(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            out_prefix = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (arg == "--spin-us" && i + 1 < argc) {
+            spin_us = atoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = unsigned(std::max(1, atoi(argv[++i])));
+        } else if (arg == "--record" && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (arg == "--print-params") {
+            print_params = true;
+        } else if (arg == "--set" && i + 1 < argc) {
+            std::string assignment = argv[++i];
+            size_t eq = assignment.find('=');
+            if (eq == std::string::npos) {
+                fprintf(stderr, "vwap_replay: expected name=value, got %s\n", assignment.c_str());
+                return 2;
+            }
+            if (!params.Set(assignment.substr(0, eq), assignment.substr(eq + 1))) {
+                fprintf(stderr, "vwap_replay: %s\n", params.error.c_str());
+                return 2;
+            }
+        } else {
+            return Usage();
+        }
+    }
+
+    if (params.vwap_window_seconds > params.vwap_max_horizon_seconds) {
+        fprintf(stderr, "vwap_replay: vwap_window_seconds %d exceeds vwap_max_horizon_seconds %d\n",
+                params.vwap_window_seconds, params.vwap_max_horizon_seconds);
+        return 2;
+    }
+    if (speed > 0.0 && threads > 1) {
+        fprintf(stderr, "vwap_replay: --speed paces one event at a time and cannot be combined with --threads\n");
+        return 2;
+    }
+    if (!record_path.empty() && threads > 1) {
+        fprintf(stderr, "vwap_replay: --record times the single event thread and cannot be combined with --threads\n");
+        return 2;
+    }
+
+    if (print_params) {
+        params.Print(stdout);
+        return 0;
+    }
+
+    TickArchive archive;
+    if (!archive.Open(argv[1])) {
+        fprintf(stderr, "vwap_replay: no <yyyymmdd>.tpk files in %s\n", argv[1]);
+        return 1;
+    }
+
+    // Anomaly indexes of the days [start, end) touches, if tick_validate has been run over them
+    std::vector<std::string> days;
+    for (size_t d = 0; d < archive.dates().size(); ++d) {
+        const std::string& date = archive.dates()[d];
+        if (date >= TickArchive::DateOf(start_ns) && date <= TickArchive::DateOf(end_ns - 1))
+            days.push_back(date);
+    }
+    uint32_t all_kinds;
+    ParseTickAnomalyKinds("all", &all_kinds);
+    TickAnomalyIndex flagged, skipped;
+    flagged.Load(argv[1], days, all_kinds);
+    skipped.Load(argv[1], days, params.skip_anomalies);
+
+    VWAPReplay replay(params);
+    replay.SetAnomalies(&flagged, &skipped);
+    if (!out_prefix.empty() && !replay.OpenOutput(out_prefix)) {
+        fprintf(stderr, "vwap_replay: could not open output files for %s\n", out_prefix.c_str());
+        return 1;
+    }
+
+    if (threads > 1) {
+        VWAPShardedReplay sharded(archive, &replay, threads);
+        sharded.Run(start_ns, end_ns, symbols);
+        replay.PrintSummary();
+        if (replay.reordering())
+            PrintReorder(replay.reorder());
+        printf("blocks decoded=%llu skipped=%llu\n",
+               (unsigned long long)sharded.blocks_decoded(), (unsigned long long)sharded.blocks_skipped());
+        sharded.PrintPhases();
+        return 0;
+    }
+
+    MarketRecorder recorder;
+    uint64_t record_ticks = 0;
+    if (!record_path.empty() && !recorder.Open(record_path)) {
+        fprintf(stderr, "vwap_replay: could not open %s\n", record_path.c_str());
+        return 1;
+    }
+
+    TickArchiveCursor cursor(archive);
+    cursor.Seek(start_ns, end_ns, symbols);
+    if (speed > 0.0) {
+        ReplayPacer pacer(speed, int64_t(spin_us) * 1000);
+        while (const MarketEventRecord* event = cursor.Next()) {
+            pacer.Wait(event->timestamp_ns);
+            if (recorder.is_open())
+                RecordArrival(&recorder, *event, &record_ticks);
+            replay.OnArrival(*event);
+            pacer.Done();
+        }
+        replay.Finish();
+        PrintPacing(pacer);
+    } else {
+        while (const MarketEventRecord* event = cursor.Next()) {
+            if (recorder.is_open())
+                RecordArrival(&recorder, *event, &record_ticks);
+            replay.OnArrival(*event);
+        }
+        replay.Finish();
+    }
+
+    replay.PrintSummary();
+    if (replay.reordering())
+        PrintReorder(replay.reorder());
+    printf("blocks decoded=%llu skipped=%llu\n",
+           (unsigned long long)cursor.blocks_decoded(), (unsigned long long)cursor.blocks_skipped());
+    if (recorder.is_open()) {
+        recorder.Close();
+        PrintRecording(record_path, recorder, record_ticks);
+    }
+#ifdef CALLBACK_PROFILE
+    printf("%s", replay.profiler().Report().c_str());
+#endif
+    return 0;
+}